@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+#include "jarvis_link.h"
+
+// ESP32 side of the framed UART link to the ATmega32 (see jarvis_link.h)
+
+#define ATMEGA_UART_TX_PIN 8 // -> ATmega PD0/RXD (pin 14), was the old PA0 control line
+#define ATMEGA_UART_RX_PIN 9 // <- ATmega PD1/TXD (pin 15), through a 5V -> 3.3V divider
+
+#define LINK_ACK_TIMEOUT_MS 50
+#define LINK_RETRIES 3
+
+// A batch of records sent as one frame
+struct LinkBatch
+{
+  uint8_t len;
+  uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+// Input edge reported by the ATmega
+struct LinkInputEvent
+{
+  uint8_t channel;
+  uint8_t level;
+  uint32_t edgeUs;    // ATmega clock
+  uint16_t latencyUs; // Edge to frame queued on the ATmega
+};
+
+typedef void (*LinkInputHandler)(const LinkInputEvent &event);
+
+// Decoded ACK frame
+struct LinkReply
+{
+  uint8_t status;
+  uint8_t executed;
+  uint8_t len; // Reply records after the ACK record
+  uint8_t payload[LINK_MAX_PAYLOAD];
+};
+
+void atmegaLinkBegin();
+void atmegaLinkPoll(); // Also dispatches input events, call it from loop()
+void atmegaOnInput(LinkInputHandler handler);
+
+void linkBatchReset(LinkBatch &batch);
+bool linkBatchAdd(LinkBatch &batch, uint8_t op, const uint8_t *args, uint8_t argLen);
+bool linkBatchSetOutput(LinkBatch &batch, uint8_t channel, uint8_t value);
+bool linkBatchLcdText(LinkBatch &batch, uint8_t row, uint8_t col, const char *text);
+bool linkBatchQuery(LinkBatch &batch, uint8_t what);
+bool linkBatchLcdScroll(LinkBatch &batch, uint8_t row, bool append, const char *text, uint8_t len);
+
+// Send a batch and wait for its ACK, resending on NAK or timeout.
+// reply may be NULL when no query results are needed.
+bool atmegaLinkSend(const LinkBatch &batch, LinkReply *reply = NULL);
+
+// Find a reply record by op, returns its args or NULL
+const uint8_t *linkReplyFind(const LinkReply &reply, uint8_t op, uint8_t *argLen);
+
+// Convenience wrapper for single-output commands, level 0-255 (PWM on 0 and 1)
+bool atmegaSetOutput(uint8_t channel, uint8_t level);
+
+// Show text on one LCD row, scrolling it if it is longer than 16 characters.
+// Long text is cut to LINK_SCROLL_MAX and split over as many frames as needed.
+bool atmegaLcdScroll(uint8_t row, const String &text);
+
+// Ping the ATmega count times and print round-trip latency and throughput
+void atmegaLinkBenchmark(int count);
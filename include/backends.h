@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include "turn_scheduler.h"
+
+// STT, LLM and TTS backends with latency-based routing.
+//
+// Each stage can have several endpoints, e.g. the cloud service and an
+// inference server on the LAN. Every request feeds its endpoint's latency
+// EWMA (successes only) and error-rate EWMA. backendPick() returns the
+// endpoint with the lowest expected time, the latency EWMA scaled by
+// 1 / (1 - error rate); one that has never answered counts as fastest, so
+// each gets measured. BACKEND_FAIL_STREAK failures in a row rest an
+// endpoint for BACKEND_COOLDOWN_MS, after which one request probes it.
+// Every BACKEND_EXPLORE_EVERY-th pick goes to the least recently used
+// healthy endpoint instead, so one slow answer does not bench it forever.
+
+enum BackendApi
+{
+  API_DEEPGRAM, // STT /v1/listen, TTS /v1/speak
+  API_GEMINI,   // LLM generateContent
+  API_OPENAI    // /v1/audio/transcriptions, /v1/chat/completions, /v1/audio/speech
+};
+
+struct BackendConfig
+{
+  const char *name;
+  TurnStage stage;
+  BackendApi api;
+  const char *host;
+  uint16_t port;
+  bool tls;
+  const char *key;     // API key, NULL if the server needs none
+  const char *model;
+  uint32_t sampleRate; // TTS output rate, 0 for the other stages
+};
+
+#define BACKEND_MAX 8
+#define BACKEND_EWMA_ALPHA 0.25f
+#define BACKEND_FAIL_STREAK 2
+#define BACKEND_COOLDOWN_MS 30000
+#define BACKEND_EXPLORE_EVERY 16
+
+// The table is referenced, not copied
+bool backendsBegin(const BackendConfig *table, size_t count);
+
+// Best endpoint for stage other than exclude, NULL if there is none. If all
+// of them are resting, the one whose cooldown ends first.
+const BackendConfig *backendPick(TurnStage stage, const BackendConfig *exclude = NULL);
+
+// Record how a request went. Safe to call from request tasks.
+void backendResult(const BackendConfig *backend, bool ok, uint32_t ms);
+
+void backendReport();
+
+// Route every stage to the backends called name only, e.g. the LAN mocks
+// during a soak; NULL routes to all of them again
+void backendOnly(const char *name);
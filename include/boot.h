@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// Boot sequencing and profiling.
+//
+// Independent init steps run as tasks and signal completion through an
+// event group; a step can wait for the bits of the steps it depends on.
+// Every step is timed from power-on, and bootReport() prints them with
+// the ready-to-listen time so boot regressions show up in the log.
+
+#define BOOT_SD (1 << 0)
+#define BOOT_AUDIO (1 << 1)
+#define BOOT_LINK (1 << 2)
+#define BOOT_NET (1 << 3) // Wi-Fi up and the Deepgram TLS session open (or given up)
+
+// Needed before the first recording can start
+#define BOOT_READY (BOOT_SD | BOOT_AUDIO | BOOT_LINK)
+
+#define BOOT_MAX_STEPS 12
+
+typedef void (*BootFn)();
+
+void bootBegin();
+
+// Run fn in its own task once every bit in after is set, set done when it returns
+void bootTask(const char *name, BootFn fn, EventBits_t after, EventBits_t done, uint32_t stack = 4096);
+// Run fn on the calling task, timed like a boot task
+void bootStep(const char *name, BootFn fn, EventBits_t done = 0);
+
+bool bootWait(EventBits_t bits, uint32_t timeoutMs);
+bool bootDone(EventBits_t bits);
+
+// Per-step start/duration and the ready-to-listen time
+void bootReport();
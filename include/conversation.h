@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Rolling conversation context for Gemini, in fixed memory.
+//
+// The last CONV_MAX_TURNS question/answer pairs are kept verbatim in a
+// ring. Once they exceed CONV_TOKEN_BUDGET (estimated at 4 bytes per
+// token) or the ring is full, the oldest turn is compacted into a short
+// "Q: ... A: ..." line in a summary buffer. The summary drops its own
+// oldest lines when full, so the request never grows past a fixed size
+// however long the session runs.
+
+#define CONV_MAX_TURNS 6
+#define CONV_TURN_BYTES 320    // Per side, longer text is cut at a word boundary
+#define CONV_TOKEN_BUDGET 400  // Estimated tokens of verbatim history per request
+#define CONV_SUMMARY_BYTES 256
+#define CONV_SUMMARY_WORDS 8   // Words kept from each side of a compacted turn
+#define CONV_IDLE_RESET_MS (10UL * 60 * 1000) // Start afresh after this long idle
+
+// Record a finished turn
+void conversationAdd(const char *user, const char *model);
+void conversationClear();
+
+// Fill systemInstruction and contents of a generateContent request, with
+// prompt as the final user turn. Strings are added by pointer, so prompt
+// must outlive the document.
+void conversationBuild(JsonObject request, const char *instruction, const char *prompt);
+
+// Estimated tokens held verbatim in the ring
+uint16_t conversationTokens();
+void conversationReport();
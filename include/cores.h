@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+
+// Task placement on the S3's two cores.
+//
+// The default env builds unicore: the main loop reads the mic and writes
+// the speaker itself, between SD writes, TLS and JSON parsing. The
+// esp32-s3-dualcore env defines AUDIO_DUAL_CORE and moves the loop (and
+// with it HTTP, TLS and parsing) next to the Wi-Fi stack on NET_CORE.
+// There, an audio task pinned to AUDIO_CORE at AUDIO_PRIORITY does every
+// I2S read and write. Mic blocks go to the loop and blocks to play come
+// back through single-producer single-consumer rings of atomics, so
+// neither core ever waits on a lock held by the other. Request tasks
+// (hedges, background uploads, stream opens) are pinned to NET_CORE too.
+//
+// The calls below are the same in both builds, so main.cpp does not care.
+
+#define NET_CORE 0
+#define AUDIO_CORE 1
+#define AUDIO_PRIORITY (configMAX_PRIORITIES - 2)
+#define AUDIO_BLOCK 512      // Samples per ring block, 32 ms at 16 kHz
+#define AUDIO_MIC_BLOCKS 16  // Mic audio the loop may fall behind by
+#define AUDIO_PLAY_BLOCKS 8  // Playback queued ahead of the DMA
+#define CORE_STATS_HIST_MS 256
+
+void coresBegin(i2s_port_t mic, i2s_port_t speaker);
+
+// Read up to maxSamples of mic audio, waiting at most timeoutMs
+esp_err_t audioRead(int16_t *samples, size_t maxSamples, size_t *count, uint32_t timeoutMs);
+// Drop mic audio captured so far, e.g. during an answer
+void audioFlushMic();
+
+// Queue samples for the speaker, waits while the queue is full
+esp_err_t audioWrite(const int16_t *samples, size_t count);
+// Wait until queued samples reach the DMA, or drop them
+void audioWriteDone(bool discard);
+
+// Keep the audio task off I2S while a tool drives it directly
+void audioPause(bool pause);
+
+// xTaskCreate, pinned to NET_CORE in the dual-core build
+BaseType_t netTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                         TaskHandle_t *handle = NULL);
+
+// Per-core CPU use and I2S service intervals, between start and report.
+// Run one voice turn in between on each build to compare them.
+void coreStatsStart();
+bool coreStatsRunning();
+void coreStatsReport();
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Hands-free conversation mode.
+//
+// While active, every mic frame goes through an energy endpointer with an
+// adaptive noise floor. Speech starts a recording (with the pre-roll that
+// came before the onset), HF_HANGOVER_MS of silence ends it and the turn
+// runs; once the answer has played, capture is re-armed right away. The
+// mode ends on the stop phrase or after HF_IDLE_MS without speech.
+//
+// Per turn it records the reply latency (end of speech to first answer
+// audio) and the re-arm gap (end of answer to listening again).
+
+#define HF_SAMPLE_RATE 16000        // Same as the mic
+#define HF_PREROLL_SAMPLES 2048     // 128 ms kept ahead of the speech onset
+#define HF_MIN_SPEECH_RMS 300       // Speech threshold floor
+#define HF_NOISE_MULT 3             // Speech is this many times the noise floor
+#define HF_ONSET_MS 96              // Loud for this long to count as speech
+#define HF_MIN_SPEECH_MS 300        // Shorter bursts are clicks or coughs
+#define HF_HANGOVER_MS 700          // Silence that ends an utterance
+#define HF_REARM_GUARD_MS 200       // Room echo of the answer, only learns the floor
+#define HF_IDLE_MS 30000            // No speech for this long ends the mode
+#define HF_TURN_HISTORY 10
+
+enum EndpointEvent
+{
+  EP_NONE = 0,
+  EP_SPEECH_START, // Start recording and write the pre-roll
+  EP_SPEECH_END,   // Stop recording and run the turn
+  EP_CANCEL,       // Too short to be speech, drop the recording
+  EP_IDLE          // Nobody spoke, leave hands-free mode
+};
+
+void handsFreeStart();
+void handsFreeStop(const char *reason);
+bool handsFreeActive();
+
+// Feed one mic frame, returns what the caller should do next
+EndpointEvent handsFreeFeed(const int16_t *samples, size_t count);
+
+// Hand the audio buffered before the onset to sink, oldest first
+typedef void (*PrerollSink)(void *ctx, const int16_t *samples, size_t count);
+void handsFreePreroll(PrerollSink sink, void *ctx);
+
+// Turn timeline: speech ended, answer audio started and finished,
+// listening again
+void handsFreeTurnStart();
+void handsFreeReplyStarted();
+void handsFreeReplyEnded();
+void handsFreeRearm();
+
+// Latency per turn and session summary
+void handsFreeReport();
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+
+// Binary host link over the USB CDC console, for pulling audio and
+// telemetry onto a PC (scripts/jarvis_host.py).
+//
+// The '!' command switches the console into host mode. From then on,
+// console input is parsed as request frames instead of command keys,
+// until the host sends HOST_REQ_EXIT or stays silent for HOST_IDLE_MS.
+// Replies and streams go out as frames:
+//   0xA5 0x5A | TYPE | SEQ | LEN (u16) | PAYLOAD[LEN] | CRC (u16)
+// all little-endian, CRC-16/CCITT-FALSE (as in jarvis_link.h) over TYPE
+// to the end of PAYLOAD. SEQ counts frames per direction, so the host
+// sees a lost frame. The sync bytes are not ASCII: log lines still
+// printed in host mode arrive between frames and the host shows them
+// as text. Each frame is a single Serial.write, so it is never split
+// by a log line.
+//
+// A low-priority task builds and sends the frames. The loop hands mic
+// audio over through a lock-free ring and never waits on USB: a full
+// ring drops samples, and the sample index in each mic frame leaves a
+// gap for the host to see.
+
+#define HOST_SYNC0 0xA5
+#define HOST_SYNC1 0x5A
+#define HOST_HEADER 6 // Sync x2, type, seq, length
+#define HOST_CRC 2
+#define HOST_MAX_PAYLOAD 4096
+#define HOST_MAX_REQUEST 96   // Request payloads, a path at most
+#define HOST_TX_BUFFER 16384  // USB CDC transmit ring, set before Serial.begin
+#define HOST_MIC_BLOCK 512    // Samples per mic frame
+#define HOST_MIC_BLOCKS 32    // Queued for the link, about 1 s at 16 kHz
+#define HOST_IDLE_MS 5000     // Back to command keys without requests
+#define HOST_VERSION 1
+
+// Requests (host -> device)
+#define HOST_REQ_HELLO 0x01     // (none), also keeps host mode alive
+#define HOST_REQ_MIC 0x02       // on (u8)
+#define HOST_REQ_LIST 0x03      // (none)
+#define HOST_REQ_FETCH 0x04     // path
+#define HOST_REQ_TELEMETRY 0x05 // period ms (u16), 0 = once
+#define HOST_REQ_BENCH 0x06     // seconds (u16) of filler frames
+#define HOST_REQ_EXIT 0x07      // (none)
+
+// Device -> host
+#define HOST_MSG_HELLO 0x81      // version (u8), sample rate (u32), max payload (u16)
+#define HOST_MSG_MIC 0x82        // first sample index (u32), int16 samples
+#define HOST_MSG_FILE 0x83       // size (u32), path: LIST entry or FETCH start
+#define HOST_MSG_DATA 0x84       // offset (u32), file bytes
+#define HOST_MSG_DONE 0x85       // request type (u8), status (u8), count (u32)
+#define HOST_MSG_TELEMETRY 0x86  // HostTelemetry
+#define HOST_MSG_BENCH 0x87      // filler
+
+#define HOST_STATUS_OK 0
+#define HOST_STATUS_NOT_FOUND 1
+#define HOST_STATUS_READ_ERROR 2
+#define HOST_STATUS_BAD_REQUEST 3
+
+struct __attribute__((packed)) HostTelemetry
+{
+  uint32_t uptimeMs;
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;
+  uint32_t largestBlock;
+  uint32_t freePsram;
+  uint32_t micBuffers; // DMA buffers and drops while watched, see i2s_audio.h
+  uint32_t micDrops;
+  uint32_t speakerDrops;
+  uint32_t streamDrops; // Mic samples the link had no room for
+  uint32_t txBytes;     // Sent over the link in host mode
+  int8_t rssi;          // 0 when Wi-Fi is down
+};
+
+void hostLinkBegin(i2s_port_t mic, i2s_port_t speaker, uint32_t sampleRate);
+
+void hostLinkStart();
+bool hostLinkActive();
+
+// Read request frames from Serial, call it from loop() in host mode
+void hostLinkPoll();
+
+// Mic audio as captured, copied out only while the host streams it
+void hostLinkMic(const int16_t *samples, size_t count);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+// Incremental HTTP/1.1 response parser shared by the raw-socket clients
+// (Deepgram STT/TTS and anything added later). It never allocates: bytes
+// are fed in as they arrive, headers go through a fixed line buffer, and
+// body bytes are handed to a callback. Content-Length, chunked transfer
+// encoding and read-until-close bodies are all framed exactly, so the
+// response is complete the moment its last byte arrives.
+
+#define HTTP_MAX_LINE 256
+#define HTTP_READ_CHUNK 512
+
+enum HttpParseState
+{
+  HTTP_STATUS_LINE,
+  HTTP_HEADERS,
+  HTTP_BODY_LENGTH,
+  HTTP_BODY_UNTIL_CLOSE,
+  HTTP_CHUNK_SIZE,
+  HTTP_CHUNK_DATA,
+  HTTP_CHUNK_DATA_END,
+  HTTP_TRAILERS,
+  HTTP_DONE,
+  HTTP_ERROR
+};
+
+// Return false to abort the response (e.g. SD write failed)
+typedef bool (*HttpBodyCallback)(void *ctx, const uint8_t *data, size_t len);
+
+struct HttpResponse
+{
+  int status;            // 0 until the status line is parsed
+  int32_t contentLength; // -1 if not sent
+  bool chunked;
+  bool keepAlive;
+  char contentType[48];
+  uint32_t bodyBytes;    // Body bytes delivered so far
+
+  HttpParseState state;
+  uint32_t remaining;    // Bytes left in the body or current chunk
+  uint16_t lineLen;
+  char line[HTTP_MAX_LINE];
+
+  HttpBodyCallback onBody;
+  void *ctx;
+};
+
+void httpResponseInit(HttpResponse &r, HttpBodyCallback onBody = NULL, void *ctx = NULL);
+
+// Feed received bytes. Returns how many were consumed; anything after the
+// end of the message (a pipelined response) is left for the caller.
+size_t httpResponseFeed(HttpResponse &r, const uint8_t *data, size_t len);
+
+// The peer closed the connection. Completes a read-until-close body,
+// anything else still in progress becomes an error.
+void httpResponseEof(HttpResponse &r);
+
+inline bool httpResponseDone(const HttpResponse &r) { return r.state == HTTP_DONE; }
+inline bool httpResponseFailed(const HttpResponse &r) { return r.state == HTTP_ERROR; }
+
+// Bytes read past the end of one response, kept for the next one when
+// requests are pipelined on a connection
+struct HttpCarry
+{
+  uint8_t data[HTTP_READ_CHUNK];
+  uint16_t pos;
+  uint16_t len;
+};
+
+inline void httpCarryReset(HttpCarry &c) { c.pos = c.len = 0; }
+
+// Read from client until the response is complete, the peer closes or
+// timeoutMs passes. Waits on socket readiness rather than fixed sleeps.
+// With a carry, leftover bytes from the previous response are parsed first
+// and any read past this one are saved. Returns true if a complete
+// response was received.
+bool httpReadResponse(WiFiClient &client, HttpResponse &r, uint32_t timeoutMs, HttpCarry *carry = NULL);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+
+// I2S drivers with DMA event counters and a DMA geometry kept in NVS.
+//
+// Both drivers are installed with an event queue that a small task
+// drains. Mic overflows (the DMA ring filled up before it was read, so
+// audio was lost) and speaker underruns (the ring ran dry and a gap was
+// played) only count while a port is watched: the mic is not read during
+// playback and the speaker idles between answers, so both happen all the
+// time outside recording and playback.
+//
+// The buffer count and length of each port come from NVS when the driver
+// is installed. i2sAudioCalibrate() tries geometries from the smallest
+// ring up under a synthetic SD and network load, and stores the first
+// one without drops for each port.
+
+#define I2S_EVENT_QUEUE_LEN 16
+
+// Calibration load, the same sequence for every geometry
+#define I2S_CAL_TRIAL_MS 2000
+#define I2S_CAL_CHUNK 512        // Samples per read or write, as in the main loop
+#define I2S_CAL_STALL_MAX_MS 20  // Random wait after each chunk, like a TLS write
+#define I2S_CAL_SPIKE_EVERY 32   // Chunks between long stalls
+#define I2S_CAL_SPIKE_MS 80      // Long stall, like a retransmit or an SD block erase
+#define I2S_CAL_MAX_SAMPLES 8192 // Largest ring tried
+
+struct I2sGeometry
+{
+  uint16_t count; // DMA buffers
+  uint16_t len;   // Samples per buffer
+};
+
+struct I2sCounters
+{
+  uint32_t buffers; // DMA buffers completed while watched
+  uint32_t drops;   // Mic overflows or speaker underruns while watched
+  uint32_t dmaErrors;
+};
+
+// Install a driver with an event queue. The DMA geometry in config is the
+// default until a calibration stores one. config and pins are kept for
+// reinstalling.
+bool i2sAudioInstall(i2s_port_t port, const i2s_config_t &config, const i2s_pin_config_t &pins);
+
+I2sGeometry i2sAudioGeometry(i2s_port_t port);
+
+// Count drops on port only between these. Ending a watch prints the
+// drops seen during it, if any.
+void i2sAudioWatch(i2s_port_t port, bool on);
+
+I2sCounters i2sAudioCounters(i2s_port_t port);
+void i2sAudioReport();
+
+// Find and store the smallest drop-free geometry for each port. Takes up
+// to I2S_CAL_TRIAL_MS per geometry; the speaker plays a quiet tone.
+bool i2sAudioCalibrate();
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Local intent matcher. Command patterns are compiled once into a word trie
+// and transcripts are matched on whole-word boundaries, so device commands
+// run without a round trip to the cloud LLM. A transcript with "don't",
+// "not" or "never" in it is never matched.
+//
+// Pattern syntax, words separated by spaces:
+//   light      literal word (case-insensitive)
+//   [the]      optional word
+//   {n}        number slot, digits or number words ("50", "fifty",
+//              "seventy-five", "one hundred and five"); words that do
+//              not read as one number fill no slot
+
+enum IntentId
+{
+  INTENT_NONE = 0,
+  INTENT_LIGHT_ON,
+  INTENT_LIGHT_OFF,
+  INTENT_LIGHT_DIM,
+  INTENT_VOLUME_UP,
+  INTENT_VOLUME_DOWN,
+  INTENT_VOLUME_SET,
+  INTENT_REPEAT,
+  INTENT_STOP_LISTENING
+};
+
+struct IntentRule
+{
+  IntentId intent;
+  const char *pattern;
+};
+
+struct IntentMatch
+{
+  IntentId intent;
+  int32_t slot;   // Number slot value, -1 if the rule has none
+  uint8_t start;  // Matched word range in the transcript
+  uint8_t end;
+};
+
+#define INTENT_MAX_NODES 256
+#define INTENT_MAX_EDGES 320
+#define INTENT_MAX_WORDS 48     // Longer transcripts are left to the LLM
+#define INTENT_MAX_EXTRA_WORDS 3 // Words allowed around a command ("please", "now"...)
+
+// Build the trie. Returns false if the grammar does not fit.
+bool intentCompile(const IntentRule *rules, size_t count);
+
+// Match a transcript, returns INTENT_NONE in match.intent if nothing fits
+bool intentMatch(const char *transcript, IntentMatch &match);
+
+const char *intentName(IntentId intent);
@@ -0,0 +1,164 @@
+// Framed command link between the ESP32-S3 and the ATmega32.
+// Shared by both firmwares, so keep this header plain C.
+//
+// Frame layout (UART, 8N1):
+//   SOF | LEN | SEQ | PAYLOAD[LEN] | CRC_LO | CRC_HI
+// CRC is CRC-16/CCITT-FALSE over LEN, SEQ and PAYLOAD.
+//
+// The payload is a batch of records, each one:
+//   OP | ARGLEN | ARGS[ARGLEN]
+// so several outputs, LCD writes and queries travel in one frame.
+// The ATmega answers every frame with a frame carrying the same SEQ whose
+// first record is LINK_OP_ACK, followed by any query results. A frame that
+// repeats the last one (same SEQ and CRC, i.e. a resend after a lost ACK)
+// is not executed again, the ATmega resends the ACK it already sent.
+// Input events are pushed by the ATmega on its own and are not acknowledged.
+
+#ifndef JARVIS_LINK_H
+#define JARVIS_LINK_H
+
+#include <stdint.h>
+
+#define LINK_BAUD 38400UL
+#define LINK_SOF 0x7E
+#define LINK_MAX_PAYLOAD 64
+#define LINK_FRAME_OVERHEAD 5 // SOF, LEN, SEQ, CRC x2
+
+// Requests (ESP32 -> ATmega)
+#define LINK_OP_SET_OUTPUT 0x01 // channel, level (0 = off, 255 = on, between = PWM)
+#define LINK_OP_LCD_TEXT 0x02   // row, col, chars...
+#define LINK_OP_LCD_CLEAR 0x03  // (none)
+#define LINK_OP_QUERY 0x04      // what
+#define LINK_OP_PING 0x05       // opaque bytes, echoed back in LINK_OP_PONG
+#define LINK_OP_LCD_SCROLL 0x06 // row, flags, chars... (marquee for long text)
+
+// Replies (ATmega -> ESP32)
+#define LINK_OP_ACK 0x80   // status, records executed
+#define LINK_OP_VALUE 0x81 // what, value bytes...
+#define LINK_OP_PONG 0x85  // echoed PING bytes
+#define LINK_OP_EVENT 0x86 // unsolicited: channel, level, edge time us (u32), latency us (u16)
+
+// LINK_OP_QUERY targets
+#define LINK_QUERY_OUTPUTS 0x00 // bitmask of output channels
+#define LINK_QUERY_STATS 0x01   // frames ok (u16), crc errors (u16), overruns (u16)
+#define LINK_QUERY_INPUTS 0x02  // bitmask of debounced input channels
+#define LINK_QUERY_LATENCY 0x03 // last and max input event latency in us (u16, u16)
+
+#define LINK_OUTPUT_ON 255
+
+// LINK_OP_LCD_SCROLL flags
+#define LINK_SCROLL_APPEND 0x01 // continue the text from the previous record
+#define LINK_SCROLL_MAX 96     // characters the ATmega keeps per marquee, the rest is dropped
+
+// LINK_OP_ACK status codes
+#define LINK_STATUS_OK 0x00
+#define LINK_STATUS_BAD_CRC 0x01
+#define LINK_STATUS_BAD_RECORD 0x02
+#define LINK_STATUS_REPLY_FULL 0x03
+
+typedef struct
+{
+  uint8_t state;
+  uint8_t len;
+  uint8_t seq;
+  uint8_t pos;
+  uint16_t crc;
+  uint8_t payload[LINK_MAX_PAYLOAD];
+} link_parser_t;
+
+enum
+{
+  LINK_PARSE_SOF = 0,
+  LINK_PARSE_LEN,
+  LINK_PARSE_SEQ,
+  LINK_PARSE_PAYLOAD,
+  LINK_PARSE_CRC_LO,
+  LINK_PARSE_CRC_HI
+};
+
+// Result of link_parser_feed()
+#define LINK_FEED_PENDING 0
+#define LINK_FEED_FRAME 1
+#define LINK_FEED_BAD_CRC 2
+
+static inline uint16_t link_crc16_update(uint16_t crc, uint8_t data)
+{
+  crc ^= (uint16_t)data << 8;
+  for (uint8_t i = 0; i < 8; i++)
+  {
+    crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+static inline void link_parser_reset(link_parser_t *p)
+{
+  p->state = LINK_PARSE_SOF;
+}
+
+// Feed one received byte. Returns LINK_FEED_FRAME when p->seq, p->len and
+// p->payload hold a complete, CRC-checked frame.
+static inline uint8_t link_parser_feed(link_parser_t *p, uint8_t b)
+{
+  switch (p->state)
+  {
+  case LINK_PARSE_SOF:
+    if (b == LINK_SOF)
+      p->state = LINK_PARSE_LEN;
+    break;
+  case LINK_PARSE_LEN:
+    if (b > LINK_MAX_PAYLOAD)
+    {
+      // Not a real header, resync on the next SOF
+      p->state = (b == LINK_SOF) ? LINK_PARSE_LEN : LINK_PARSE_SOF;
+      break;
+    }
+    p->len = b;
+    p->pos = 0;
+    p->crc = link_crc16_update(0xFFFF, b);
+    p->state = LINK_PARSE_SEQ;
+    break;
+  case LINK_PARSE_SEQ:
+    p->seq = b;
+    p->crc = link_crc16_update(p->crc, b);
+    p->state = p->len ? LINK_PARSE_PAYLOAD : LINK_PARSE_CRC_LO;
+    break;
+  case LINK_PARSE_PAYLOAD:
+    p->payload[p->pos++] = b;
+    p->crc = link_crc16_update(p->crc, b);
+    if (p->pos >= p->len)
+      p->state = LINK_PARSE_CRC_LO;
+    break;
+  case LINK_PARSE_CRC_LO:
+    p->crc ^= b;
+    p->state = LINK_PARSE_CRC_HI;
+    break;
+  case LINK_PARSE_CRC_HI:
+    p->state = LINK_PARSE_SOF;
+    return (p->crc ^ ((uint16_t)b << 8)) == 0 ? LINK_FEED_FRAME : LINK_FEED_BAD_CRC;
+  }
+  return LINK_FEED_PENDING;
+}
+
+// Write a complete frame into out (at least len + LINK_FRAME_OVERHEAD bytes).
+// Returns the number of bytes to transmit.
+static inline uint8_t link_encode_frame(uint8_t *out, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+  uint16_t crc = 0xFFFF;
+  uint8_t n = 0;
+  out[n++] = LINK_SOF;
+  out[n++] = len;
+  crc = link_crc16_update(crc, len);
+  out[n++] = seq;
+  crc = link_crc16_update(crc, seq);
+  for (uint8_t i = 0; i < len; i++)
+  {
+    out[n++] = payload[i];
+    crc = link_crc16_update(crc, payload[i]);
+  }
+  out[n++] = (uint8_t)(crc & 0xFF);
+  out[n++] = (uint8_t)(crc >> 8);
+  return n;
+}
+
+#endif
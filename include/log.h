@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Deferred, binary logging for hot paths.
+//
+// LOG_x(fmt, args...) stores the format pointer, a timestamp and up to
+// LOG_MAX_ARGS 32-bit arguments in a lock-free ring; a low-priority task
+// formats and writes them to Serial (and optionally SD) later. The call
+// itself is a few stores, no formatting and no USB I/O.
+//
+// Rules that follow from deferring the formatting:
+//   - fmt must be a string literal
+//   - %s arguments must point to memory that outlives the call (literals)
+//   - only 32-bit arguments: no floats or %ll, scale to integers instead
+//
+// Levels below LOG_LEVEL are compiled out entirely.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_ENABLED(level) (LOG_LEVEL >= (level))
+
+#define LOG_MAX_ARGS 4
+#define LOG_RING_RECORDS 128 // Power of two
+#define LOG_DRAIN_MS 20
+#define LOG_SD_PATH "/jarvis.log"
+
+void logBegin();
+void logPush(uint8_t level, const char *fmt, const uint32_t *args, uint8_t argc);
+
+// Mirror drained records to LOG_SD_PATH
+void logSdSink(bool enable);
+bool logSdSinkEnabled();
+
+// Time per call for a deferred record against Serial.printf
+void logBenchmark(int iterations);
+
+inline uint32_t logArg(int v) { return (uint32_t)v; }
+inline uint32_t logArg(unsigned int v) { return v; }
+inline uint32_t logArg(long v) { return (uint32_t)v; }
+inline uint32_t logArg(unsigned long v) { return (uint32_t)v; }
+inline uint32_t logArg(const char *s) { return (uint32_t)(uintptr_t)s; }
+inline uint32_t logArg(const void *p) { return (uint32_t)(uintptr_t)p; }
+uint32_t logArg(float) = delete;  // Would need a 64-bit vararg slot
+uint32_t logArg(double) = delete;
+
+template <typename... Args>
+inline void logWrite(uint8_t level, const char *fmt, Args... args)
+{
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  const uint32_t values[LOG_MAX_ARGS + 1] = {logArg(args)...};
+  logPush(level, fmt, values, sizeof...(Args));
+}
+
+#if LOG_ENABLED(LOG_LEVEL_ERROR)
+#define LOG_E(fmt, ...) logWrite(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(fmt, ...) ((void)0)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_WARN)
+#define LOG_W(fmt, ...) logWrite(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(fmt, ...) ((void)0)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_INFO)
+#define LOG_I(fmt, ...) logWrite(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...) ((void)0)
+#endif
+
+#if LOG_ENABLED(LOG_LEVEL_DEBUG)
+#define LOG_D(fmt, ...) logWrite(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(fmt, ...) ((void)0)
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <WiFiClientSecure.h>
+
+// Long-form recording: meetings and dictation well past RECORD_TIME.
+//
+// The capture is rolled into segment files on SD. A segment past
+// LF_SEGMENT_MIN_MS is cut at the next LF_SILENCE_MS of silence, or at
+// LF_SEGMENT_MAX_MS if nobody pauses. Each segment starts with the last
+// LF_OVERLAP_MS of the one before, so a word split by a forced cut is
+// heard whole in one of them; when stitching, words the two transcripts
+// share at the seam are only written once.
+//
+// Finished segments are uploaded from background tasks while recording
+// goes on, at most LF_IN_FLIGHT at a time, each on its own connection.
+// Transcripts are appended in segment order to one document on SD, so
+// when recording stops only the last segment is left to transcribe. The
+// audio of a transcribed segment is deleted; a failed one is kept and
+// marked in the document.
+
+#define LF_SAMPLE_RATE 16000
+#define LF_SEGMENT_MIN_MS 15000
+#define LF_SEGMENT_MAX_MS 30000
+#define LF_SILENCE_MS 300
+#define LF_OVERLAP_MS 500
+#define LF_MIN_SPEECH_RMS 300 // Silence threshold floor
+#define LF_NOISE_MULT 3       // Speech is this many times the noise floor
+#define LF_IN_FLIGHT 2        // Uploads at once, each holds a TLS session
+#define LF_RETRIES 2          // Extra attempts per segment
+#define LF_UPLOAD_TIMEOUT_MS 30000
+#define LF_DEDUP_WORDS 8      // Longest seam overlap looked for, in words
+
+// Transcribe the WAV file at path using tcp. Runs in a background task.
+typedef bool (*LongFormTranscribe)(WiFiClientSecure &tcp, const char *path, String &transcript, uint32_t deadline);
+// Write the WAV header of a finished segment holding dataSize bytes of audio
+typedef void (*LongFormFinish)(File &file, uint32_t dataSize);
+
+// Start recording, false if a session is still busy or SD fails
+bool longFormStart(LongFormTranscribe transcribe, LongFormFinish finish);
+void longFormStop();
+
+bool longFormRecording();
+// Recording, or segments of the last session still being transcribed
+bool longFormBusy();
+
+// Mic audio while recording
+void longFormFeed(const int16_t *samples, size_t count);
+
+// Start uploads and write finished transcripts, call from the main loop
+void longFormPoll();
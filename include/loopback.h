@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+
+// Acoustic loopback measurement: speaker -> air -> mic.
+//
+// Plays a maximum length sequence (MLS) from a precomputed table while
+// the mic captures, then cross-correlates capture and table to find the
+// round-trip delay. Repeated over several trials this gives the latency
+// of the whole I2S/DMA chain, its jitter, and whether the mic clips.
+// Needs the speaker within earshot of the mic.
+
+#define LOOPBACK_MLS_ORDER 10
+#define LOOPBACK_MLS_LEN ((1 << LOOPBACK_MLS_ORDER) - 1) // 1023 samples, 64 ms at 16 kHz
+#define LOOPBACK_AMPLITUDE 6000
+#define LOOPBACK_MAX_LAG_MS 250 // Longest round trip searched
+#define LOOPBACK_TRIALS 8
+#define LOOPBACK_CLIP_LEVEL 32000
+#define LOOPBACK_MIN_PEAK_RATIO 4 // Correlation peak over mean, below this no echo was heard
+
+struct LoopbackResult
+{
+  int trials;        // Trials where the sequence was found
+  float latencyMs;   // Mean round trip
+  float minMs;
+  float maxMs;
+  float jitterMs;    // Standard deviation
+  uint32_t clipped;  // Capture samples at or above LOOPBACK_CLIP_LEVEL
+  float peakRatio;   // Worst trial, correlation peak over mean
+};
+
+// Run the measurement and print a report. dmaBufLen is the mic DMA buffer
+// length in samples, used to line the capture up with a buffer boundary.
+bool loopbackMeasure(i2s_port_t speaker, i2s_port_t mic, uint32_t sampleRate, int dmaBufLen,
+                     LoopbackResult &result);
+
+// One period of a 1 kHz sine at 16 kHz, for tone tests
+extern const int16_t sineTable1k[16];
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Heap and stack telemetry.
+//
+// memSample(point) records free heap, the largest free block, free PSRAM
+// and the calling task's stack high-water mark under a named point, and
+// keeps the worst value seen for each. Pipeline stage boundaries, boot
+// tasks and the big JSON documents are sampled, so the report shows where
+// memory runs lowest and how much stack each task really uses.
+//
+// memPoll() logs a heap trend line every MEM_TREND_MS and warns when the
+// largest free block gets too small for a TLS handshake.
+
+#define MEM_POINTS 24          // Distinct sample points tracked
+#define MEM_TREND_MS 60000
+#define MEM_LOW_BLOCK 20000    // Largest block below this and TLS may fail
+
+// MEM_TELEMETRY=0 compiles the sample points out, as LOG_LEVEL=0 does for
+// logging; the host tests have no heap or tasks to sample
+#ifndef MEM_TELEMETRY
+#define MEM_TELEMETRY 1
+#endif
+
+// point must be a string literal, it is kept by pointer
+#if MEM_TELEMETRY
+void memSample(const char *point);
+#else
+inline void memSample(const char *point)
+{
+}
+#endif
+
+void memPoll();
+
+// Current heap state, per-point worst case and task stack high-water marks
+void memReport();
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include "http_response.h"
+
+// Persistent queue of recordings captured while offline.
+//
+// A queued recording is moved into QUEUE_DIR with a sequence number in
+// front of its name, so the queue survives a reboot and drains oldest
+// first. It is only moved back out once its request has succeeded.
+//
+// Draining reuses one keep-alive connection and pipelines requests: up to
+// QUEUE_PIPELINE_DEPTH uploads are on the wire while the oldest response
+// is read. If the server closes the connection, the unanswered jobs are
+// sent again on a new one. A drain that leaves jobs behind (no internet,
+// server errors) holds off the next one, from QUEUE_RETRY_MIN_MS doubling
+// up to QUEUE_RETRY_MAX_MS, so the loop is not blocked by a connect
+// timeout on every pass and the same batch is not uploaded again and again.
+
+#define QUEUE_DIR "/queue"
+#define QUEUE_BATCH 8          // Jobs per drain call
+#define QUEUE_PIPELINE_DEPTH 2 // Requests in flight on the connection
+#define QUEUE_MAX_RECONNECTS 3 // Per drain call
+#define QUEUE_JOB_TIMEOUT_MS 20000
+#define QUEUE_RETRY_MIN_MS 10000
+#define QUEUE_RETRY_MAX_MS 600000
+
+// Write one request for the recording at path
+typedef bool (*QueueSendFn)(WiFiClient &client, const char *path);
+// A response for the job arrived, return false to keep it queued
+typedef bool (*QueueDoneFn)(void *ctx, const char *path, const HttpResponse &r, const String &body);
+
+struct QueueTarget
+{
+  const char *host;
+  uint16_t port;
+  QueueSendFn send;
+  QueueDoneFn done;
+  void *ctx;
+};
+
+// Create QUEUE_DIR and count jobs left from before a reboot
+bool queueBegin();
+// Move a recording into the queue
+bool queueAdd(const char *path);
+int queuePending();
+
+// Drain up to QUEUE_BATCH jobs, returns how many completed. Does nothing
+// while a failed drain is backing off.
+int queueDrain(WiFiClientSecure &client, const QueueTarget &target);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Spoken prompts linked into the firmware.
+//
+// scripts/prompt_bank.py runs before every ESP32 build. For each entry of
+// PROMPT_LIST it converts prompts/<name>.wav to 16 kHz mono 16-bit PCM,
+// trims the silence at both ends and emits a const table, which the
+// linker keeps in flash. A prompt without a WAV gets the earcon named in
+// its entry instead, so every prompt is audible. Playing one needs no SD,
+// no network and no decoding.
+
+#define PROMPT_SAMPLE_RATE 16000
+
+// X(id, file name, fallback earcon: ACK, UP, DOWN or ERROR)
+#define PROMPT_LIST(X)                      \
+  X(PROMPT_OK, "ok", ACK)                   \
+  X(PROMPT_LIGHT_ON, "light_on", UP)        \
+  X(PROMPT_LIGHT_OFF, "light_off", DOWN)    \
+  X(PROMPT_NOT_CAUGHT, "not_caught", ERROR) \
+  X(PROMPT_QUEUED, "queued", ACK)           \
+  X(PROMPT_WIFI_LOST, "wifi_lost", ERROR)   \
+  X(PROMPT_WIFI_BACK, "wifi_back", UP)      \
+  X(PROMPT_GOODBYE, "goodbye", DOWN)
+
+enum PromptId
+{
+#define PROMPT_ENUM(id, name, earcon) id,
+  PROMPT_LIST(PROMPT_ENUM)
+#undef PROMPT_ENUM
+  PROMPT_COUNT
+};
+
+struct PromptClip
+{
+  const char *name;
+  const int16_t *samples;
+  uint32_t count;
+  bool spoken; // false if it is the fallback earcon
+};
+
+// Generated, indexed by PromptId
+extern const PromptClip promptClips[PROMPT_COUNT];
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Soak test: thousands of scripted voice turns in a row, watching for the
+// slow trends that only show after days in the field.
+//
+// Every turn is routed to the backends named SOAK_BACKEND, i.e. the
+// mock services of scripts/mock_backend.py on the LAN, so a run costs no
+// API quota and does not depend on the cloud. After each turn the device
+// samples heap use and fragmentation, per-stage latency, open sockets,
+// open files, the task count, the time of a fixed SD write and the space
+// used on the card, and appends them to SOAK_CSV. Past the warm-up, a
+// least-squares line through each metric gives its growth per 100
+// turns. A metric that grows faster than its limit fails the run; the
+// verdict comes every SOAK_CHECK_EVERY turns and at the end.
+
+#define SOAK_BACKEND "lan"
+#define SOAK_DEFAULT_CYCLES 2000
+#define SOAK_WARMUP 20       // Turns before the trend lines start: TLS caches, pools, p95 history
+#define SOAK_MIN_SAMPLES 50  // Turns in the trend before it can fail the run
+#define SOAK_CHECK_EVERY 100
+#define SOAK_MAX_FAILED_PCT 5
+#define SOAK_CSV "/soak.csv"
+#define SOAK_PROBE "/soak_probe.bin"
+#define SOAK_PROBE_BYTES 16384
+
+// Runs one scripted turn; cycle counts from 0
+typedef void (*SoakTurn)(uint32_t cycle);
+
+void soakStart(uint32_t cycles, SoakTurn turn);
+void soakStop(const char *why);
+bool soakActive();
+
+// Run the next turn and sample it, call it from loop()
+void soakPoll();
+
+void soakReport();
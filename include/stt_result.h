@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming extractor for Deepgram /v1/listen results, replacing the
+// indexOf-based json_object().
+//
+// Body bytes are fed as they arrive, in pieces of any size. A small JSON
+// tokenizer tracks where it is in the document and only keeps what sits
+// under results.channels[0].alternatives: the transcript is unescaped
+// (including \uXXXX and surrogate pairs) straight into a fixed buffer,
+// together with its confidence and per-word timings, plus the text and
+// confidence of further alternatives when those were requested. Once the
+// alternatives array closes the result is complete and the feed returns
+// false, so the caller can stop reading the rest of the body (paragraphs,
+// utterances, ...). Nothing is allocated.
+
+#define STT_RESULT_TEXT_MAX 1024   // Alternative 0, a 30 s long-form segment fits
+#define STT_RESULT_WORDS_MAX 128   // Word timings kept, the rest are counted
+#define STT_RESULT_ALTS_MAX 3      // Alternatives kept, including the first
+#define STT_RESULT_ALT_TEXT_MAX 128
+#define STT_RESULT_DEPTH 16        // Deeper JSON is rejected
+#define STT_RESULT_TOKEN_MAX 24    // Keys and numbers, longer ones are ignored
+
+struct SttWord
+{
+  uint32_t startMs;
+  uint32_t endMs;
+  float confidence;
+};
+
+struct SttResult
+{
+  // Channel 0, alternative 0
+  char transcript[STT_RESULT_TEXT_MAX];
+  uint16_t length;
+  float confidence;    // -1 if not in the response
+  SttWord words[STT_RESULT_WORDS_MAX];
+  uint16_t wordCount;  // Stored in words
+  uint16_t wordsTotal; // In the response
+
+  // Further alternatives, with alternatives=N in the request
+  uint8_t alternatives; // In the response, including the first
+  char altTranscript[STT_RESULT_ALTS_MAX - 1][STT_RESULT_ALT_TEXT_MAX];
+  float altConfidence[STT_RESULT_ALTS_MAX - 1];
+
+  bool truncated; // Some text did not fit and was cut at a character
+  bool complete;  // Channel 0's alternatives were read to the end
+  bool failed;    // Not valid JSON
+  uint32_t bytes; // Parsed so far
+  char head[64];  // Start of the body, for error messages
+
+  // Tokenizer
+  uint8_t state;
+  uint8_t depth;
+  uint8_t target; // Where string characters go
+  uint8_t hexDigits;
+  uint16_t hex;
+  uint16_t highSurrogate;
+  uint16_t targetLen;
+  bool targetFull;
+  uint8_t tokenLen;
+  char token[STT_RESULT_TOKEN_MAX];
+  struct
+  {
+    bool array;
+    uint8_t key;    // Last key read, for objects
+    uint16_t index; // Current element, for arrays
+  } levels[STT_RESULT_DEPTH];
+};
+
+void sttResultInit(SttResult &r);
+
+// Feed body bytes. Returns false once nothing more is needed: the result
+// is complete, the JSON ended without one, or it is not valid JSON.
+bool sttResultFeed(SttResult &r, const uint8_t *data, size_t len);
+
+// HttpBodyCallback adapter, ctx is the SttResult
+bool sttResultBody(void *ctx, const uint8_t *data, size_t len);
+
+// Words with their timings and confidence, at debug level
+void sttResultLog(const SttResult &r);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+
+// Live transcription over a Deepgram /v1/listen WebSocket.
+//
+// The stream is opened in the background ahead of time and kept alive
+// while idle, so a recording can start streaming mic audio at once.
+// Interim results build a running hypothesis (finalized segments plus
+// the current interim); once it has stayed the same for STT_STABLE_MS,
+// or Deepgram flags the end of speech, sttStreamStable() hands it out so
+// the LLM request can start before the final transcript. Each utterance
+// uses one stream: sttStreamFinish() closes it and the caller reopens.
+//
+// STT_STREAM_HOST, _PORT and _TLS can be set from build flags to point the
+// stream at scripts/mock_stt_stream.py instead, see [env:esp32-s3-mockstt].
+
+#ifndef STT_STREAM_HOST
+#define STT_STREAM_HOST "api.deepgram.com"
+#endif
+#ifndef STT_STREAM_PORT
+#define STT_STREAM_PORT 443
+#endif
+#ifndef STT_STREAM_TLS
+#define STT_STREAM_TLS 1
+#endif
+#define STT_STREAM_PATH                                                                      \
+  "/v1/listen?model=nova-2-general&language=en&smart_format=true&numerals=true"             \
+  "&encoding=linear16&sample_rate=16000&channels=1&interim_results=true&endpointing=300"
+#define STT_TEXT_MAX 512
+#define STT_STABLE_MS 600        // Hypothesis unchanged this long counts as stable
+#define STT_KEEPALIVE_MS 5000    // Deepgram closes streams that get nothing for 10 s
+#define STT_RETRY_MS 5000        // Wait after a failed open
+#define STT_OPEN_TIMEOUT_MS 10000
+
+// Open in a background task, no-op while open or opening
+void sttStreamOpen(WiFiClientSecure &tcp, const char *apiKey);
+void sttStreamClose();
+
+// Open and not in an utterance
+bool sttStreamReady();
+
+// Start streaming an utterance, false if the stream is not ready
+bool sttStreamStart();
+
+// An utterance has been started and not finished yet
+bool sttStreamActive();
+
+// Send mic audio of the current utterance
+void sttStreamSend(const int16_t *samples, size_t count);
+
+// Read results and keep an idle stream alive, call from the main loop
+void sttStreamPoll();
+
+// Stable hypothesis of the current utterance, or NULL. Each one is only
+// returned once.
+const char *sttStreamStable();
+
+// Flush the stream and wait for the final transcript. Closes the stream;
+// false if it failed and the recording has to be sent instead.
+bool sttStreamFinish(String &transcript, uint32_t deadline);
+
+// Same words, ignoring case and punctuation
+bool sttSameWords(const char *a, const char *b);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decoder for TTS downloads.
+//
+// Deepgram sends speech as 8-bit mu-law on request, half the bytes of
+// linear16 at the same rate. The body is fed as it arrives, in pieces of
+// any size; each byte is expanded through a 256-entry table into a block
+// of 16-bit samples, and every full block goes to the sink (the WAV file
+// the answer plays from). linear16 takes the same path, so a sample split
+// across two network reads is put back together in both cases. Opus and
+// MP3 would save more but need a codec library this firmware does not
+// carry; mu-law decodes in a table lookup per sample.
+
+#define TTS_DECODE_BLOCK 512 // Samples per sink call
+#define TTS_BENCH_DIR "/ttsbench" // Recorded responses, from scripts/tts_bench.py
+
+enum TtsEncoding
+{
+  TTS_LINEAR16 = 0,
+  TTS_MULAW
+};
+
+typedef bool (*TtsPcmSink)(void *ctx, const int16_t *samples, size_t count);
+
+struct TtsDecoder
+{
+  TtsEncoding encoding;
+  TtsPcmSink sink;
+  void *ctx;
+  int16_t block[TTS_DECODE_BLOCK];
+  uint16_t fill;
+  bool hasOdd; // linear16: low byte of a sample still waiting for its high byte
+  uint8_t odd;
+  bool failed; // The sink refused a block
+  uint32_t samples;
+};
+
+const char *ttsEncodingName(TtsEncoding encoding);
+
+// G.711 mu-law, one sample
+int16_t ttsMulawExpand(uint8_t u);
+uint8_t ttsMulawCompress(int pcm);
+
+void ttsDecodeInit(TtsDecoder &d, TtsEncoding encoding, TtsPcmSink sink, void *ctx);
+
+// Feed body bytes, false once the sink fails
+bool ttsDecodeFeed(TtsDecoder &d, const uint8_t *data, size_t len);
+
+// HttpBodyCallback adapter, ctx is the TtsDecoder
+bool ttsDecodeBody(void *ctx, const uint8_t *data, size_t len);
+
+// Hand the last partial block to the sink
+bool ttsDecodeFlush(TtsDecoder &d);
+
+// Decode time per second of speech for both encodings, on the recorded
+// responses in TTS_BENCH_DIR or, without them, on the prompt bank
+void ttsDecodeBenchmark(int iterations);
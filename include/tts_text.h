@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Text normalization for TTS input, replacing the old ASCII-only filter.
+//
+// One pass from the input into a caller-supplied buffer, no allocation:
+//   - markdown from Gemini is stripped (emphasis, headings, bullets,
+//     code ticks, [links](url) keep only their text)
+//   - speakable punctuation (. , ! ? ' " : ; - parentheses) is kept,
+//     typographic quotes and dashes are mapped to plain ones
+//   - symbols are spelled out: & % + = @ and degrees, currency is read
+//     after its amount ("$5" -> "five dollars")
+//   - integers below a million and decimals are spelled out, years and
+//     numbers glued to letters ("3rd", "mp3") are left to the TTS
+//   - non-ASCII UTF-8 text passes through, emoji and invalid bytes are
+//     dropped, line breaks become sentence breaks
+// Output always fits outSize with a terminator and ends on a whole
+// UTF-8 character.
+
+#define TTS_TEXT_MAX 1024 // Normalized text buffer used for Gemini answers
+#define TTS_CHUNK_MAX 500 // Longest text per TTS request
+
+size_t ttsNormalize(const char *in, char *out, size_t outSize);
+
+// Length of the first chunk of text that fits maxLen, split at a sentence
+// end if possible, then a clause, then a word, then a character
+size_t ttsChunk(const char *text, size_t maxLen);
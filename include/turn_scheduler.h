@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+
+// Per-turn latency budget for the STT -> LLM -> TTS pipeline.
+//
+// A turn gets TURN_BUDGET_MS in total. When a stage starts it is given the
+// remaining time weighted by its share of the stages still to run, so time
+// saved by a fast STT rolls over to the LLM and TTS. Every network call in
+// the stage works against that deadline instead of its own fixed timeout.
+
+enum TurnStage
+{
+  STAGE_STT = 0,
+  STAGE_LLM,
+  STAGE_TTS,
+  STAGE_COUNT
+};
+
+#define TURN_BUDGET_MS 30000
+#define STAGE_HISTORY 32     // Latency samples kept per stage for the p95
+#define STAGE_MIN_SAMPLES 8  // No p95 (and no hedging) until we have this many
+
+#define CONNECT_RETRIES 3
+#define CONNECT_BACKOFF_MS 250 // Base for exponential backoff with full jitter
+#define CONNECT_TIMEOUT_MS 5000
+
+void turnBegin(uint32_t budgetMs = TURN_BUDGET_MS);
+
+// Start a stage, returns its deadline in millis()
+uint32_t stageBegin(TurnStage stage);
+void stageEnd(TurnStage stage, bool ok);
+
+uint32_t stageDeadline(TurnStage stage);
+uint32_t msUntil(uint32_t deadline); // 0 once the deadline has passed
+uint32_t stageP95(TurnStage stage);  // 0 until STAGE_MIN_SAMPLES are recorded
+uint32_t stageElapsed(TurnStage stage); // This turn, 0 if the stage did not run
+bool stageOk(TurnStage stage);
+
+// Print per-stage time against budget for the turn that just ended
+void turnReport();
+
+// Connect, retrying connect failures with jittered exponential backoff
+// for as long as the deadline allows
+bool connectWithRetry(WiFiClientSecure &client, const char *host, uint16_t port, uint32_t deadline);
+// Same for plain TCP, e.g. servers on the LAN
+bool connectWithRetry(WiFiClient &client, const char *host, uint16_t port, uint32_t deadline);
+
+// Hedged requests: run fn(primary) in a task, and if it has not finished
+// after hedgeAfterMs start fn(hedge) as a duplicate. The first to succeed
+// wins. Both contexts must be heap objects released by release(); the race
+// frees them once the slower request has also finished, so the caller
+// must copy what it needs out of the winner before calling hedgeDone().
+//
+// Returns the winning context or NULL if neither succeeded by deadline.
+typedef bool (*HedgedRequest)(void *ctx, uint32_t deadline);
+typedef void (*HedgeRelease)(void *ctx);
+
+struct HedgeRace;
+
+void *hedgedCall(HedgedRequest fn, void *primary, void *hedge, HedgeRelease release,
+                 uint32_t hedgeAfterMs, uint32_t deadline, HedgeRace **race);
+void hedgeDone(HedgeRace *race);
+
+// Background request: start fn(ctx) in a task and collect it later with
+// backgroundWait(), or abandon it. Either way finish with hedgeDone(); an
+// abandoned request runs to completion and then releases ctx. Returns
+// NULL (ctx released) if the task could not start.
+HedgeRace *backgroundStart(HedgedRequest fn, void *ctx, HedgeRelease release, uint32_t deadline);
+
+// Wait for the request until deadline, returns ctx if it succeeded
+void *backgroundWait(HedgeRace *race, uint32_t deadline);
+
+// The request has finished, successfully or not
+bool backgroundDone(HedgeRace *race);
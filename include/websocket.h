@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include "http_response.h"
+
+// Minimal WebSocket client (RFC 6455) over an existing TLS or plain TCP
+// client.
+//
+// The upgrade response goes through the shared HTTP parser. After that,
+// frames are parsed incrementally as bytes arrive: text messages are
+// reassembled into a fixed buffer and handed to a callback, pings are
+// answered, and a close frame ends the connection. Messages larger than
+// WS_MAX_MESSAGE are skipped. Outgoing frames are masked in chunks, so
+// sending never allocates.
+
+#define WS_MAX_MESSAGE 4096
+#define WS_SEND_CHUNK 1024 // One audio buffer fits in a single TLS record
+
+typedef void (*WsTextCallback)(void *ctx, const char *text, size_t len);
+
+struct WsClient
+{
+  WiFiClient *tcp;
+  bool open;
+  HttpCarry carry; // Bytes that arrived with the upgrade response
+
+  // Frame being parsed
+  uint8_t header[14];
+  uint8_t headerLen;
+  uint8_t headerNeed;
+  uint8_t opcode;
+  bool fin;
+  uint32_t remaining;
+
+  // Message being reassembled
+  uint8_t messageOpcode;
+  size_t messageLen;
+  bool oversize;
+  uint8_t control[125];
+  uint8_t controlLen;
+  char message[WS_MAX_MESSAGE + 1];
+
+  WsTextCallback onText;
+  void *ctx;
+};
+
+// Connect and upgrade. headers are extra request header lines, each
+// ending in \r\n (or NULL).
+bool wsConnect(WsClient &ws, WiFiClientSecure &tcp, const char *host, uint16_t port, const char *path,
+               const char *headers, WsTextCallback onText, void *ctx, uint32_t deadline);
+// Same over plain TCP, e.g. a mock server on the LAN
+bool wsConnect(WsClient &ws, WiFiClient &tcp, const char *host, uint16_t port, const char *path,
+               const char *headers, WsTextCallback onText, void *ctx, uint32_t deadline);
+
+bool wsSendBinary(WsClient &ws, const uint8_t *data, size_t len);
+bool wsSendText(WsClient &ws, const char *text);
+
+// Parse whatever has arrived, without blocking. Returns false once the
+// connection is closed.
+bool wsPoll(WsClient &ws);
+
+void wsClose(WsClient &ws);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Event-driven Wi-Fi station management.
+//
+// wifiBegin() starts association and returns at once. The channel and
+// BSSID of the last good connection are kept in NVS, so a cold boot joins
+// that AP directly without a full channel scan. If the cached AP is gone
+// the cache is dropped and the next attempt scans. Drops are retried
+// from wifiPoll() with jittered exponential backoff, not by the driver.
+
+#define WIFI_BACKOFF_MIN_MS 500
+#define WIFI_BACKOFF_MAX_MS 30000
+#define WIFI_ATTEMPT_TIMEOUT_MS 10000 // Give up on an attempt that never reports back
+
+enum WifiState
+{
+  WIFI_STATE_IDLE,
+  WIFI_STATE_CONNECTING,
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_BACKOFF
+};
+
+void wifiBegin(const char *ssid, const char *password);
+// Call from loop(): starts retries when their backoff expires
+void wifiPoll();
+
+WifiState wifiState();
+bool wifiConnected();
+// Wait up to timeoutMs for a connect or retry to succeed, true once connected
+bool wifiWaitConnected(uint32_t timeoutMs);
+void wifiReport();
@@ -0,0 +1,322 @@
+"""Host side of the binary USB CDC link (include/host_link.h).
+
+Switches the console into host mode with '!', then:
+    python scripts/jarvis_host.py info
+    python scripts/jarvis_host.py mic --seconds 30 --out mic.wav
+    python scripts/jarvis_host.py list
+    python scripts/jarvis_host.py fetch /rec_3.wav --out-dir field/
+    python scripts/jarvis_host.py fetch --all --out-dir field/
+    python scripts/jarvis_host.py telemetry --period-ms 500 --seconds 600 --out telemetry.csv
+    python scripts/jarvis_host.py bench --seconds 5
+
+Every command reports its sustained throughput. Linux only, no
+dependencies: the port is opened raw through termios. Device log lines
+that arrive between frames are shown on stderr with --verbose.
+"""
+
+import argparse
+import binascii
+import csv
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+import wave
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<2sBBH")  # sync, type, seq, length
+KEEPALIVE_S = 2.0  # The device leaves host mode after 5 s without requests
+
+REQ_HELLO, REQ_MIC, REQ_LIST, REQ_FETCH, REQ_TELEMETRY, REQ_BENCH, REQ_EXIT = range(1, 8)
+MSG_HELLO, MSG_MIC, MSG_FILE, MSG_DATA, MSG_DONE, MSG_TELEMETRY, MSG_BENCH = range(0x81, 0x88)
+STATUS = {0: "ok", 1: "not found", 2: "read error", 3: "bad request"}
+
+TELEMETRY = struct.Struct("<IIIIIIIIIIb")
+TELEMETRY_FIELDS = ["uptime_ms", "free_heap", "min_free_heap", "largest_block", "free_psram", "mic_buffers",
+                    "mic_drops", "speaker_drops", "stream_drops", "tx_bytes", "rssi"]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as link_crc16_update() in jarvis_link.h."""
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+class Link:
+    def __init__(self, port, verbose):
+        self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.verbose = verbose
+        self.buf = bytearray()
+        self.text = bytearray()
+        self.seq = None
+        self.lost = 0     # Frames missing from the sequence
+        self.bad = 0      # Frames with a bad CRC
+        self.rx_bytes = 0
+        self.tx_seq = 0
+        self.last_keepalive = 0.0
+
+    def send(self, kind, payload=b""):
+        body = struct.pack("<BBH", kind, self.tx_seq & 0xFF, len(payload)) + payload
+        os.write(self.fd, SYNC + body + struct.pack("<H", crc16(body)))
+        self.tx_seq += 1
+
+    def start(self):
+        os.write(self.fd, b"!")
+        for _ in range(3):
+            self.send(REQ_HELLO)
+            frame = self.wait(MSG_HELLO, timeout=1.0)
+            if frame:
+                version, rate, max_payload = struct.unpack("<BIH", frame[:7])
+                return version, rate, max_payload
+        sys.exit("No answer from the device, is the console free and the firmware current?")
+
+    def close(self):
+        self.send(REQ_EXIT)
+        os.close(self.fd)
+
+    def frames(self, timeout):
+        """Yield (type, payload) until timeout seconds pass without a frame."""
+        deadline = time.monotonic() + timeout
+        while True:
+            now = time.monotonic()
+            if now - self.last_keepalive > KEEPALIVE_S:
+                self.send(REQ_HELLO)
+                self.last_keepalive = now
+            frame = self.parse()
+            if frame:
+                deadline = time.monotonic() + timeout
+                yield frame
+                continue
+            if now > deadline:
+                return
+            ready, _, _ = select.select([self.fd], [], [], min(0.1, deadline - now))
+            if ready:
+                data = os.read(self.fd, 65536)
+                self.rx_bytes += len(data)
+                self.buf += data
+
+    def wait(self, kind, timeout):
+        for frame_kind, payload in self.frames(timeout):
+            if frame_kind == kind:
+                return payload
+        return None
+
+    def parse(self):
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.show_text(self.buf[:len(self.buf) - keep])
+                del self.buf[:len(self.buf) - keep]
+                return None
+            self.show_text(self.buf[:start])
+            del self.buf[:start]
+            if len(self.buf) < HEADER.size:
+                return None
+            _, kind, seq, length = HEADER.unpack_from(self.buf)
+            end = HEADER.size + length + 2
+            if len(self.buf) < end:
+                return None
+            body = bytes(self.buf[2:HEADER.size + length])
+            (crc,) = struct.unpack_from("<H", self.buf, end - 2)
+            if crc16(body) != crc:
+                self.bad += 1
+                del self.buf[:1]  # Resync past this sync pair
+                continue
+            del self.buf[:end]
+            if self.seq is not None:
+                self.lost += (seq - self.seq - 1) & 0xFF
+            self.seq = seq
+            return kind, body[HEADER.size - 2:]
+
+    def show_text(self, data):
+        if not data:
+            return
+        self.text += data
+        *lines, rest = self.text.split(b"\n")
+        for line in lines:
+            if self.verbose:
+                print("device: " + line.decode(errors="replace").rstrip(), file=sys.stderr)
+        self.text = bytearray(rest)
+
+
+def rate(nbytes, seconds):
+    return "%.1f KB/s" % (nbytes / 1024 / seconds) if seconds > 0 else "-"
+
+
+def cmd_info(link, args, hello):
+    version, sample_rate, max_payload = hello
+    print("Protocol %d, mic %d Hz, frames up to %d bytes" % (version, sample_rate, max_payload))
+
+
+def cmd_mic(link, args, hello):
+    sample_rate = hello[1]
+    want = int(args.seconds * sample_rate)
+    pcm = bytearray()
+    first = None
+    gaps = gap_samples = 0
+    link.send(REQ_MIC, b"\x01")
+    t0 = time.monotonic()
+    for kind, payload in link.frames(timeout=2.0):
+        if kind != MSG_MIC:
+            continue
+        (index,) = struct.unpack_from("<I", payload)
+        if first is None:
+            first = index
+        expected = first + len(pcm) // 2
+        if index > expected:
+            # The device had no room for these, keep the timeline with silence
+            gaps += 1
+            gap_samples += index - expected
+            pcm += bytes(2 * (index - expected))
+        pcm += payload[4:]
+        if len(pcm) // 2 >= want:
+            break
+    elapsed = time.monotonic() - t0
+    link.send(REQ_MIC, b"\x00")
+
+    with wave.open(args.out, "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(sample_rate)
+        w.writeframes(bytes(pcm[:want * 2]))
+    print("%s: %.1f s of audio in %.1f s, %s, %d gaps (%d samples), %d frames lost, %d bad" %
+          (args.out, len(pcm) / 2 / sample_rate, elapsed, rate(len(pcm), elapsed), gaps, gap_samples,
+           link.lost, link.bad))
+
+
+def list_files(link):
+    files = []
+    link.send(REQ_LIST)
+    for kind, payload in link.frames(timeout=5.0):
+        if kind == MSG_FILE:
+            (size,) = struct.unpack_from("<I", payload)
+            files.append((payload[4:].decode(errors="replace"), size))
+        elif kind == MSG_DONE and payload[0] == REQ_LIST:
+            return files
+    sys.exit("File list timed out")
+
+
+def cmd_list(link, args, hello):
+    for path, size in list_files(link):
+        print("%10d  %s" % (size, path))
+
+
+def fetch(link, path, out_dir):
+    link.send(REQ_FETCH, path.encode())
+    out = None
+    size = received = 0
+    t0 = time.monotonic()
+    for kind, payload in link.frames(timeout=5.0):
+        if kind == MSG_FILE and out is None:
+            (size,) = struct.unpack_from("<I", payload)
+            out = open(os.path.join(out_dir, os.path.basename(path)), "wb")
+        elif kind == MSG_DATA and out:
+            (offset,) = struct.unpack_from("<I", payload)
+            if offset != received:
+                out.close()
+                return "lost data at offset %d (expected %d)" % (offset, received)
+            out.write(payload[4:])
+            received += len(payload) - 4
+        elif kind == MSG_DONE and payload[0] == REQ_FETCH:
+            elapsed = time.monotonic() - t0
+            if out:
+                out.close()
+            status = STATUS.get(payload[1], str(payload[1]))
+            if status != "ok":
+                return status
+            return "%d of %d bytes in %.2f s, %s" % (received, size, elapsed, rate(received, elapsed))
+    if out:
+        out.close()
+    return "timed out after %d bytes" % received
+
+
+def cmd_fetch(link, args, hello):
+    os.makedirs(args.out_dir, exist_ok=True)
+    paths = [p for p, _ in list_files(link)] if args.all else args.paths
+    if not paths:
+        sys.exit("Nothing to fetch, name files or use --all")
+    total = 0
+    t0 = time.monotonic()
+    rx0 = link.rx_bytes
+    for path in paths:
+        print("%s: %s" % (path, fetch(link, path, args.out_dir)))
+    total = link.rx_bytes - rx0
+    elapsed = time.monotonic() - t0
+    print("%d files, %d bytes on the link in %.1f s, sustained %s" % (len(paths), total, elapsed, rate(total, elapsed)))
+
+
+def cmd_telemetry(link, args, hello):
+    link.send(REQ_TELEMETRY, struct.pack("<H", args.period_ms))
+    rows = 0
+    t0 = time.monotonic()
+    with open(args.out, "w", newline="") as f:
+        out = csv.writer(f)
+        out.writerow(["host_time"] + TELEMETRY_FIELDS)
+        for kind, payload in link.frames(timeout=max(2.0, 3 * args.period_ms / 1000)):
+            if kind != MSG_TELEMETRY:
+                continue
+            out.writerow(["%.3f" % time.time()] + list(TELEMETRY.unpack_from(payload)))
+            f.flush()
+            rows += 1
+            if time.monotonic() - t0 >= args.seconds:
+                break
+    link.send(REQ_TELEMETRY, struct.pack("<H", 0))
+    print("%s: %d rows" % (args.out, rows))
+
+
+def cmd_bench(link, args, hello):
+    link.send(REQ_BENCH, struct.pack("<H", args.seconds))
+    payload_bytes = frames = 0
+    t0 = None
+    for kind, payload in link.frames(timeout=2.0):
+        if kind == MSG_BENCH:
+            t0 = t0 or time.monotonic()
+            frames += 1
+            payload_bytes += len(payload)
+        elif kind == MSG_DONE and payload[0] == REQ_BENCH:
+            (sent,) = struct.unpack_from("<I", payload, 2)
+            elapsed = time.monotonic() - (t0 or time.monotonic())
+            print("%d of %d frames, %d payload bytes in %.2f s: %s sustained, %d lost, %d bad" %
+                  (frames, sent, payload_bytes, elapsed, rate(payload_bytes, elapsed), link.lost, link.bad))
+            return
+    sys.exit("Benchmark timed out")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", default="/dev/ttyACM0")
+    parser.add_argument("--verbose", action="store_true", help="show device log lines")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    commands.add_parser("info")
+    mic = commands.add_parser("mic", help="record the live mic stream to a WAV")
+    mic.add_argument("--seconds", type=float, default=10)
+    mic.add_argument("--out", default="mic.wav")
+    commands.add_parser("list", help="list files on the SD card")
+    fetch_parser = commands.add_parser("fetch", help="copy SD files to the host")
+    fetch_parser.add_argument("paths", nargs="*")
+    fetch_parser.add_argument("--all", action="store_true")
+    fetch_parser.add_argument("--out-dir", default=".")
+    telemetry = commands.add_parser("telemetry", help="log telemetry to a CSV")
+    telemetry.add_argument("--period-ms", type=int, default=1000)
+    telemetry.add_argument("--seconds", type=float, default=60)
+    telemetry.add_argument("--out", default="telemetry.csv")
+    bench = commands.add_parser("bench", help="raw link throughput")
+    bench.add_argument("--seconds", type=int, default=5)
+    args = parser.parse_args()
+
+    link = Link(args.port, args.verbose)
+    try:
+        hello = link.start()
+        globals()["cmd_" + args.command](link, args, hello)
+    finally:
+        link.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,98 @@
+"""OpenAI-compatible mock of the LAN inference server, for testing routing.
+
+Serves the three endpoints the firmware uses on API_OPENAI backends:
+    POST /v1/audio/transcriptions  -> {"text": ...}
+    POST /v1/chat/completions      -> {"choices": [{"message": {"content": ...}}]}
+    POST /v1/audio/speech          -> raw 16-bit mono PCM, a short tone
+
+Run two of them at different speeds and point two backendTable entries per
+stage at them, e.g.
+    python scripts/mock_backend.py --port 8000 --delay-ms 150
+    python scripts/mock_backend.py --port 8001 --delay-ms 900 --fail-rate 0.2
+then watch the '#' report on the device move traffic to the fast one.
+
+--tail-pct stalls that share of responses for --tail-ms on top of the
+delay, the slow tail that hedged requests ('h') are there for:
+    python scripts/mock_backend.py --port 8000 --delay-ms 300 --tail-pct 2 --tail-ms 4000
+Once the LLM stage has STAGE_MIN_SAMPLES, a stalled chat request gets a
+duplicate on the second backend after the stage p95; compare the turn
+reports with hedging on and off. Keep --tail-pct under 5: a tail that
+reaches the p95 moves the hedge point into it. Each stall is logged.
+"""
+
+import argparse
+import json
+import math
+import random
+import struct
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+TONE_HZ = 660
+TONE_MS = 400
+
+
+def tone(rate):
+    n = rate * TONE_MS // 1000
+    return b"".join(struct.pack("<h", int(6000 * math.sin(2 * math.pi * TONE_HZ * i / rate))) for i in range(n))
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        args = self.server.args
+        delay_ms = random.uniform(0.8, 1.2) * args.delay_ms
+        if random.random() * 100 < args.tail_pct:
+            delay_ms += args.tail_ms
+            print("[%d] stalling %s for %d ms" % (args.port, self.path, delay_ms))
+        time.sleep(delay_ms / 1000)
+
+        if random.random() < args.fail_rate:
+            return self.reply(503, "application/json", b'{"error": "injected failure"}')
+
+        if self.path.startswith("/v1/audio/transcriptions"):
+            text = "what is the weather like today"
+            return self.reply(200, "application/json", json.dumps({"text": text}).encode())
+        if self.path.startswith("/v1/chat/completions"):
+            request = json.loads(body or b"{}")
+            question = request.get("messages", [{}])[-1].get("content", "")
+            answer = "Mock answer from port %d to: %s" % (args.port, question)
+            reply = {"choices": [{"index": 0, "message": {"role": "assistant", "content": answer}}]}
+            return self.reply(200, "application/json", json.dumps(reply).encode())
+        if self.path.startswith("/v1/audio/speech"):
+            return self.reply(200, "audio/pcm", self.server.tone)
+        self.reply(404, "application/json", b'{"error": "not found"}')
+
+    def reply(self, status, content_type, data):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, fmt, *args):
+        print("[%d] %s %s" % (self.server.args.port, self.address_string(), fmt % args))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--delay-ms", type=int, default=200, help="mean response delay, +/-20%%")
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="fraction of requests answered with 503")
+    parser.add_argument("--tail-pct", type=float, default=0.0, help="percent of responses stalled by --tail-ms")
+    parser.add_argument("--tail-ms", type=int, default=3000, help="extra delay of a stalled response")
+    parser.add_argument("--rate", type=int, default=24000, help="TTS sample rate, must match the backend entry")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), Handler)
+    server.args = args
+    server.tone = tone(args.rate)
+    print("Mock backend on port %d, %d ms, %.0f%% failures, %g%% stalled by %d ms" %
+          (args.port, args.delay_ms, args.fail_rate * 100, args.tail_pct, args.tail_ms))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+"""Mock of Deepgram's live /v1/listen WebSocket, for measuring streaming latency.
+
+Replays a scripted utterance against the audio the device streams: each
+event is sent once that much audio (16 kHz linear16) has arrived, and the
+events still due when the device sends CloseStream follow after
+--final-delay-ms, as Deepgram flushes its last results. Build the firmware
+with [env:esp32-s3-mockstt] so the stream comes here instead, then
+    python scripts/mock_stt_stream.py --port 8010
+    python scripts/mock_stt_stream.py --text "turn the light on" --final-delay-ms 250
+    python scripts/mock_stt_stream.py --script utterance.json
+and press 'j' on the device for live mode. A script is a JSON list of
+    {"at_ms": 600, "text": "what is", "is_final": false, "speech_final": false}
+in audio time; by default the words of --text come as growing interims
+and end in one final result with speech_final. --final-text makes the
+final differ from the interims, so the device has to drop its prefetch.
+
+For every utterance this prints when each result went out and how long
+after CloseStream the final one did; compare with the device's "final N ms
+after the end of audio" and the hands-free reply latency report.
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import socketserver
+import struct
+import time
+
+GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+BYTES_PER_MS = 16000 * 2 // 1000
+
+OP_TEXT = 0x1
+OP_BINARY = 0x2
+OP_CLOSE = 0x8
+OP_PING = 0x9
+OP_PONG = 0xA
+
+
+def default_script(text, final_text, speech_ms):
+    words = text.split()
+    step = speech_ms // max(len(words), 1)
+    events = [{"at_ms": step * (i + 1), "text": " ".join(words[:i + 1]), "is_final": False}
+              for i in range(len(words))]
+    events.append({"at_ms": speech_ms + 300, "text": final_text or text, "is_final": True, "speech_final": True})
+    return events
+
+
+def result(event):
+    return json.dumps({
+        "type": "Results",
+        "is_final": event.get("is_final", False),
+        "speech_final": event.get("speech_final", False),
+        "channel": {"alternatives": [{"transcript": event["text"], "confidence": 0.98}]},
+    })
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        args = self.server.args
+        if not self.upgrade():
+            return
+        events = list(self.server.script)
+        audio = 0
+        t0 = time.monotonic()
+        peer = self.client_address[0]
+        print("[%s] stream open" % peer)
+
+        while True:
+            frame = self.read_frame()
+            if frame is None:
+                print("[%s] connection lost after %d ms of audio" % (peer, audio // BYTES_PER_MS))
+                return
+            op, data = frame
+            if op == OP_BINARY:
+                audio += len(data)
+                while events and events[0]["at_ms"] <= audio // BYTES_PER_MS:
+                    self.send_result(events.pop(0), peer, t0)
+            elif op == OP_PING:
+                self.send_frame(OP_PONG, data)
+            elif op == OP_CLOSE:
+                self.send_frame(OP_CLOSE, data[:2])
+                print("[%s] closed by the device" % peer)
+                return
+            elif op == OP_TEXT:
+                message = json.loads(data or b"{}")
+                if message.get("type") != "CloseStream":
+                    continue  # KeepAlive
+                closed = time.monotonic()
+                time.sleep(args.final_delay_ms / 1000)
+                for event in events:
+                    self.send_result(event, peer, t0)
+                self.send_frame(OP_TEXT, json.dumps({"type": "Metadata", "duration": audio / BYTES_PER_MS / 1000}).encode())
+                self.send_frame(OP_CLOSE, struct.pack(">H", 1000))
+                print("[%s] %d ms of audio, last results %.0f ms after CloseStream" %
+                      (peer, audio // BYTES_PER_MS, (time.monotonic() - closed) * 1000))
+                return
+
+    def upgrade(self):
+        headers = {}
+        request = self.rfile.readline()
+        while True:
+            line = self.rfile.readline().decode("latin-1").strip()
+            if not line:
+                break
+            name, _, value = line.partition(":")
+            headers[name.strip().lower()] = value.strip()
+        key = headers.get("sec-websocket-key")
+        if not request.startswith(b"GET ") or not key:
+            self.wfile.write(b"HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n")
+            return False
+        accept = base64.b64encode(hashlib.sha1((key + GUID).encode()).digest()).decode()
+        self.wfile.write(("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Accept: %s\r\n\r\n" % accept).encode())
+        return True
+
+    def read_exact(self, n):
+        data = self.rfile.read(n)
+        return data if len(data) == n else None
+
+    def read_frame(self):
+        header = self.read_exact(2)
+        if header is None:
+            return None
+        op = header[0] & 0x0F
+        length = header[1] & 0x7F
+        if length == 126:
+            length = struct.unpack(">H", self.read_exact(2))[0]
+        elif length == 127:
+            length = struct.unpack(">Q", self.read_exact(8))[0]
+        mask = self.read_exact(4) if header[1] & 0x80 else b"\0\0\0\0"
+        data = self.read_exact(length) if length else b""
+        if mask is None or data is None:
+            return None
+        return op, bytes(b ^ mask[i & 3] for i, b in enumerate(data))
+
+    def send_frame(self, op, data):
+        if len(data) < 126:
+            header = struct.pack(">BB", 0x80 | op, len(data))
+        else:
+            header = struct.pack(">BBH", 0x80 | op, 126, len(data))
+        self.wfile.write(header + data)
+        self.wfile.flush()
+
+    def send_result(self, event, peer, t0):
+        self.send_frame(OP_TEXT, result(event).encode())
+        print("[%s] %6.0f ms  %-7s %s" % (peer, (time.monotonic() - t0) * 1000,
+                                         "final" if event.get("is_final") else "interim", event["text"]))
+
+
+class Server(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8010)
+    parser.add_argument("--text", default="what is the weather like today")
+    parser.add_argument("--final-text", help="final transcript, if it should differ from the interims")
+    parser.add_argument("--speech-ms", type=int, default=1800, help="audio the interims are spread over")
+    parser.add_argument("--final-delay-ms", type=int, default=150, help="CloseStream to last results")
+    parser.add_argument("--script", help="JSON list of events instead of --text")
+    args = parser.parse_args()
+
+    if args.script:
+        with open(args.script) as f:
+            script = sorted(json.load(f), key=lambda e: e["at_ms"])
+    else:
+        script = default_script(args.text, args.final_text, args.speech_ms)
+
+    server = Server(("0.0.0.0", args.port), Handler)
+    server.args = args
+    server.script = script
+    print("Mock live STT on port %d, %d scripted results, final %d ms after CloseStream" %
+          (args.port, len(script), args.final_delay_ms))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
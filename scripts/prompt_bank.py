@@ -0,0 +1,140 @@
+"""Convert prompts/*.wav into const PCM tables linked into the firmware.
+
+Runs as a PlatformIO pre-build script (see platformio.ini). The prompt
+list is PROMPT_LIST in include/prompts.h; each entry names a WAV file in
+prompts/ and the earcon used when that file is missing. The generated
+source goes to the build directory and is only rewritten when it changes,
+so unchanged prompts do not trigger a rebuild.
+
+Can also be run by hand to check the prompts:
+    python scripts/prompt_bank.py [output.cpp]
+"""
+
+import math
+import os
+import re
+import struct
+import sys
+import wave
+
+SAMPLE_RATE = 16000
+SILENCE_LEVEL = 500  # Trimmed at both ends while below this
+SILENCE_MARGIN_MS = 20
+EARCON_AMPLITUDE = 8000
+FADE_MS = 5
+
+# Tone sequences as (Hz, ms), 0 Hz is a gap
+EARCONS = {
+    "ACK": [(1320, 70)],
+    "UP": [(880, 70), (0, 20), (1320, 90)],
+    "DOWN": [(1320, 70), (0, 20), (880, 90)],
+    "ERROR": [(440, 120), (0, 40), (440, 120)],
+}
+
+
+def prompt_list(header):
+    with open(header) as f:
+        text = f.read()
+    entries = re.findall(r'X\((PROMPT_\w+),\s*"(\w+)",\s*(\w+)\)', text)
+    if not entries:
+        sys.exit("prompt_bank: no PROMPT_LIST entries in %s" % header)
+    return entries
+
+
+def read_wav(path):
+    with wave.open(path, "rb") as w:
+        channels = w.getnchannels()
+        width = w.getsampwidth()
+        rate = w.getframerate()
+        frames = w.readframes(w.getnframes())
+
+    if width == 1:
+        samples = [(b - 128) << 8 for b in frames]
+    elif width == 2:
+        samples = list(struct.unpack("<%dh" % (len(frames) // 2), frames))
+    else:
+        sys.exit("prompt_bank: %s is %d-bit, use 8 or 16-bit PCM" % (path, width * 8))
+
+    # Mix down to mono
+    if channels > 1:
+        samples = [sum(samples[i:i + channels]) // channels for i in range(0, len(samples), channels)]
+
+    # Linear interpolation is plenty for speech prompts
+    if rate != SAMPLE_RATE and samples:
+        out_len = len(samples) * SAMPLE_RATE // rate
+        resampled = []
+        for i in range(out_len):
+            pos = i * rate / SAMPLE_RATE
+            j = int(pos)
+            frac = pos - j
+            nxt = samples[min(j + 1, len(samples) - 1)]
+            resampled.append(int(round(samples[j] * (1 - frac) + nxt * frac)))
+        samples = resampled
+    return samples
+
+
+def trim(samples):
+    loud = [i for i, s in enumerate(samples) if abs(s) >= SILENCE_LEVEL]
+    if not loud:
+        return samples
+    margin = SAMPLE_RATE * SILENCE_MARGIN_MS // 1000
+    return samples[max(loud[0] - margin, 0):loud[-1] + margin + 1]
+
+
+def earcon(kind):
+    fade = SAMPLE_RATE * FADE_MS // 1000
+    samples = []
+    for freq, ms in EARCONS[kind]:
+        n = SAMPLE_RATE * ms // 1000
+        for i in range(n):
+            # Fade both ends of each tone, or it clicks
+            gain = min(1.0, i / fade, (n - 1 - i) / fade)
+            samples.append(int(EARCON_AMPLITUDE * gain * math.sin(2 * math.pi * freq * i / SAMPLE_RATE)) if freq else 0)
+    return samples
+
+
+def generate(project_dir):
+    entries = prompt_list(os.path.join(project_dir, "include", "prompts.h"))
+    tables = []
+    clips = []
+    for ident, name, kind in entries:
+        if kind not in EARCONS:
+            sys.exit("prompt_bank: unknown earcon %s for %s" % (kind, ident))
+        path = os.path.join(project_dir, "prompts", name + ".wav")
+        spoken = os.path.exists(path)
+        samples = trim(read_wav(path)) if spoken else earcon(kind)
+        print("prompt_bank: %-12s %5.2f s %s" % (name, len(samples) / SAMPLE_RATE,
+                                                  "from " + name + ".wav" if spoken else "(earcon " + kind + ")"))
+
+        rows = [", ".join(str(s) for s in samples[i:i + 16]) for i in range(0, len(samples), 16)]
+        tables.append("static const int16_t prompt_%s[%d] = {\n    %s};\n" % (name, len(samples), ",\n    ".join(rows)))
+        clips.append('    {"%s", prompt_%s, %d, %s},' % (name, name, len(samples), "true" if spoken else "false"))
+
+    return ("// Generated by scripts/prompt_bank.py from prompts/*.wav, do not edit\n"
+            '#include "prompts.h"\n\n' + "\n".join(tables) +
+            "\nconst PromptClip promptClips[PROMPT_COUNT] = {\n" + "\n".join(clips) + "\n};\n")
+
+
+def write_if_changed(path, text):
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == text:
+                return
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as f:
+        f.write(text)
+
+
+try:
+    Import("env")  # noqa: F821, only defined under PlatformIO
+except NameError:
+    env = None
+
+if env is not None:
+    out_dir = os.path.join(env.subst("$BUILD_DIR"), "prompt_bank")
+    write_if_changed(os.path.join(out_dir, "prompt_data.cpp"), generate(env.subst("$PROJECT_DIR")))
+    env.BuildSources(os.path.join("$BUILD_DIR", "prompt_bank_obj"), out_dir)
+elif __name__ == "__main__":
+    project = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    out = sys.argv[1] if len(sys.argv) > 1 else os.path.join(project, "prompt_data.cpp")
+    write_if_changed(os.path.abspath(out), generate(project))
@@ -0,0 +1,152 @@
+"""Download-time benchmark of mu-law against linear16 Deepgram TTS.
+
+Record the same answers in both encodings, as the firmware requests them
+(container=none, 16 kHz), then compare sizes and download times:
+    python scripts/tts_bench.py record --key $DEEPGRAM_API_KEY --out-dir ttsbench
+    python scripts/tts_bench.py report ttsbench --link-kbs 60,150,400
+
+record writes NAME.pcm, NAME.ulaw and index.csv with the measured time
+to first byte and total download time of each. report projects the
+download time at the given link throughputs (the device's TLS download
+rate, see the "TTS download" log line) and checks that both recordings
+are the same speech. Copy the directory to the SD card as /ttsbench and
+press '^' on the device for the decode cost of the same responses.
+"""
+
+import argparse
+import csv
+import json
+import math
+import os
+import struct
+import time
+import urllib.request
+
+SAMPLE_RATE = 16000
+MODEL = "aura-asteria-en"
+
+# Typical answers after ttsNormalize(), short to long
+TEXTS = {
+    "ack": "Okay, the light is on.",
+    "weather": "It's 25 degrees today with a 40 percent chance of rain and wind at 12 kilometres an hour.",
+    "fact": "Paris is the capital of France, with about two point one million people living in the city itself, "
+            "and more than twelve million in the wider metropolitan area.",
+    "recipe": "Whisk two eggs with a splash of milk and a pinch of salt. Melt a little butter in a pan over "
+              "medium heat, pour in the eggs and stir gently with a spatula until they are just set. Take the "
+              "pan off the heat while they still look slightly wet, because they keep cooking on the plate.",
+}
+
+
+def fetch(key, text, encoding):
+    url = ("https://api.deepgram.com/v1/speak?model=%s&encoding=%s&container=none&sample_rate=%d" %
+           (MODEL, encoding, SAMPLE_RATE))
+    request = urllib.request.Request(url, data=json.dumps({"text": text}).encode(), method="POST",
+                                     headers={"Authorization": "Token " + key, "Content-Type": "application/json"})
+    t0 = time.monotonic()
+    with urllib.request.urlopen(request) as response:
+        first = response.read(1)
+        ttfb = time.monotonic() - t0
+        body = first + response.read()
+    return body, ttfb, time.monotonic() - t0
+
+
+def cmd_record(args):
+    os.makedirs(args.out_dir, exist_ok=True)
+    with open(os.path.join(args.out_dir, "index.csv"), "w", newline="") as f:
+        out = csv.writer(f)
+        out.writerow(["name", "encoding", "bytes", "ttfb_ms", "download_ms"])
+        for name, text in TEXTS.items():
+            for encoding, ext in (("linear16", "pcm"), ("mulaw", "ulaw")):
+                body, ttfb, total = fetch(args.key, text, encoding)
+                with open(os.path.join(args.out_dir, "%s.%s" % (name, ext)), "wb") as audio:
+                    audio.write(body)
+                out.writerow([name, encoding, len(body), round(ttfb * 1000), round(total * 1000)])
+                print("%-8s %-8s %7d bytes, first byte %4.0f ms, all %4.0f ms" %
+                      (name, encoding, len(body), ttfb * 1000, total * 1000))
+
+
+def mulaw_expand(u):
+    """G.711 mu-law to 16-bit, as mulawExpand() in src/tts_decode.cpp."""
+    u = ~u & 0xFF
+    t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4)
+    return 0x84 - t if u & 0x80 else t - 0x84
+
+
+MULAW = [mulaw_expand(u) for u in range(256)]
+
+
+def envelope(samples):
+    window = SAMPLE_RATE // 50  # 20 ms
+    return [math.sqrt(sum(x * x for x in samples[i:i + window]) / window)
+            for i in range(0, len(samples) - window + 1, window)]
+
+
+def similarity(pcm, ulaw):
+    """Correlation of the two recordings' envelopes, 1.0 for the same speech."""
+    env_a = envelope(struct.unpack("<%dh" % (len(pcm) // 2), pcm[:len(pcm) // 2 * 2]))
+    env_b = envelope([MULAW[u] for u in ulaw])
+    n = min(len(env_a), len(env_b))
+    if n < 2:
+        return 0.0
+    env_a, env_b = env_a[:n], env_b[:n]
+    mean_a, mean_b = sum(env_a) / n, sum(env_b) / n
+    cov = sum((x - mean_a) * (y - mean_b) for x, y in zip(env_a, env_b))
+    var = math.sqrt(sum((x - mean_a) ** 2 for x in env_a) * sum((y - mean_b) ** 2 for y in env_b))
+    return cov / var if var else 0.0
+
+
+def cmd_report(args):
+    measured = {}
+    index = os.path.join(args.dir, "index.csv")
+    if os.path.exists(index):
+        with open(index) as f:
+            for row in csv.DictReader(f):
+                measured[(row["name"], row["encoding"])] = int(row["download_ms"])
+
+    speeds = [int(s) for s in args.link_kbs.split(",")]
+    print("%-8s %6s %9s %9s %6s  %s" % ("answer", "speech", "linear16", "mulaw", "match",
+                                       "  ".join("%4d KB/s lin/mu ms" % s for s in speeds)))
+    totals = [0, 0, 0.0]
+    for name in sorted(n[:-4] for n in os.listdir(args.dir) if n.endswith(".pcm")):
+        with open(os.path.join(args.dir, name + ".pcm"), "rb") as f:
+            pcm = f.read()
+        try:
+            with open(os.path.join(args.dir, name + ".ulaw"), "rb") as f:
+                ulaw = f.read()
+        except FileNotFoundError:
+            continue
+        seconds = len(pcm) / 2 / SAMPLE_RATE
+        projected = "  ".join("%9.0f/%-6.0f" % (len(pcm) / s / 1.024, len(ulaw) / s / 1.024) for s in speeds)
+        print("%-8s %5.1fs %9d %9d %6.2f  %s" % (name, seconds, len(pcm), len(ulaw), similarity(pcm, ulaw), projected))
+        if (name, "linear16") in measured:
+            print("%-8s measured here: linear16 %d ms, mulaw %d ms" %
+                  ("", measured[(name, "linear16")], measured[(name, "mulaw")]))
+        totals[0] += len(pcm)
+        totals[1] += len(ulaw)
+        totals[2] += seconds
+
+    if totals[2]:
+        print("\n%.1f s of speech: %d -> %d bytes, %.0f%% less to download, %.1f KB per second of speech" %
+              (totals[2], totals[0], totals[1], 100.0 * (totals[0] - totals[1]) / totals[0],
+               totals[1] / 1024 / totals[2]))
+        for s in speeds:
+            print("  at %4d KB/s: %.2f s saved per second of speech" % (s, (totals[0] - totals[1]) / 1024 / s / totals[2]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    record = commands.add_parser("record", help="fetch the sample answers in both encodings")
+    record.add_argument("--key", default=os.environ.get("DEEPGRAM_API_KEY"))
+    record.add_argument("--out-dir", default="ttsbench")
+    report = commands.add_parser("report", help="compare the recorded responses")
+    report.add_argument("dir")
+    report.add_argument("--link-kbs", default="60,150,400", help="device download rates to project, KB/s")
+    args = parser.parse_args()
+    if args.command == "record" and not args.key:
+        parser.error("record needs --key or DEEPGRAM_API_KEY")
+    {"record": cmd_record, "report": cmd_report}[args.command](args)
+
+
+if __name__ == "__main__":
+    main()
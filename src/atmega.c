@@ -1,11 +1,97 @@
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#ifndef F_CPU
 #define F_CPU 8000000UL
+#endif
 #include <util/delay.h>
+#include "jarvis_link.h"
+
+#ifdef SIMAVR
+// simavr picks these up from the ELF: run with `simavr -f 8000000 -m atmega32`
+// and open jarvis_link.vcd in gtkwave. LINK_PROBE goes high when a frame has
+// been received and low once its ACK is queued, so the pulse width is the
+// ATmega-side command latency; UDR shows the bytes on the wire. LCD_PORTB
+// shows every LCD strobe, so screen update time can be read off too.
+#include "avr_mcu_section.h"
+AVR_MCU(F_CPU, "atmega32");
+AVR_MCU_VCD_FILE("jarvis_link.vcd", 1000);
+const struct avr_mmcu_vcd_trace_t _link_trace[] _MMCU_ = {
+	{ AVR_MCU_VCD_SYMBOL("UDR"), .what = (void*)&UDR, },
+	{ AVR_MCU_VCD_SYMBOL("LINK_PROBE"), .mask = (1 << PD6), .what = (void*)&PORTD, },
+	{ AVR_MCU_VCD_SYMBOL("PORTC"), .what = (void*)&PORTC, },
+	{ AVR_MCU_VCD_SYMBOL("LCD_PORTB"), .what = (void*)&PORTB, },
+};
+#endif
 
 
 // Existing pin definitions
 #define LED_PIN     PC0  // Pin 22 (Output)
-#define CONTROL_PIN PA0  // Pin 40 (Input)
+#define BUTTON_PIN  PD3  // Pin 17 (Input, INT1) - push button to GND
+#define LINK_PROBE  PD6  // Pin 20 (Output) - timing probe for the UART link
+
+// UART link to the ESP32: RXD = PD0 (pin 14), TXD = PD1 (pin 15).
+// The ESP32 is 3.3 V, so put a divider on the TXD -> ESP32 RX line.
+
+// Output channels addressed by LINK_OP_SET_OUTPUT (PC2-PC5 are JTAG).
+// Levels are 0-255; channels 0 and 1 are dimmed by Timer1 software PWM.
+#define OUTPUT_COUNT 4
+#define PWM_CHANNELS 2
+static const uint8_t output_bits[OUTPUT_COUNT] = { PC0, PC1, PC6, PC7 };
+static uint8_t output_level[OUTPUT_COUNT];
+static volatile uint8_t pwm_mask = 0; // PWM channels with 0 < level < 255
+
+// Input channels, reported to the ESP32 as LINK_OP_EVENT frames.
+// IN0 is on INT1 and gets an exact edge timestamp; the PORTA inputs are
+// sampled by the 1 ms tick. All are debounced by the tick. PA0 was the
+// ESP32's control line before the UART link took its GPIO; it is left
+// unconnected now and only pulled up.
+#define INPUT_COUNT 3
+#define INPUT_INT1 0
+#define DEBOUNCE_MS 20
+#define EVENT_QUEUE_SIZE 8 // Power of two
+static volatile uint8_t * const input_pins[INPUT_COUNT] = { &PIND, &PINA, &PINA };
+static const uint8_t input_bits[INPUT_COUNT] = { BUTTON_PIN, PA1, PA2 };
+
+typedef struct {
+	uint8_t stable;    // Debounced level
+	uint8_t count;     // ms the raw level has differed from stable
+	uint32_t edge_us;  // When it started to differ
+} input_state_t;
+static input_state_t inputs[INPUT_COUNT];
+static volatile uint8_t int1_edge_pending = 0;
+static volatile uint32_t int1_edge_us = 0;
+
+typedef struct {
+	uint8_t channel;
+	uint8_t level;
+	uint32_t edge_us;
+} input_event_t;
+static volatile input_event_t event_queue[EVENT_QUEUE_SIZE];
+static volatile uint8_t event_head = 0, event_tail = 0;
+static uint8_t event_seq = 0;
+static uint16_t event_latency_last_us = 0;
+static uint16_t event_latency_max_us = 0;
+
+// Interrupt-driven UART buffers (sizes must be powers of two)
+#define RX_BUF_SIZE 64
+#define TX_BUF_SIZE 64
+static volatile uint8_t rx_buf[RX_BUF_SIZE];
+static volatile uint8_t rx_head = 0, rx_tail = 0;
+static volatile uint8_t tx_buf[TX_BUF_SIZE];
+static volatile uint8_t tx_head = 0, tx_tail = 0;
+
+static link_parser_t link_parser;
+static uint16_t link_frames_ok = 0;
+static uint16_t link_crc_errors = 0;
+static volatile uint16_t link_overruns = 0;
+
+// Last executed frame and the ACK it got, to answer resends without
+// running their records twice
+static uint8_t last_seq = 0;
+static uint16_t last_crc = 0;
+static uint8_t last_ack[LINK_MAX_PAYLOAD + LINK_FRAME_OVERHEAD];
+static uint8_t last_ack_len = 0; // 0 until the first frame
 
 // LCD pin definitions (using PORTB and PD2)
 #define LCD_RS PB0
@@ -15,50 +101,243 @@
 #define LCD_D6 PB4
 #define LCD_D7 PD2       // Using PD2 instead of PB5 to avoid SPI conflict
 
-void LCD_Command(unsigned char cmnd) {
-	// Handle upper nibble (D4-D7)
-	PORTB = (PORTB & 0xC3) | ((cmnd & 0b11110000) >> 2); // D4-D6 to PB2-PB4
-	if(cmnd & 0x80) PORTD |= (1<<PD2);  // D7 to PD2
-	else PORTD &= ~(1<<PD2);
-	
-	PORTB &= ~(1<<LCD_RS); // RS=0 for command
-	PORTB |= (1<<LCD_EN);  // EN=1
-	_delay_us(1);
-	PORTB &= ~(1<<LCD_EN); // EN=0
-	_delay_us(200);
-	
-	// Handle lower nibble (D4-D7)
-	PORTB = (PORTB & 0xC3) | ((cmnd & 0x0F) << 2); // D4-D6 to PB2-PB4
-	if(cmnd & 0x08) PORTD |= (1<<PD2);  // D7 to PD2
-	else PORTD &= ~(1<<PD2);
+// 2x16 framebuffer. Writers only touch lcd_fb and the dirty bits; the Timer0
+// ISR pushes one changed cell per tick and keeps lcd_shadow equal to what the
+// HD44780 actually shows. RW is tied to GND on this board, so instead of the
+// busy flag each tick is sized to the datasheet's 37 us execution time.
+#define LCD_ROWS 2
+#define LCD_COLS 16
+#define LCD_CELLS (LCD_ROWS * LCD_COLS)
+#define LCD_NONE 0xFF
+#define LCD_TICK_US 50
+#define LCD_SCROLL_MAX LINK_SCROLL_MAX
+#define LCD_SCROLL_MS 300
+#define LCD_SCROLL_GAP 4
+
+static volatile char lcd_fb[LCD_CELLS];
+static volatile uint8_t lcd_dirty[LCD_CELLS / 8];
+static char lcd_shadow[LCD_CELLS];   // ISR only
+static uint8_t lcd_addr = LCD_NONE;  // Cell the LCD cursor points at (ISR only)
+
+// One marquee per row for text longer than the display
+typedef struct {
+	char text[LCD_SCROLL_MAX];
+	uint8_t len;
+	uint8_t pos;
+	uint32_t last_ms;
+} lcd_scroll_t;
+static lcd_scroll_t lcd_scroll[LCD_ROWS];
+
+// 1 ms system tick from Timer2
+static volatile uint32_t ticks_ms = 0;
+
+// Interrupts must be off. Timer2 counts 8 us steps between ticks.
+static uint32_t Micros_Locked(void) {
+	uint8_t t = TCNT2;
+	uint32_t ms = ticks_ms;
+	if ((TIFR & (1<<OCF2)) && t < 124) ms++; // Tick pending but not serviced yet
+	return ms * 1000 + (uint32_t)t * 8;
+}
+
+uint32_t Micros(void) {
+	uint32_t us;
+	cli();
+	us = Micros_Locked();
+	sei();
+	return us;
+}
+
+static void Input_Sample(void) {
+	for (uint8_t ch = 0; ch < INPUT_COUNT; ch++) {
+		input_state_t *in = &inputs[ch];
+		uint8_t raw = (*input_pins[ch] & (1 << input_bits[ch])) ? 1 : 0;
+		
+		if (raw == in->stable) {
+			in->count = 0;
+			if (ch == INPUT_INT1 && int1_edge_pending) {
+				// A bounce or tap shorter than DEBOUNCE_MS: forget its edge
+				// time and listen again, or the next press gets stamped with it
+				int1_edge_pending = 0;
+				GIFR = (1<<INTF1);
+				GICR |= (1<<INT1);
+			}
+			continue;
+		}
+		if (in->count == 0) {
+			in->edge_us = Micros_Locked();
+			if (ch == INPUT_INT1 && int1_edge_pending) in->edge_us = int1_edge_us;
+		}
+		if (++in->count < DEBOUNCE_MS) continue;
+		
+		in->stable = raw;
+		in->count = 0;
+		uint8_t next = (event_head + 1) & (EVENT_QUEUE_SIZE - 1);
+		if (next != event_tail) {
+			event_queue[event_head].channel = ch;
+			event_queue[event_head].level = raw;
+			event_queue[event_head].edge_us = in->edge_us;
+			event_head = next;
+		}
+		if (ch == INPUT_INT1) {
+			// Bounces are over, listen for the next edge
+			int1_edge_pending = 0;
+			GIFR = (1<<INTF1);
+			GICR |= (1<<INT1);
+		}
+	}
+}
+
+ISR(TIMER2_COMP_vect) {
+	ticks_ms++;
+	Input_Sample();
+}
+
+// Wakes the CPU on a button edge; the tick takes over for debouncing
+ISR(INT1_vect) {
+	int1_edge_us = Micros_Locked();
+	int1_edge_pending = 1;
+	GICR &= ~(1<<INT1); // Ignore the bounces
+}
+
+uint32_t Millis(void) {
+	uint32_t ms;
+	cli();
+	ms = ticks_ms;
+	sei();
+	return ms;
+}
+
+void Tick_Init(void) {
+	// CTC, prescaler 64: 8 MHz / 64 / 125 = 1 kHz
+	OCR2 = 124;
+	TCCR2 = (1<<WGM21) | (1<<CS22);
+	TIMSK |= (1<<OCIE2);
+}
+
+static void LCD_Nibble(uint8_t nibble) {
+	PORTB = (PORTB & 0xE3) | ((nibble & 0x07) << 2); // D4-D6 to PB2-PB4
+	if(nibble & 0x08) PORTD |= (1<<LCD_D7);  // D7 to PD2
+	else PORTD &= ~(1<<LCD_D7);
 	
 	PORTB |= (1<<LCD_EN);
-	_delay_us(1);
+	_delay_us(1); // EN pulse width >= 450 ns
 	PORTB &= ~(1<<LCD_EN);
-	_delay_ms(2);
 }
 
-void LCD_Char(unsigned char data) {
-	// Upper nibble
-	PORTB = (PORTB & 0xC3) | ((data & 0xF0) >> 2); // D4-D6 to PB2-PB4
-	if(data & 0x80) PORTD |= (1<<PD2);  // D7 to PD2
-	else PORTD &= ~(1<<PD2);
+// Send one byte without waiting for it to execute
+static void LCD_Write(uint8_t data, uint8_t rs) {
+	if(rs) PORTB |= (1<<LCD_RS); // RS=1 for data
+	else PORTB &= ~(1<<LCD_RS);  // RS=0 for command
 	
-	PORTB |= (1<<LCD_RS); // RS=1 for data
-	PORTB |= (1<<LCD_EN);
-	_delay_us(1);
-	PORTB &= ~(1<<LCD_EN);
-	_delay_us(200);
+	LCD_Nibble(data >> 4);
+	_delay_us(1); // Enable cycle time >= 1 us
+	LCD_Nibble(data & 0x0F);
+}
+
+static uint8_t LCD_NextDirty(void) {
+	// Keep going where the cursor already is, saves a set-address command
+	if(lcd_addr != LCD_NONE && (lcd_dirty[lcd_addr >> 3] & (1 << (lcd_addr & 7)))) return lcd_addr;
 	
-	// Lower nibble
-	PORTB = (PORTB & 0xC3) | ((data & 0x0F) << 2); // D4-D6 to PB2-PB4
-	if(data & 0x08) PORTD |= (1<<PD2);  // D7 to PD2
-	else PORTD &= ~(1<<PD2);
+	for(uint8_t b = 0; b < sizeof(lcd_dirty); b++) {
+		uint8_t bits = lcd_dirty[b];
+		if(!bits) continue;
+		uint8_t i = b << 3;
+		while(!(bits & 1)) {
+			bits >>= 1;
+			i++;
+		}
+		return i;
+	}
+	return LCD_NONE;
+}
+
+ISR(TIMER0_COMP_vect) {
+	uint8_t i;
+	while((i = LCD_NextDirty()) != LCD_NONE && lcd_fb[i] == lcd_shadow[i]) {
+		lcd_dirty[i >> 3] &= ~(1 << (i & 7)); // Changed back before we got to it
+	}
 	
-	PORTB |= (1<<LCD_EN);
-	_delay_us(1);
-	PORTB &= ~(1<<LCD_EN);
-	_delay_ms(2);
+	if(i == LCD_NONE) {
+		TIMSK &= ~(1<<OCIE0); // Screen is up to date, stop ticking
+		return;
+	}
+	
+	if(i != lcd_addr) {
+		LCD_Write(0x80 | ((i >= LCD_COLS) ? 0x40 : 0x00) | (i % LCD_COLS), 0); // Set DDRAM address
+		lcd_addr = i;
+		return;
+	}
+	
+	char c = lcd_fb[i];
+	LCD_Write(c, 1);
+	lcd_shadow[i] = c;
+	lcd_dirty[i >> 3] &= ~(1 << (i & 7));
+	// DDRAM rows are not contiguous, so the cursor is lost past column 15
+	lcd_addr = ((i % LCD_COLS) == LCD_COLS - 1) ? LCD_NONE : i + 1;
+}
+
+void LCD_Put(uint8_t cell, char c) {
+	if(lcd_fb[cell] == c) return;
+	cli();
+	lcd_fb[cell] = c;
+	lcd_dirty[cell >> 3] |= (1 << (cell & 7));
+	TIMSK |= (1<<OCIE0);
+	sei();
+}
+
+void LCD_Text(uint8_t row, uint8_t col, const char *str, uint8_t len) {
+	lcd_scroll[row].len = 0; // Static text replaces a marquee on that row
+	for(uint8_t i = 0; i < len && col + i < LCD_COLS; i++) {
+		LCD_Put(row * LCD_COLS + col + i, str[i]);
+	}
+}
+
+void LCD_Clear(void) {
+	for(uint8_t row = 0; row < LCD_ROWS; row++) lcd_scroll[row].len = 0;
+	for(uint8_t i = 0; i < LCD_CELLS; i++) LCD_Put(i, ' ');
+}
+
+static void LCD_ScrollRender(uint8_t row) {
+	lcd_scroll_t *s = &lcd_scroll[row];
+	uint8_t period = s->len + LCD_SCROLL_GAP;
+	for(uint8_t col = 0; col < LCD_COLS; col++) {
+		uint8_t pos = (s->pos + col) % period;
+		LCD_Put(row * LCD_COLS + col, pos < s->len ? s->text[pos] : ' ');
+	}
+}
+
+// Start (or extend, for text split across frames) a marquee on one row
+void LCD_Scroll(uint8_t row, const char *str, uint8_t len, uint8_t append) {
+	lcd_scroll_t *s = &lcd_scroll[row];
+	if(!append) {
+		s->len = 0;
+		s->pos = 0;
+		s->last_ms = Millis();
+	}
+	for(uint8_t i = 0; i < len && s->len < LCD_SCROLL_MAX; i++) {
+		s->text[s->len++] = str[i];
+	}
+	
+	if(s->len <= LCD_COLS) {
+		// Fits, show it padded and don't scroll
+		for(uint8_t col = 0; col < LCD_COLS; col++) {
+			LCD_Put(row * LCD_COLS + col, col < s->len ? s->text[col] : ' ');
+		}
+		return;
+	}
+	LCD_ScrollRender(row);
+}
+
+// Called from the main loop, advances marquees one character per LCD_SCROLL_MS
+void LCD_ScrollPoll(void) {
+	uint32_t now = Millis();
+	for(uint8_t row = 0; row < LCD_ROWS; row++) {
+		lcd_scroll_t *s = &lcd_scroll[row];
+		if(s->len <= LCD_COLS || now - s->last_ms < LCD_SCROLL_MS) continue;
+		s->last_ms = now;
+		s->pos = (s->pos + 1) % (s->len + LCD_SCROLL_GAP);
+		LCD_ScrollRender(row);
+	}
 }
 
 void LCD_Init() {
@@ -66,41 +345,332 @@ void LCD_Init() {
 	DDRB |= 0x1F;  // PB0-PB4 as outputs (PB5 left alone for SPI)
 	DDRD |= (1<<PD2); // PD2 as output for LCD_D7
 	
-	_delay_ms(20); // LCD power-up delay
+	_delay_ms(40); // Power-up: Vcc > 2.7 V for 40 ms
+	
+	// HD44780 4-bit initialization by instruction, minimum datasheet waits.
+	// This is the only place the LCD code blocks.
+	PORTB &= ~(1<<LCD_RS);
+	LCD_Nibble(0x03);
+	_delay_us(4100);
+	LCD_Nibble(0x03);
+	_delay_us(100);
+	LCD_Nibble(0x03);
+	_delay_us(37);
+	LCD_Nibble(0x02); // 4-bit mode
+	_delay_us(37);
+	LCD_Write(0x28, 0); // 2 lines, 5x7 matrix
+	_delay_us(37);
+	LCD_Write(0x0C, 0); // Display on, cursor off
+	_delay_us(37);
+	LCD_Write(0x06, 0); // Increment cursor
+	_delay_us(37);
+	LCD_Write(0x01, 0); // Clear display
+	_delay_us(1520);
+	
+	for(uint8_t i = 0; i < LCD_CELLS; i++) {
+		lcd_fb[i] = ' ';
+		lcd_shadow[i] = ' ';
+	}
+	
+	// Timer0 CTC, prescaler 8: one LCD byte every 50 us while cells are dirty
+	OCR0 = LCD_TICK_US - 1;
+	TCCR0 = (1<<WGM01) | (1<<CS01);
+}
+
+void UART_Init(void) {
+	// 38400 baud with U2X: 8 MHz / (8 * (25 + 1)) = 38461 (0.2% error)
+	UBRRH = 0;
+	UBRRL = (uint8_t)(F_CPU / (8UL * LINK_BAUD) - 1);
+	UCSRA = (1<<U2X);
+	UCSRB = (1<<RXEN) | (1<<TXEN) | (1<<RXCIE);
+	UCSRC = (1<<URSEL) | (1<<UCSZ1) | (1<<UCSZ0); // 8N1
+}
+
+ISR(USART_RXC_vect) {
+	uint8_t data = UDR;
+	uint8_t next = (rx_head + 1) & (RX_BUF_SIZE - 1);
+	if (next == rx_tail) {
+		link_overruns++; // Main loop fell behind, drop the byte
+		return;
+	}
+	rx_buf[rx_head] = data;
+	rx_head = next;
+}
+
+ISR(USART_UDRE_vect) {
+	if (tx_head == tx_tail) {
+		UCSRB &= ~(1<<UDRIE); // Nothing left to send
+		return;
+	}
+	UDR = tx_buf[tx_tail];
+	tx_tail = (tx_tail + 1) & (TX_BUF_SIZE - 1);
+}
+
+void UART_Write(const uint8_t *data, uint8_t len) {
+	for (uint8_t i = 0; i < len; i++) {
+		uint8_t next = (tx_head + 1) & (TX_BUF_SIZE - 1);
+		while (next == tx_tail); // Only waits if a reply outruns the wire
+		tx_buf[tx_head] = data[i];
+		tx_head = next;
+		UCSRB |= (1<<UDRIE);
+	}
+}
+
+// Timer1 runs 8-bit fast PWM at 488 Hz with no OC pins connected: overflow
+// switches dimmed channels on, the compare matches switch them off again.
+// It only interrupts while some channel is actually dimmed.
+ISR(TIMER1_OVF_vect) {
+	if (pwm_mask & 0x01) PORTC |= (1 << output_bits[0]);
+	if (pwm_mask & 0x02) PORTC |= (1 << output_bits[1]);
+}
+
+ISR(TIMER1_COMPA_vect) {
+	PORTC &= ~(1 << output_bits[0]);
+}
+
+ISR(TIMER1_COMPB_vect) {
+	PORTC &= ~(1 << output_bits[1]);
+}
+
+void PWM_Init(void) {
+	TCCR1A = (1<<WGM10);
+	TCCR1B = (1<<WGM12) | (1<<CS11) | (1<<CS10); // Fast PWM 8-bit, prescaler 64
+}
+
+void Output_Set(uint8_t channel, uint8_t level) {
+	output_level[channel] = level;
+	uint8_t dimmed = (level != 0 && level != 255);
+	
+	cli();
+	if (channel < PWM_CHANNELS) {
+		uint8_t bit = (1 << channel);
+		if (dimmed) pwm_mask |= bit;
+		else pwm_mask &= ~bit;
+		if (channel == 0) OCR1A = level;
+		else OCR1B = level;
+		
+		if (dimmed) TIMSK |= channel == 0 ? (1<<OCIE1A) : (1<<OCIE1B);
+		else TIMSK &= ~(channel == 0 ? (1<<OCIE1A) : (1<<OCIE1B));
+		if (pwm_mask) TIMSK |= (1<<TOIE1);
+		else TIMSK &= ~(1<<TOIE1);
+	}
+	if (level) PORTC |= (1 << output_bits[channel]);
+	else PORTC &= ~(1 << output_bits[channel]);
+	sei();
+}
+
+uint8_t Output_Mask(void) {
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < OUTPUT_COUNT; i++) {
+		if (output_level[i]) mask |= (1 << i);
+	}
+	return mask;
+}
+
+void Input_Init(void) {
+	DDRA &= ~((1<<PA0) | (1<<PA1) | (1<<PA2));
+	PORTA |= (1<<PA0) | (1<<PA1) | (1<<PA2);  // Pull-ups, PA0 is unused
+	DDRD &= ~(1<<BUTTON_PIN);
+	PORTD |= (1<<BUTTON_PIN);
+	
+	for (uint8_t ch = 0; ch < INPUT_COUNT; ch++) {
+		inputs[ch].stable = (*input_pins[ch] & (1 << input_bits[ch])) ? 1 : 0;
+		inputs[ch].count = 0;
+	}
+	
+	MCUCR |= (1<<ISC10); // INT1 on any edge
+	GIFR = (1<<INTF1);
+	GICR |= (1<<INT1);
+}
+
+// Append one reply record, returns 0 if it does not fit
+uint8_t Reply_Add(uint8_t *reply, uint8_t *len, uint8_t op, const uint8_t *args, uint8_t argLen) {
+	if (*len + 2 + argLen > LINK_MAX_PAYLOAD) return 0;
+	reply[(*len)++] = op;
+	reply[(*len)++] = argLen;
+	for (uint8_t i = 0; i < argLen; i++) reply[(*len)++] = args[i];
+	return 1;
+}
+
+// Run every record of a received batch and send one ACK frame back
+void Link_HandleFrame(uint8_t seq, const uint8_t *payload, uint8_t len) {
+	// The ESP32 resends a frame whose ACK got lost; an LCD append must not
+	// run twice, so repeat the cached ACK instead
+	uint16_t crc = link_crc16_update(link_crc16_update(0xFFFF, len), seq);
+	for (uint8_t i = 0; i < len; i++) crc = link_crc16_update(crc, payload[i]);
+	if (last_ack_len && seq == last_seq && crc == last_crc) {
+		UART_Write(last_ack, last_ack_len);
+		return;
+	}
+	
+	uint8_t reply[LINK_MAX_PAYLOAD];
+	uint8_t replyLen = 2 + 2; // ACK record header + status + count, filled in last
+	uint8_t status = LINK_STATUS_OK;
+	uint8_t executed = 0;
+	uint8_t pos = 0;
+	
+	while (pos < len && status == LINK_STATUS_OK) {
+		if (pos + 2 > len || pos + 2 + payload[pos + 1] > len) {
+			status = LINK_STATUS_BAD_RECORD;
+			break;
+		}
+		uint8_t op = payload[pos];
+		uint8_t argLen = payload[pos + 1];
+		const uint8_t *args = &payload[pos + 2];
+		
+		switch (op) {
+		case LINK_OP_SET_OUTPUT:
+			if (argLen != 2 || args[0] >= OUTPUT_COUNT) status = LINK_STATUS_BAD_RECORD;
+			else Output_Set(args[0], args[1]);
+			break;
+		case LINK_OP_LCD_TEXT:
+			if (argLen < 2 || args[0] >= LCD_ROWS || args[1] >= LCD_COLS) {
+				status = LINK_STATUS_BAD_RECORD;
+				break;
+			}
+			LCD_Text(args[0], args[1], (const char *)&args[2], argLen - 2);
+			break;
+		case LINK_OP_LCD_CLEAR:
+			LCD_Clear();
+			break;
+		case LINK_OP_LCD_SCROLL:
+			if (argLen < 2 || args[0] >= LCD_ROWS) {
+				status = LINK_STATUS_BAD_RECORD;
+				break;
+			}
+			LCD_Scroll(args[0], (const char *)&args[2], argLen - 2, args[1] & LINK_SCROLL_APPEND);
+			break;
+		case LINK_OP_QUERY: {
+			uint8_t value[7];
+			uint8_t valueLen = 2;
+			value[0] = argLen ? args[0] : LINK_QUERY_OUTPUTS;
+			if (value[0] == LINK_QUERY_OUTPUTS) {
+				value[1] = Output_Mask();
+			} else if (value[0] == LINK_QUERY_INPUTS) {
+				value[1] = 0;
+				for (uint8_t i = 0; i < INPUT_COUNT; i++) value[1] |= inputs[i].stable << i;
+			} else if (value[0] == LINK_QUERY_LATENCY) {
+				value[1] = event_latency_last_us & 0xFF; value[2] = event_latency_last_us >> 8;
+				value[3] = event_latency_max_us & 0xFF; value[4] = event_latency_max_us >> 8;
+				valueLen = 5;
+			} else if (value[0] == LINK_QUERY_STATS) {
+				uint16_t overruns;
+				cli();
+				overruns = link_overruns;
+				sei();
+				value[1] = link_frames_ok & 0xFF; value[2] = link_frames_ok >> 8;
+				value[3] = link_crc_errors & 0xFF; value[4] = link_crc_errors >> 8;
+				value[5] = overruns & 0xFF; value[6] = overruns >> 8;
+				valueLen = 7;
+			} else {
+				status = LINK_STATUS_BAD_RECORD;
+				break;
+			}
+			if (!Reply_Add(reply, &replyLen, LINK_OP_VALUE, value, valueLen)) status = LINK_STATUS_REPLY_FULL;
+			break;
+		}
+		case LINK_OP_PING:
+			if (!Reply_Add(reply, &replyLen, LINK_OP_PONG, args, argLen)) status = LINK_STATUS_REPLY_FULL;
+			break;
+		default:
+			status = LINK_STATUS_BAD_RECORD;
+			break;
+		}
+		
+		if (status == LINK_STATUS_OK) executed++;
+		pos += 2 + argLen;
+	}
+	
+	reply[0] = LINK_OP_ACK;
+	reply[1] = 2;
+	reply[2] = status;
+	reply[3] = executed;
 	
-	// LCD initialization sequence
-	LCD_Command(0x02); // 4-bit mode
-	LCD_Command(0x28); // 2 lines, 5x7 matrix
-	LCD_Command(0x0C); // Display on, cursor off
-	LCD_Command(0x06); // Increment cursor
-	LCD_Command(0x01); // Clear display
-	_delay_ms(2);
+	last_seq = seq;
+	last_crc = crc;
+	last_ack_len = link_encode_frame(last_ack, seq, reply, replyLen);
+	UART_Write(last_ack, last_ack_len);
+}
+
+void Link_SendNak(uint8_t seq, uint8_t status) {
+	uint8_t reply[4] = { LINK_OP_ACK, 2, status, 0 };
+	uint8_t frame[4 + LINK_FRAME_OVERHEAD];
+	uint8_t frameLen = link_encode_frame(frame, seq, reply, sizeof(reply));
+	UART_Write(frame, frameLen);
 }
 
-void LCD_String(char *str) {
-	for(int i=0; str[i]!=0; i++) {
-		LCD_Char(str[i]);
+// Send queued input events, stamped with how long they took to get out
+void Input_Poll(void) {
+	while (event_tail != event_head) {
+		input_event_t ev = event_queue[event_tail];
+		event_tail = (event_tail + 1) & (EVENT_QUEUE_SIZE - 1);
+		
+		uint32_t latency = Micros() - ev.edge_us;
+		event_latency_last_us = latency > 0xFFFF ? 0xFFFF : latency;
+		if (event_latency_last_us > event_latency_max_us) event_latency_max_us = event_latency_last_us;
+		
+		uint8_t record[2 + 8] = {
+			LINK_OP_EVENT, 8, ev.channel, ev.level,
+			ev.edge_us & 0xFF, (ev.edge_us >> 8) & 0xFF, (ev.edge_us >> 16) & 0xFF, ev.edge_us >> 24,
+			event_latency_last_us & 0xFF, event_latency_last_us >> 8
+		};
+		uint8_t frame[sizeof(record) + LINK_FRAME_OVERHEAD];
+		uint8_t frameLen = link_encode_frame(frame, event_seq++, record, sizeof(record));
+		UART_Write(frame, frameLen);
+	}
+}
+
+void Link_Poll(void) {
+	while (rx_tail != rx_head) {
+		uint8_t data = rx_buf[rx_tail];
+		rx_tail = (rx_tail + 1) & (RX_BUF_SIZE - 1);
+		
+		uint8_t result = link_parser_feed(&link_parser, data);
+		if (result == LINK_FEED_FRAME) {
+			PORTD |= (1<<LINK_PROBE);
+			link_frames_ok++;
+			Link_HandleFrame(link_parser.seq, link_parser.payload, link_parser.len);
+			PORTD &= ~(1<<LINK_PROBE);
+		} else if (result == LINK_FEED_BAD_CRC) {
+			link_crc_errors++;
+			Link_SendNak(link_parser.seq, LINK_STATUS_BAD_CRC); // ESP32 resends on NAK
+		}
 	}
 }
 
 int main(void) {
 	// Your existing setup
-	DDRC |= (1 << LED_PIN);       // Set LED as output
-	DDRA &= ~(1 << CONTROL_PIN);  // Set CONTROL_PIN as input
+	for (uint8_t i = 0; i < OUTPUT_COUNT; i++) DDRC |= (1 << output_bits[i]);
+	DDRD |= (1 << LINK_PROBE);
+	ACSR |= (1<<ACD); // Analog comparator is unused, save its current
 	
 	// Initialize LCD
 	LCD_Init();
-	LCD_Command(0x80); // Move cursor to first line
-	LCD_String("Hello");
+	PWM_Init();
+	Input_Init();
+	Tick_Init();
+	link_parser_reset(&link_parser);
+	UART_Init();
+	sei();
+	
+	LCD_Text(0, 0, "Hello", 5);
+	
+	set_sleep_mode(SLEEP_MODE_IDLE); // Timers and UART keep running
 	
 	while (1) {
-		// Your existing control logic
-		if (PINA & (1 << CONTROL_PIN)) {
-			PORTC |= (1 << LED_PIN);  // LED ON if PA0 = 1
-			} else {
-			PORTC &= ~(1 << LED_PIN); // LED OFF if PA0 = 0
-		}
+		Link_Poll();
+		Input_Poll();
+		LCD_ScrollPoll();
 		
-		// Add any LCD updates here if needed
+		// Sleep until the next interrupt (UART byte, tick, INT1, LCD, PWM).
+		// sei right before sleep_cpu is atomic, so no wakeup gets lost.
+		cli();
+		if (rx_tail == rx_head && event_tail == event_head) {
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
 	}
 }
@@ -0,0 +1,320 @@
+#include "atmega_link.h"
+
+static HardwareSerial atmegaSerial(1);
+static link_parser_t rxParser;
+static uint8_t txSeq = 0;
+
+// Events can arrive while we wait for an ACK, so park them until the next
+// atmegaLinkPoll() instead of calling the handler from inside a send
+#define LINK_EVENT_QUEUE 8
+static LinkInputEvent eventQueue[LINK_EVENT_QUEUE];
+static uint8_t eventCount = 0;
+static LinkInputHandler inputHandler = NULL;
+
+void atmegaLinkBegin()
+{
+  atmegaSerial.begin(LINK_BAUD, SERIAL_8N1, ATMEGA_UART_RX_PIN, ATMEGA_UART_TX_PIN);
+  link_parser_reset(&rxParser);
+  Serial.printf("ATmega link on UART1 (TX %d, RX %d) at %lu baud\n",
+                ATMEGA_UART_TX_PIN, ATMEGA_UART_RX_PIN, LINK_BAUD);
+}
+
+void atmegaOnInput(LinkInputHandler handler)
+{
+  inputHandler = handler;
+}
+
+// Returns true if the parsed frame was an input event (and queues it)
+static bool queueEvent()
+{
+  const uint8_t *p = rxParser.payload;
+  if (rxParser.len < 10 || p[0] != LINK_OP_EVENT || p[1] != 8)
+  {
+    return false;
+  }
+  if (eventCount < LINK_EVENT_QUEUE)
+  {
+    LinkInputEvent &ev = eventQueue[eventCount++];
+    ev.channel = p[2];
+    ev.level = p[3];
+    ev.edgeUs = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+    ev.latencyUs = p[8] | (p[9] << 8);
+  }
+  return true;
+}
+
+// Queue input events, drop anything else nobody waited for (late ACKs)
+void atmegaLinkPoll()
+{
+  while (atmegaSerial.available())
+  {
+    if (link_parser_feed(&rxParser, atmegaSerial.read()) == LINK_FEED_FRAME)
+    {
+      queueEvent();
+    }
+  }
+
+  for (uint8_t i = 0; i < eventCount; i++)
+  {
+    if (inputHandler)
+    {
+      inputHandler(eventQueue[i]);
+    }
+  }
+  eventCount = 0;
+}
+
+void linkBatchReset(LinkBatch &batch)
+{
+  batch.len = 0;
+}
+
+bool linkBatchAdd(LinkBatch &batch, uint8_t op, const uint8_t *args, uint8_t argLen)
+{
+  if (batch.len + 2 + argLen > LINK_MAX_PAYLOAD)
+  {
+    return false;
+  }
+  batch.payload[batch.len++] = op;
+  batch.payload[batch.len++] = argLen;
+  memcpy(&batch.payload[batch.len], args, argLen);
+  batch.len += argLen;
+  return true;
+}
+
+bool linkBatchSetOutput(LinkBatch &batch, uint8_t channel, uint8_t value)
+{
+  uint8_t args[2] = {channel, value};
+  return linkBatchAdd(batch, LINK_OP_SET_OUTPUT, args, sizeof(args));
+}
+
+bool linkBatchLcdText(LinkBatch &batch, uint8_t row, uint8_t col, const char *text)
+{
+  uint8_t args[2 + 16];
+  uint8_t n = 0;
+  args[n++] = row;
+  args[n++] = col;
+  while (*text && n < sizeof(args))
+  {
+    args[n++] = *text++;
+  }
+  return linkBatchAdd(batch, LINK_OP_LCD_TEXT, args, n);
+}
+
+bool linkBatchQuery(LinkBatch &batch, uint8_t what)
+{
+  return linkBatchAdd(batch, LINK_OP_QUERY, &what, 1);
+}
+
+bool linkBatchLcdScroll(LinkBatch &batch, uint8_t row, bool append, const char *text, uint8_t len)
+{
+  uint8_t args[LINK_MAX_PAYLOAD - 2];
+  if (2 + len > sizeof(args))
+  {
+    return false;
+  }
+  args[0] = row;
+  args[1] = append ? LINK_SCROLL_APPEND : 0;
+  memcpy(&args[2], text, len);
+  return linkBatchAdd(batch, LINK_OP_LCD_SCROLL, args, 2 + len);
+}
+
+const uint8_t *linkReplyFind(const LinkReply &reply, uint8_t op, uint8_t *argLen)
+{
+  uint8_t pos = 0;
+  while (pos + 2 <= reply.len)
+  {
+    uint8_t len = reply.payload[pos + 1];
+    if (pos + 2 + len > reply.len)
+    {
+      break;
+    }
+    if (reply.payload[pos] == op)
+    {
+      if (argLen)
+        *argLen = len;
+      return &reply.payload[pos + 2];
+    }
+    pos += 2 + len;
+  }
+  return NULL;
+}
+
+// Wait for the ACK frame matching seq
+static bool waitForAck(uint8_t seq, LinkReply *reply)
+{
+  uint32_t start = millis();
+  while (millis() - start < LINK_ACK_TIMEOUT_MS)
+  {
+    if (!atmegaSerial.available())
+    {
+      delay(1);
+      continue;
+    }
+
+    uint8_t result = link_parser_feed(&rxParser, atmegaSerial.read());
+    if (result != LINK_FEED_FRAME || queueEvent() || rxParser.seq != seq)
+    {
+      continue;
+    }
+    if (rxParser.len < 4 || rxParser.payload[0] != LINK_OP_ACK)
+    {
+      continue;
+    }
+
+    reply->status = rxParser.payload[2];
+    reply->executed = rxParser.payload[3];
+    reply->len = rxParser.len - 4;
+    memcpy(reply->payload, &rxParser.payload[4], reply->len);
+    return true;
+  }
+  return false;
+}
+
+bool atmegaLinkSend(const LinkBatch &batch, LinkReply *reply)
+{
+  LinkReply localReply;
+  if (reply == NULL)
+  {
+    reply = &localReply;
+  }
+
+  uint8_t frame[LINK_MAX_PAYLOAD + LINK_FRAME_OVERHEAD];
+  uint8_t seq = txSeq++;
+  uint8_t frameLen = link_encode_frame(frame, seq, batch.payload, batch.len);
+
+  // Discard stale bytes before we start matching, keeping events
+  while (atmegaSerial.available())
+  {
+    if (link_parser_feed(&rxParser, atmegaSerial.read()) == LINK_FEED_FRAME)
+    {
+      queueEvent();
+    }
+  }
+
+  for (int attempt = 0; attempt < LINK_RETRIES; attempt++)
+  {
+    atmegaSerial.write(frame, frameLen);
+
+    if (!waitForAck(seq, reply))
+    {
+      Serial.printf("ATmega link: no ACK for seq %u (attempt %d)\n", seq, attempt + 1);
+      continue;
+    }
+    if (reply->status == LINK_STATUS_BAD_CRC)
+    {
+      Serial.printf("ATmega link: NAK for seq %u, resending\n", seq);
+      continue;
+    }
+    if (reply->status != LINK_STATUS_OK)
+    {
+      Serial.printf("ATmega link: seq %u rejected, status %u after %u records\n",
+                    seq, reply->status, reply->executed);
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool atmegaSetOutput(uint8_t channel, uint8_t level)
+{
+  LinkBatch batch;
+  linkBatchReset(batch);
+  linkBatchSetOutput(batch, channel, level);
+  return atmegaLinkSend(batch);
+}
+
+bool atmegaLcdScroll(uint8_t row, const String &text)
+{
+  // Record header (op, len) plus row and flags leave this much per frame
+  const size_t chunk = LINK_MAX_PAYLOAD - 4;
+  // Every frame is a blocking round trip, don't send what the ATmega drops
+  const size_t total = min((size_t)text.length(), (size_t)LINK_SCROLL_MAX);
+  size_t pos = 0;
+
+  do
+  {
+    size_t len = min(chunk, total - pos);
+    LinkBatch batch;
+    linkBatchReset(batch);
+    linkBatchLcdScroll(batch, row, pos > 0, text.c_str() + pos, len);
+    if (!atmegaLinkSend(batch))
+    {
+      return false;
+    }
+    pos += len;
+  } while (pos < total);
+
+  return true;
+}
+
+void atmegaLinkBenchmark(int count)
+{
+  Serial.printf("Pinging ATmega %d times...\n", count);
+
+  LinkBatch batch;
+  LinkReply reply;
+  uint32_t minUs = UINT32_MAX, maxUs = 0;
+  uint64_t totalUs = 0;
+  int ok = 0;
+
+  for (int i = 0; i < count; i++)
+  {
+    // 32 byte payload so the numbers also say something about throughput
+    uint8_t token[32];
+    for (int j = 0; j < (int)sizeof(token); j++)
+    {
+      token[j] = (uint8_t)(i + j);
+    }
+    linkBatchReset(batch);
+    linkBatchAdd(batch, LINK_OP_PING, token, sizeof(token));
+
+    uint32_t t0 = micros();
+    bool sent = atmegaLinkSend(batch, &reply);
+    uint32_t elapsed = micros() - t0;
+
+    uint8_t len = 0;
+    const uint8_t *pong = sent ? linkReplyFind(reply, LINK_OP_PONG, &len) : NULL;
+    if (pong == NULL || len != sizeof(token) || memcmp(pong, token, len) != 0)
+    {
+      continue;
+    }
+
+    ok++;
+    totalUs += elapsed;
+    minUs = min(minUs, elapsed);
+    maxUs = max(maxUs, elapsed);
+  }
+
+  if (ok == 0)
+  {
+    Serial.println("ATmega did not answer any ping!");
+    return;
+  }
+
+  // Each ping moves a request and a reply frame over the wire
+  uint32_t bytesPerPing = 2 * (32 + 2 + LINK_FRAME_OVERHEAD) + 4;
+  uint32_t avgUs = totalUs / ok;
+  Serial.printf("Pings OK: %d/%d\n", ok, count);
+  Serial.printf("RTT min/avg/max: %lu / %lu / %lu us\n", minUs, avgUs, maxUs);
+  Serial.printf("Throughput: %.1f bytes/s\n", bytesPerPing * 1e6 / avgUs);
+
+  linkBatchReset(batch);
+  linkBatchQuery(batch, LINK_QUERY_STATS);
+  uint8_t len = 0;
+  const uint8_t *stats;
+  if (atmegaLinkSend(batch, &reply) && (stats = linkReplyFind(reply, LINK_OP_VALUE, &len)) != NULL && len == 7)
+  {
+    Serial.printf("ATmega stats: frames %u, CRC errors %u, RX overruns %u\n",
+                  stats[1] | (stats[2] << 8), stats[3] | (stats[4] << 8), stats[5] | (stats[6] << 8));
+  }
+
+  linkBatchReset(batch);
+  linkBatchQuery(batch, LINK_QUERY_LATENCY);
+  if (atmegaLinkSend(batch, &reply) && (stats = linkReplyFind(reply, LINK_OP_VALUE, &len)) != NULL && len == 5)
+  {
+    Serial.printf("ATmega input latency: last %u us, max %u us\n",
+                  stats[1] | (stats[2] << 8), stats[3] | (stats[4] << 8));
+  }
+}
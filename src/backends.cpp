@@ -0,0 +1,180 @@
+#include "backends.h"
+
+struct BackendState
+{
+  float latencyMs; // EWMA of successful requests, 0 until the first one
+  float errorRate; // EWMA of failures, 0..1
+  uint8_t failStreak;
+  uint32_t restUntil;
+  uint32_t lastUsed;
+  uint32_t requests;
+  uint32_t failures;
+};
+
+static const BackendConfig *backends = NULL;
+static BackendState states[BACKEND_MAX];
+static size_t backendCount = 0;
+static uint32_t picks[STAGE_COUNT];
+static const char *only = NULL;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *stageNames[STAGE_COUNT] = {"STT", "LLM", "TTS"};
+
+static bool resting(const BackendState &s, uint32_t now)
+{
+  return s.failStreak >= BACKEND_FAIL_STREAK && (int32_t)(s.restUntil - now) > 0;
+}
+
+// Expected time per answer, counting the retries failures cost
+static float expectedMs(const BackendState &s)
+{
+  return s.latencyMs / max(1.0f - s.errorRate, 0.05f);
+}
+
+bool backendsBegin(const BackendConfig *table, size_t count)
+{
+  if (count > BACKEND_MAX)
+  {
+    Serial.printf("ERROR: %u backends configured, at most %d\n", count, BACKEND_MAX);
+    return false;
+  }
+  portENTER_CRITICAL(&lock);
+  backends = table;
+  backendCount = count;
+  memset(states, 0, sizeof(states));
+  memset(picks, 0, sizeof(picks));
+  portEXIT_CRITICAL(&lock);
+  return true;
+}
+
+// Caller holds the lock
+static int choose(TurnStage stage, const BackendConfig *exclude, uint32_t now, bool explore)
+{
+  int best = -1, oldest = -1, soonest = -1;
+  for (size_t i = 0; i < backendCount; i++)
+  {
+    const BackendState &s = states[i];
+    if (backends[i].stage != stage || &backends[i] == exclude || (only && strcmp(backends[i].name, only) != 0))
+    {
+      continue;
+    }
+    if (resting(s, now))
+    {
+      if (soonest < 0 || (int32_t)(s.restUntil - states[soonest].restUntil) < 0)
+      {
+        soonest = i;
+      }
+      continue;
+    }
+    if (best < 0 || expectedMs(s) < expectedMs(states[best]))
+    {
+      best = i;
+    }
+    if (oldest < 0 || (int32_t)(s.lastUsed - states[oldest].lastUsed) < 0)
+    {
+      oldest = i;
+    }
+  }
+  return explore && oldest >= 0 ? oldest : best >= 0 ? best : soonest;
+}
+
+const BackendConfig *backendPick(TurnStage stage, const BackendConfig *exclude)
+{
+  uint32_t now = millis();
+  portENTER_CRITICAL(&lock);
+  bool explore = ++picks[stage] % BACKEND_EXPLORE_EVERY == 0;
+  int pick = choose(stage, exclude, now, explore);
+  if (pick >= 0)
+  {
+    states[pick].lastUsed = now;
+  }
+  portEXIT_CRITICAL(&lock);
+
+  return pick >= 0 ? &backends[pick] : NULL;
+}
+
+void backendResult(const BackendConfig *backend, bool ok, uint32_t ms)
+{
+  if (!backend || backend < backends || backend >= backends + backendCount)
+  {
+    return;
+  }
+  size_t i = backend - backends;
+
+  portENTER_CRITICAL(&lock);
+  BackendState &s = states[i];
+  s.requests++;
+  s.errorRate += BACKEND_EWMA_ALPHA * ((ok ? 0.0f : 1.0f) - s.errorRate);
+  if (ok)
+  {
+    s.latencyMs = s.latencyMs == 0 ? ms : s.latencyMs + BACKEND_EWMA_ALPHA * (ms - s.latencyMs);
+    s.failStreak = 0;
+  }
+  else
+  {
+    s.failures++;
+    if (s.failStreak < 255)
+    {
+      s.failStreak++;
+    }
+    if (s.failStreak >= BACKEND_FAIL_STREAK)
+    {
+      s.restUntil = millis() + BACKEND_COOLDOWN_MS;
+    }
+  }
+  bool rested = !ok && s.failStreak == BACKEND_FAIL_STREAK;
+  portEXIT_CRITICAL(&lock);
+
+  if (rested)
+  {
+    Serial.printf("Backend %s failed %d times in a row, resting it for %d s\n", backend->name,
+                  BACKEND_FAIL_STREAK, BACKEND_COOLDOWN_MS / 1000);
+  }
+}
+
+void backendReport()
+{
+  uint32_t now = millis();
+  Serial.println("\n=== Backends ===");
+  for (int stage = 0; stage < STAGE_COUNT; stage++)
+  {
+    portENTER_CRITICAL(&lock);
+    int next = choose((TurnStage)stage, NULL, now, false);
+    portEXIT_CRITICAL(&lock);
+    for (size_t i = 0; i < backendCount; i++)
+    {
+      const BackendConfig &b = backends[i];
+      if (b.stage != stage)
+      {
+        continue;
+      }
+      portENTER_CRITICAL(&lock);
+      BackendState s = states[i];
+      portEXIT_CRITICAL(&lock);
+
+      Serial.printf("%s %c %-10s %s:%u  ", stageNames[stage], (int)i == next ? '>' : ' ', b.name, b.host, b.port);
+      if (s.requests == 0)
+      {
+        Serial.print("not used yet");
+      }
+      else
+      {
+        Serial.printf("%5.0f ms, %3.0f%% errors, %lu requests, %lu failed", s.latencyMs, s.errorRate * 100,
+                      s.requests, s.failures);
+      }
+      if (resting(s, now))
+      {
+        Serial.printf(", resting %lu s", (s.restUntil - now) / 1000);
+      }
+      Serial.println();
+    }
+  }
+  Serial.println("> marks the next pick");
+}
+
+void backendOnly(const char *name)
+{
+  portENTER_CRITICAL(&lock);
+  only = name;
+  portEXIT_CRITICAL(&lock);
+}
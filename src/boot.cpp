@@ -0,0 +1,138 @@
+#include "boot.h"
+#include "mem_telemetry.h"
+
+struct BootRecord
+{
+  const char *name;
+  uint32_t startUs; // Since power-on
+  uint32_t endUs;
+};
+
+struct BootTaskArgs
+{
+  const char *name;
+  BootFn fn;
+  EventBits_t after;
+  EventBits_t done;
+};
+
+static EventGroupHandle_t bootBits = NULL;
+static BootRecord records[BOOT_MAX_STEPS];
+static int recordCount = 0;
+static uint32_t readyUs = 0; // When the last BOOT_READY bit was set
+static bool reported = false;
+static portMUX_TYPE recordLock = portMUX_INITIALIZER_UNLOCKED;
+
+static void bootRecord(const char *name, uint32_t startUs)
+{
+  uint32_t endUs = micros();
+  bool late;
+
+  portENTER_CRITICAL(&recordLock);
+  if (recordCount < BOOT_MAX_STEPS)
+  {
+    records[recordCount++] = {name, startUs, endUs};
+  }
+  late = reported;
+  portEXIT_CRITICAL(&recordLock);
+
+  if (late)
+  {
+    Serial.printf("Boot: %s finished at %lu ms (%lu ms)\n", name, endUs / 1000, (endUs - startUs) / 1000);
+  }
+}
+
+void bootBegin()
+{
+  bootBits = xEventGroupCreate();
+}
+
+static void bootSignal(EventBits_t done)
+{
+  EventBits_t bits = xEventGroupSetBits(bootBits, done);
+  if ((done & BOOT_READY) && (bits & BOOT_READY) == BOOT_READY)
+  {
+    // Two steps can finish together, the later one made the device ready
+    uint32_t now = micros();
+    portENTER_CRITICAL(&recordLock);
+    readyUs = max(readyUs, now);
+    portEXIT_CRITICAL(&recordLock);
+  }
+}
+
+static void bootTaskMain(void *param)
+{
+  BootTaskArgs *args = (BootTaskArgs *)param;
+  if (args->after)
+  {
+    xEventGroupWaitBits(bootBits, args->after, pdFALSE, pdTRUE, portMAX_DELAY);
+  }
+
+  uint32_t start = micros();
+  args->fn();
+  bootRecord(args->name, start);
+  memSample(args->name); // Stack high-water of this task's one job
+  bootSignal(args->done);
+
+  delete args;
+  vTaskDelete(NULL);
+}
+
+void bootTask(const char *name, BootFn fn, EventBits_t after, EventBits_t done, uint32_t stack)
+{
+  BootTaskArgs *args = new BootTaskArgs{name, fn, after, done};
+  if (xTaskCreate(bootTaskMain, name, stack, args, 1, NULL) != pdPASS)
+  {
+    // No memory for the task, run it here instead
+    delete args;
+    if (after)
+      bootWait(after, portMAX_DELAY);
+    bootStep(name, fn, done);
+  }
+}
+
+void bootStep(const char *name, BootFn fn, EventBits_t done)
+{
+  uint32_t start = micros();
+  fn();
+  bootRecord(name, start);
+  if (done)
+  {
+    bootSignal(done);
+  }
+}
+
+bool bootWait(EventBits_t bits, uint32_t timeoutMs)
+{
+  TickType_t ticks = timeoutMs == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+  return (xEventGroupWaitBits(bootBits, bits, pdFALSE, pdTRUE, ticks) & bits) == bits;
+}
+
+bool bootDone(EventBits_t bits)
+{
+  return (xEventGroupGetBits(bootBits) & bits) == bits;
+}
+
+void bootReport()
+{
+  bool ready = bootDone(BOOT_READY);
+  portENTER_CRITICAL(&recordLock);
+  reported = true;
+  int count = recordCount;
+  uint32_t readyAt = readyUs;
+  portEXIT_CRITICAL(&recordLock);
+
+  Serial.println("Boot profile (ms since power-on):");
+  for (int i = 0; i < count; i++)
+  {
+    const BootRecord &r = records[i];
+    Serial.printf("  %-10s start %5lu  took %5lu\n", r.name, r.startUs / 1000, (r.endUs - r.startUs) / 1000);
+  }
+  if (!ready)
+  {
+    Serial.println("  Not ready to listen yet");
+    return;
+  }
+  Serial.printf("  Ready to listen at %lu ms%s\n", readyAt / 1000,
+                bootDone(BOOT_NET) ? "" : ", network still coming up");
+}
@@ -0,0 +1,177 @@
+#include "conversation.h"
+
+struct ConvTurn
+{
+  char user[CONV_TURN_BYTES];
+  char model[CONV_TURN_BYTES];
+};
+
+static ConvTurn turns[CONV_MAX_TURNS];
+static uint8_t head = 0; // Oldest turn
+static uint8_t count = 0;
+static char summary[CONV_SUMMARY_BYTES];
+static uint16_t summaryLen = 0;
+static uint32_t lastTurnAt = 0;
+static uint32_t compacted = 0;
+
+static uint16_t estimateTokens(size_t bytes)
+{
+  return (bytes + 3) / 4;
+}
+
+// Copy at most maxWords words and size - 1 bytes, never ending inside a
+// word or a UTF-8 sequence. Returns the bytes written.
+static size_t copyWords(char *dst, size_t size, const char *src, int maxWords)
+{
+  size_t len = 0;
+  size_t lastBreak = 0;
+  int words = 0;
+  bool inWord = false;
+
+  for (; src[len] && len < size - 1; len++)
+  {
+    bool space = src[len] == ' ' || src[len] == '\n';
+    if (space && inWord)
+    {
+      lastBreak = len;
+      if (++words >= maxWords)
+        break;
+    }
+    inWord = !space;
+    dst[len] = src[len];
+  }
+
+  if (src[len] && src[len] != ' ' && src[len] != '\n')
+  {
+    // Cut mid-word: back off to the previous space, or failing that to
+    // the start of the UTF-8 character we stopped in
+    if (lastBreak > 0)
+      len = lastBreak;
+    else
+      while (len > 0 && ((uint8_t)src[len] & 0xC0) == 0x80)
+        len--;
+  }
+  dst[len] = '\0';
+  return len;
+}
+
+static uint16_t turnTokens(const ConvTurn &t)
+{
+  return estimateTokens(strlen(t.user) + strlen(t.model));
+}
+
+uint16_t conversationTokens()
+{
+  uint16_t tokens = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    tokens += turnTokens(turns[(head + i) % CONV_MAX_TURNS]);
+  }
+  return tokens;
+}
+
+// Append a line to the summary, dropping its oldest lines to make room
+static void summaryAppend(const char *line, size_t len)
+{
+  if (len + 1 >= sizeof(summary))
+    return;
+  while (summaryLen + len + 1 >= sizeof(summary))
+  {
+    char *nl = (char *)memchr(summary, '\n', summaryLen);
+    size_t drop = nl ? nl - summary + 1 : summaryLen;
+    memmove(summary, summary + drop, summaryLen - drop);
+    summaryLen -= drop;
+  }
+  memcpy(summary + summaryLen, line, len);
+  summaryLen += len;
+  summary[summaryLen++] = '\n';
+  summary[summaryLen] = '\0';
+}
+
+// Fold the oldest verbatim turn into the summary
+static void compactOldest()
+{
+  const ConvTurn &t = turns[head];
+  char line[CONV_SUMMARY_BYTES / 2];
+  size_t len = 0;
+
+  memcpy(line, "Q: ", 3);
+  len = 3;
+  len += copyWords(line + len, sizeof(line) / 2 - len, t.user, CONV_SUMMARY_WORDS);
+  memcpy(line + len, " A: ", 4);
+  len += 4;
+  len += copyWords(line + len, sizeof(line) - len, t.model, CONV_SUMMARY_WORDS);
+
+  summaryAppend(line, len);
+  head = (head + 1) % CONV_MAX_TURNS;
+  count--;
+  compacted++;
+}
+
+void conversationClear()
+{
+  head = 0;
+  count = 0;
+  summaryLen = 0;
+  summary[0] = '\0';
+  compacted = 0;
+}
+
+void conversationAdd(const char *user, const char *model)
+{
+  if (count == CONV_MAX_TURNS)
+  {
+    compactOldest();
+  }
+
+  ConvTurn &t = turns[(head + count) % CONV_MAX_TURNS];
+  copyWords(t.user, sizeof(t.user), user, CONV_TURN_BYTES);
+  copyWords(t.model, sizeof(t.model), model, CONV_TURN_BYTES);
+  count++;
+  lastTurnAt = millis();
+
+  // Always keep the newest turn verbatim, even if it alone is over budget
+  while (count > 1 && conversationTokens() > CONV_TOKEN_BUDGET)
+  {
+    compactOldest();
+  }
+}
+
+static void addContent(JsonArray contents, const char *role, const char *text)
+{
+  JsonObject content = contents.createNestedObject();
+  content["role"] = role;
+  content["parts"][0]["text"] = text;
+}
+
+void conversationBuild(JsonObject request, const char *instruction, const char *prompt)
+{
+  if (count > 0 && millis() - lastTurnAt > CONV_IDLE_RESET_MS)
+  {
+    Serial.println("Conversation idle, starting a new context");
+    conversationClear();
+  }
+
+  JsonArray system = request["systemInstruction"].createNestedArray("parts");
+  system.createNestedObject()["text"] = instruction;
+  if (summaryLen > 0)
+  {
+    system.createNestedObject()["text"] = "Summary of earlier turns in this conversation:";
+    system.createNestedObject()["text"] = (const char *)summary;
+  }
+
+  JsonArray contents = request.createNestedArray("contents");
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const ConvTurn &t = turns[(head + i) % CONV_MAX_TURNS];
+    addContent(contents, "user", t.user);
+    addContent(contents, "model", t.model);
+  }
+  addContent(contents, "user", prompt);
+}
+
+void conversationReport()
+{
+  Serial.printf("Conversation: %u turns (~%u tokens), %lu compacted, summary %u/%u bytes\n",
+                count, conversationTokens(), compacted, summaryLen, (unsigned)sizeof(summary));
+}
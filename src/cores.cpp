@@ -0,0 +1,397 @@
+#include "cores.h"
+#include "i2s_audio.h"
+#include <atomic>
+#include <esp_freertos_hooks.h>
+
+static i2s_port_t micPort;
+static i2s_port_t speakerPort;
+
+// I2S service intervals: time between consecutive reads or writes
+static volatile bool measuring = false;
+static uint32_t lastServiceUs = 0;
+static uint32_t serviceCount = 0;
+static uint32_t serviceMaxUs = 0;
+static uint16_t serviceHist[CORE_STATS_HIST_MS]; // 1 ms buckets, the last one open-ended
+static uint32_t statsStartMs = 0;
+static I2sCounters statsMic, statsSpeaker;
+static uint32_t statsRingDrops = 0;
+
+// Idle hook iterations per core, against a rate measured while idle
+static volatile uint32_t idleCount[portNUM_PROCESSORS];
+static float idleRate[portNUM_PROCESSORS]; // Iterations per ms with nothing to do
+static uint32_t idleStart[portNUM_PROCESSORS];
+static bool hooksInstalled = false;
+
+// Mic blocks the audio task had no ring slot for, dual-core build only
+static std::atomic<uint32_t> micRingDrops(0);
+
+static void serviceMark()
+{
+  uint32_t now = micros();
+  if (measuring && lastServiceUs)
+  {
+    uint32_t us = now - lastServiceUs;
+    serviceCount++;
+    serviceMaxUs = max(serviceMaxUs, us);
+    serviceHist[min(us / 1000, (uint32_t)CORE_STATS_HIST_MS - 1)]++;
+  }
+  lastServiceUs = now;
+}
+
+#ifdef AUDIO_DUAL_CORE
+
+// One producer advances head, one consumer advances tail
+template <size_t N>
+struct BlockRing
+{
+  int16_t samples[N][AUDIO_BLOCK];
+  uint16_t counts[N];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+
+  bool push(const int16_t *data, size_t n)
+  {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N)
+    {
+      return false;
+    }
+    memcpy(samples[h % N], data, n * sizeof(int16_t));
+    counts[h % N] = n;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Oldest block, NULL if empty
+  const int16_t *front(size_t &n)
+  {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+    {
+      return NULL;
+    }
+    n = counts[t % N];
+    return samples[t % N];
+  }
+
+  void pop()
+  {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Consumer side only
+  void clear()
+  {
+    tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  bool empty()
+  {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+};
+
+static BlockRing<AUDIO_MIC_BLOCKS> *micRing = NULL;
+static BlockRing<AUDIO_PLAY_BLOCKS> *playRing = NULL;
+
+// Requests from the loop, acknowledged by the audio task
+static std::atomic<bool> micFlush(false);
+static std::atomic<bool> playFlush(false);
+static std::atomic<bool> pauseRequest(false);
+static std::atomic<bool> paused(false);
+
+static void audioTask(void *param)
+{
+  static int16_t block[AUDIO_BLOCK];
+  while (true)
+  {
+    if (pauseRequest.load())
+    {
+      paused.store(true);
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
+    }
+    paused.store(false);
+
+    if (playFlush.load())
+    {
+      playRing->clear();
+      playFlush.store(false);
+    }
+
+    // Playback first; the mic is not read while the speaker plays
+    size_t n = 0;
+    const int16_t *out = playRing->front(n);
+    if (out)
+    {
+      size_t written = 0;
+      serviceMark();
+      i2s_write(speakerPort, out, n * sizeof(int16_t), &written, portMAX_DELAY);
+      playRing->pop();
+      continue;
+    }
+
+    size_t bytes = 0;
+    if (i2s_read(micPort, block, sizeof(block), &bytes, pdMS_TO_TICKS(10)) == ESP_OK && bytes > 0)
+    {
+      serviceMark();
+      if (!micRing->push(block, bytes / sizeof(int16_t)))
+      {
+        micRingDrops++; // The loop is busy with a turn, the queued audio stays
+      }
+    }
+  }
+}
+
+void coresBegin(i2s_port_t mic, i2s_port_t speaker)
+{
+  micPort = mic;
+  speakerPort = speaker;
+  micRing = new BlockRing<AUDIO_MIC_BLOCKS>();
+  playRing = new BlockRing<AUDIO_PLAY_BLOCKS>();
+  if (xTaskCreatePinnedToCore(audioTask, "audio", 4096, NULL, AUDIO_PRIORITY, NULL, AUDIO_CORE) != pdPASS)
+  {
+    Serial.println("ERROR: Failed to start the audio task");
+    return;
+  }
+  Serial.printf("Dual-core: audio on core %d, loop on core %d\n", AUDIO_CORE, xPortGetCoreID());
+}
+
+esp_err_t audioRead(int16_t *samples, size_t maxSamples, size_t *count, uint32_t timeoutMs)
+{
+  *count = 0;
+  if (micFlush.exchange(false))
+  {
+    micRing->clear();
+  }
+
+  uint32_t start = millis();
+  size_t n = 0;
+  const int16_t *block;
+  while (!(block = micRing->front(n)))
+  {
+    if (millis() - start >= timeoutMs)
+    {
+      return ESP_ERR_TIMEOUT;
+    }
+    vTaskDelay(1);
+  }
+  n = min(n, maxSamples);
+  memcpy(samples, block, n * sizeof(int16_t));
+  micRing->pop();
+  *count = n * sizeof(int16_t);
+  return ESP_OK;
+}
+
+void audioFlushMic()
+{
+  micFlush.store(true);
+}
+
+esp_err_t audioWrite(const int16_t *samples, size_t count)
+{
+  for (size_t pos = 0; pos < count;)
+  {
+    size_t n = min(count - pos, (size_t)AUDIO_BLOCK);
+    while (!playRing->push(samples + pos, n))
+    {
+      vTaskDelay(1); // Full: the DMA plays one block every 32 ms
+    }
+    pos += n;
+  }
+  return ESP_OK;
+}
+
+void audioWriteDone(bool discard)
+{
+  if (discard)
+  {
+    playFlush.store(true);
+  }
+  while (!playRing->empty() || playFlush.load())
+  {
+    vTaskDelay(1);
+  }
+}
+
+void audioPause(bool pause)
+{
+  pauseRequest.store(pause);
+  while (paused.load() != pause)
+  {
+    vTaskDelay(1);
+  }
+  if (!pause)
+  {
+    micFlush.store(true);
+  }
+}
+
+BaseType_t netTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                         TaskHandle_t *handle)
+{
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle, NET_CORE);
+}
+
+#else
+
+void coresBegin(i2s_port_t mic, i2s_port_t speaker)
+{
+  micPort = mic;
+  speakerPort = speaker;
+}
+
+esp_err_t audioRead(int16_t *samples, size_t maxSamples, size_t *count, uint32_t timeoutMs)
+{
+  esp_err_t result = i2s_read(micPort, samples, maxSamples * sizeof(int16_t), count, pdMS_TO_TICKS(timeoutMs));
+  if (result == ESP_OK && *count > 0)
+  {
+    serviceMark();
+  }
+  return result;
+}
+
+void audioFlushMic()
+{
+  static int16_t scratch[AUDIO_BLOCK];
+  size_t n = 0;
+  while (i2s_read(micPort, scratch, sizeof(scratch), &n, 0) == ESP_OK && n > 0)
+  {
+  }
+}
+
+esp_err_t audioWrite(const int16_t *samples, size_t count)
+{
+  size_t written = 0;
+  serviceMark();
+  return i2s_write(speakerPort, samples, count * sizeof(int16_t), &written, portMAX_DELAY);
+}
+
+void audioWriteDone(bool discard)
+{
+}
+
+void audioPause(bool pause)
+{
+}
+
+BaseType_t netTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority,
+                         TaskHandle_t *handle)
+{
+  return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+#endif
+
+static bool idleHook0()
+{
+  idleCount[0]++;
+  return false; // Keep spinning, so the count follows idle time
+}
+
+#if portNUM_PROCESSORS > 1
+static bool idleHook1()
+{
+  idleCount[1]++;
+  return false;
+}
+#endif
+
+void coreStatsStart()
+{
+  if (!hooksInstalled)
+  {
+    esp_register_freertos_idle_hook_for_cpu(idleHook0, 0);
+#if portNUM_PROCESSORS > 1
+    esp_register_freertos_idle_hook_for_cpu(idleHook1, 1);
+#endif
+    hooksInstalled = true;
+  }
+
+  // Idle rate while this task sleeps, the baseline for 0% load
+  uint32_t before[portNUM_PROCESSORS];
+  for (int i = 0; i < portNUM_PROCESSORS; i++)
+  {
+    before[i] = idleCount[i];
+  }
+  uint32_t t0 = millis();
+  delay(200);
+  uint32_t ms = millis() - t0;
+  for (int i = 0; i < portNUM_PROCESSORS; i++)
+  {
+    idleRate[i] = (float)(idleCount[i] - before[i]) / ms;
+    idleStart[i] = idleCount[i];
+  }
+
+  memset(serviceHist, 0, sizeof(serviceHist));
+  serviceCount = 0;
+  serviceMaxUs = 0;
+  lastServiceUs = 0;
+  statsMic = i2sAudioCounters(micPort);
+  statsSpeaker = i2sAudioCounters(speakerPort);
+  statsRingDrops = micRingDrops.load();
+  i2sAudioWatch(micPort, true);
+  statsStartMs = millis();
+  measuring = true;
+  Serial.println("Measuring, run a voice turn now, then stop the measurement");
+}
+
+bool coreStatsRunning()
+{
+  return measuring;
+}
+
+static uint32_t percentileMs(uint32_t permille)
+{
+  uint32_t want = (uint64_t)serviceCount * permille / 1000, seen = 0;
+  for (int i = 0; i < CORE_STATS_HIST_MS; i++)
+  {
+    seen += serviceHist[i];
+    if (seen > want)
+    {
+      return i + 1;
+    }
+  }
+  return CORE_STATS_HIST_MS;
+}
+
+void coreStatsReport()
+{
+  measuring = false;
+  i2sAudioWatch(micPort, false);
+  uint32_t ms = millis() - statsStartMs;
+
+  // The hooks spin for as long as they are installed
+  esp_deregister_freertos_idle_hook_for_cpu(idleHook0, 0);
+#if portNUM_PROCESSORS > 1
+  esp_deregister_freertos_idle_hook_for_cpu(idleHook1, 1);
+#endif
+  hooksInstalled = false;
+
+#ifdef AUDIO_DUAL_CORE
+  Serial.printf("\n=== Cores: dual-core build, audio on core %d, %lu s ===\n", AUDIO_CORE, ms / 1000);
+#else
+  Serial.printf("\n=== Cores: single-core build, audio in the loop, %lu s ===\n", ms / 1000);
+#endif
+  for (int i = 0; i < portNUM_PROCESSORS; i++)
+  {
+    float idle = idleRate[i] > 0 ? (idleCount[i] - idleStart[i]) / (idleRate[i] * ms) : 0;
+    Serial.printf("Core %d: %3.0f%% busy\n", i, 100 * (1 - constrain(idle, 0.0f, 1.0f)));
+  }
+
+  // A gap longer than the DMA ring loses mic audio or plays silence
+  I2sGeometry g = i2sAudioGeometry(micPort);
+  uint32_t ringMs = (uint32_t)g.count * g.len * 1000 / 16000;
+  uint32_t over = 0;
+  for (int i = ringMs; i < CORE_STATS_HIST_MS; i++)
+  {
+    over += serviceHist[i];
+  }
+  Serial.printf("I2S service: %lu calls, interval p50 %lu ms, p99 %lu ms, max %lu ms, %lu over the %lu ms DMA ring\n",
+                serviceCount, percentileMs(500), percentileMs(990), serviceMaxUs / 1000, over, ringMs);
+
+  I2sCounters mic = i2sAudioCounters(micPort), speaker = i2sAudioCounters(speakerPort);
+  uint32_t ringDrops = micRingDrops.load() - statsRingDrops;
+  Serial.printf("Drops: %lu mic overflows (%lu blocks in the mic ring), %lu speaker underruns\n",
+                mic.drops - statsMic.drops + ringDrops, ringDrops, speaker.drops - statsSpeaker.drops);
+}
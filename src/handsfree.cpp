@@ -0,0 +1,241 @@
+#include "handsfree.h"
+
+enum HandsFreeState
+{
+  HF_OFF = 0,
+  HF_LISTENING, // Armed, waiting for speech
+  HF_SPEECH,    // Recording an utterance
+  HF_TURN       // Transcribing, answering and playing
+};
+
+struct TurnTiming
+{
+  uint32_t replyMs; // End of speech to first answer audio, 0 if nothing was played
+  uint32_t rearmMs; // End of the answer (or of speech) to listening again
+};
+
+static HandsFreeState state = HF_OFF;
+static uint32_t noiseFloor = 0;
+static uint32_t armedAt = 0; // millis() when listening started
+static uint32_t loudMs = 0;  // Audio time of the current run of loud frames
+static uint32_t quietMs = 0; // Audio time of silence since the last loud frame
+static uint32_t speechMs = 0;
+
+static int16_t preroll[HF_PREROLL_SAMPLES];
+static size_t prerollHead = 0; // Next write position
+static bool prerollFull = false;
+
+static TurnTiming turns[HF_TURN_HISTORY];
+static int turnCount = 0;       // Completed turns this session
+static uint32_t turnEndAt = 0;  // millis() at end of speech
+static uint32_t replyAt = 0;    // First answer audio, 0 until then
+static uint32_t replyEndAt = 0; // Answer finished playing, 0 until then
+
+static uint32_t frameRms(const int16_t *samples, size_t count)
+{
+  uint64_t sum = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += (int32_t)samples[i] * samples[i];
+  }
+  return count ? sqrtf((float)(sum / count)) : 0;
+}
+
+static void prerollPush(const int16_t *samples, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    preroll[prerollHead++] = samples[i];
+    if (prerollHead == HF_PREROLL_SAMPLES)
+    {
+      prerollHead = 0;
+      prerollFull = true;
+    }
+  }
+}
+
+static void listen()
+{
+  state = HF_LISTENING;
+  armedAt = millis();
+  loudMs = 0;
+  prerollHead = 0;
+  prerollFull = false;
+}
+
+void handsFreeStart()
+{
+  if (state != HF_OFF)
+  {
+    return;
+  }
+  noiseFloor = 0;
+  turnCount = 0;
+  listen();
+  Serial.println("Hands-free mode on, speak any time (say \"stop listening\" to end)");
+}
+
+void handsFreeStop(const char *reason)
+{
+  if (state == HF_OFF)
+  {
+    return;
+  }
+  state = HF_OFF;
+  Serial.printf("Hands-free mode off: %s\n", reason);
+  handsFreeReport();
+}
+
+bool handsFreeActive()
+{
+  return state != HF_OFF;
+}
+
+EndpointEvent handsFreeFeed(const int16_t *samples, size_t count)
+{
+  if (state != HF_LISTENING && state != HF_SPEECH)
+  {
+    return EP_NONE;
+  }
+
+  uint32_t frameMs = count * 1000 / HF_SAMPLE_RATE;
+  uint32_t rms = frameRms(samples, count);
+  uint32_t threshold = max((uint32_t)HF_MIN_SPEECH_RMS, noiseFloor * HF_NOISE_MULT);
+  bool loud = rms > threshold;
+
+  if (state == HF_LISTENING)
+  {
+    prerollPush(samples, count);
+    bool guard = millis() - armedAt < HF_REARM_GUARD_MS;
+
+    // The floor only follows quiet frames, or speech would raise it
+    if (!loud || guard)
+    {
+      noiseFloor = noiseFloor ? (noiseFloor * 15 + rms) / 16 : rms;
+    }
+    if (guard)
+    {
+      return EP_NONE;
+    }
+
+    if (!loud)
+    {
+      loudMs = 0;
+      return millis() - armedAt > HF_IDLE_MS ? EP_IDLE : EP_NONE;
+    }
+    loudMs += frameMs;
+    if (loudMs < HF_ONSET_MS)
+    {
+      return EP_NONE;
+    }
+    state = HF_SPEECH;
+    speechMs = loudMs;
+    quietMs = 0;
+    return EP_SPEECH_START;
+  }
+
+  // In speech: quiet frames count towards the hangover until it is reached
+  speechMs += frameMs;
+  quietMs = loud ? 0 : quietMs + frameMs;
+  if (quietMs < HF_HANGOVER_MS)
+  {
+    return EP_NONE;
+  }
+  if (speechMs - quietMs < HF_MIN_SPEECH_MS)
+  {
+    listen();
+    return EP_CANCEL;
+  }
+  handsFreeTurnStart();
+  return EP_SPEECH_END;
+}
+
+void handsFreePreroll(PrerollSink sink, void *ctx)
+{
+  // The part after the write position, then the part before
+  if (prerollFull)
+  {
+    sink(ctx, preroll + prerollHead, HF_PREROLL_SAMPLES - prerollHead);
+  }
+  if (prerollHead)
+  {
+    sink(ctx, preroll, prerollHead);
+  }
+}
+
+void handsFreeTurnStart()
+{
+  if (state == HF_OFF)
+  {
+    return;
+  }
+  state = HF_TURN;
+  turnEndAt = millis();
+  replyAt = 0;
+  replyEndAt = 0;
+}
+
+void handsFreeReplyStarted()
+{
+  if (state == HF_TURN && replyAt == 0)
+  {
+    replyAt = millis();
+  }
+}
+
+void handsFreeReplyEnded()
+{
+  if (state == HF_TURN)
+  {
+    replyEndAt = millis(); // The last chunk of a long answer wins
+  }
+}
+
+void handsFreeRearm()
+{
+  if (state != HF_TURN)
+  {
+    return;
+  }
+
+  uint32_t now = millis();
+  TurnTiming &t = turns[turnCount % HF_TURN_HISTORY];
+  t.replyMs = replyAt ? replyAt - turnEndAt : 0;
+  t.rearmMs = now - (replyEndAt ? replyEndAt : turnEndAt);
+  turnCount++;
+  listen();
+}
+
+void handsFreeReport()
+{
+  int count = min(turnCount, HF_TURN_HISTORY);
+  Serial.printf("\n=== Hands-free: %d turns, noise floor %lu ===\n", turnCount, noiseFloor);
+  if (count == 0)
+  {
+    return;
+  }
+
+  uint32_t replySum = 0, replyMin = UINT32_MAX, replyMax = 0, rearmSum = 0, rearmMax = 0;
+  int replies = 0;
+  for (int i = 0; i < count; i++)
+  {
+    // Oldest first
+    const TurnTiming &t = turns[(turnCount - count + i) % HF_TURN_HISTORY];
+    Serial.printf("  turn %3d: reply %5lu ms, re-arm %4lu ms\n", turnCount - count + i + 1, t.replyMs, t.rearmMs);
+    if (t.replyMs)
+    {
+      replySum += t.replyMs;
+      replyMin = min(replyMin, t.replyMs);
+      replyMax = max(replyMax, t.replyMs);
+      replies++;
+    }
+    rearmSum += t.rearmMs;
+    rearmMax = max(rearmMax, t.rearmMs);
+  }
+  if (replies)
+  {
+    Serial.printf("Reply latency: mean %lu ms, min %lu, max %lu (%d answered)\n", replySum / replies, replyMin,
+                  replyMax, replies);
+  }
+  Serial.printf("Re-arm gap: mean %lu ms, max %lu\n", rearmSum / count, rearmMax);
+}
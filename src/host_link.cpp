@@ -0,0 +1,466 @@
+#include "host_link.h"
+#include "i2s_audio.h"
+#include <SD.h>
+#include <WiFi.h>
+#include <atomic>
+
+static i2s_port_t micPort;
+static i2s_port_t speakerPort;
+static uint32_t micRate;
+
+static uint16_t crcTable[256];
+
+static std::atomic<bool> active(false);
+static uint32_t lastRequestMs = 0;
+
+// Request parser, loop side
+enum
+{
+  PARSE_SYNC0 = 0,
+  PARSE_SYNC1,
+  PARSE_TYPE,
+  PARSE_SEQ,
+  PARSE_LEN_LO,
+  PARSE_LEN_HI,
+  PARSE_PAYLOAD,
+  PARSE_CRC_LO,
+  PARSE_CRC_HI
+};
+
+struct HostRequest
+{
+  uint8_t type;
+  uint16_t len;
+  uint8_t payload[HOST_MAX_REQUEST + 1]; // NUL-terminated, for paths
+};
+
+static uint8_t parseState = PARSE_SYNC0;
+static HostRequest parsed;
+static uint16_t parsePos;
+static uint16_t parseCrc;
+static uint32_t badFrames = 0;
+
+// Parsed requests, from the loop to the link task
+#define HOST_REQUESTS 8
+static HostRequest requests[HOST_REQUESTS];
+static std::atomic<uint32_t> requestHead(0);
+static std::atomic<uint32_t> requestTail(0);
+
+// Mic blocks, from the loop to the link task. Every sample offered while
+// streaming gets an index, dropped ones too, so the host sees the gaps.
+struct MicBlock
+{
+  uint32_t index;
+  uint16_t count;
+  int16_t samples[HOST_MIC_BLOCK];
+};
+static MicBlock *micBlocks = NULL;
+static std::atomic<uint32_t> micHead(0);
+static std::atomic<uint32_t> micTail(0);
+static std::atomic<bool> micOn(false);
+static uint32_t micIndex = 0;
+static volatile uint32_t streamDrops = 0;
+
+// Link task state
+static uint8_t txFrame[HOST_HEADER + HOST_MAX_PAYLOAD + HOST_CRC];
+static uint8_t txSeq = 0;
+static volatile uint32_t txBytes = 0;
+static File fetchFile;
+static uint32_t fetchOffset = 0;
+static uint16_t telemetryPeriod = 0;
+static uint32_t telemetryLast = 0;
+static uint32_t benchUntil = 0;
+static uint32_t benchFrames = 0;
+
+static uint16_t crcUpdate(uint16_t crc, const uint8_t *data, size_t len)
+{
+  while (len--)
+  {
+    crc = (crc << 8) ^ crcTable[(crc >> 8) ^ *data++];
+  }
+  return crc;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+// Payload of the frame being built
+static uint8_t *txPayload()
+{
+  return txFrame + HOST_HEADER;
+}
+
+// Send txPayload() as one frame, in a single write
+static void sendFrame(uint8_t type, size_t len)
+{
+  txFrame[0] = HOST_SYNC0;
+  txFrame[1] = HOST_SYNC1;
+  txFrame[2] = type;
+  txFrame[3] = txSeq++;
+  put16(txFrame + 4, len);
+  uint16_t crc = crcUpdate(0xFFFF, txFrame + 2, HOST_HEADER - 2 + len);
+  put16(txFrame + HOST_HEADER + len, crc);
+  txBytes += Serial.write(txFrame, HOST_HEADER + len + HOST_CRC);
+}
+
+static void sendDone(uint8_t request, uint8_t status, uint32_t count)
+{
+  uint8_t *p = txPayload();
+  p[0] = request;
+  p[1] = status;
+  put32(p + 2, count);
+  sendFrame(HOST_MSG_DONE, 6);
+}
+
+static void sendFileInfo(uint32_t size, const char *path)
+{
+  uint8_t *p = txPayload();
+  size_t len = min(strlen(path), (size_t)HOST_MAX_PAYLOAD - 4);
+  put32(p, size);
+  memcpy(p + 4, path, len);
+  sendFrame(HOST_MSG_FILE, 4 + len);
+}
+
+static void sendTelemetry()
+{
+  HostTelemetry t;
+  I2sCounters mic = i2sAudioCounters(micPort), speaker = i2sAudioCounters(speakerPort);
+  t.uptimeMs = millis();
+  t.freeHeap = ESP.getFreeHeap();
+  t.minFreeHeap = ESP.getMinFreeHeap();
+  t.largestBlock = ESP.getMaxAllocHeap();
+  t.freePsram = ESP.getFreePsram();
+  t.micBuffers = mic.buffers;
+  t.micDrops = mic.drops;
+  t.speakerDrops = speaker.drops;
+  t.streamDrops = streamDrops;
+  t.txBytes = txBytes;
+  t.rssi = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+  memcpy(txPayload(), &t, sizeof(t));
+  sendFrame(HOST_MSG_TELEMETRY, sizeof(t));
+}
+
+static void listFiles()
+{
+  uint32_t count = 0;
+  File root = SD.open("/");
+  File file = root ? root.openNextFile() : File();
+  while (file)
+  {
+    if (!file.isDirectory())
+    {
+      sendFileInfo(file.size(), file.path());
+      count++;
+    }
+    file.close();
+    file = root.openNextFile();
+  }
+  root.close();
+  sendDone(HOST_REQ_LIST, HOST_STATUS_OK, count);
+}
+
+static void stopStreams()
+{
+  micOn.store(false);
+  if (fetchFile)
+  {
+    fetchFile.close();
+  }
+  telemetryPeriod = 0;
+  benchUntil = 0;
+}
+
+static void handleRequest(const HostRequest &r)
+{
+  switch (r.type)
+  {
+  case HOST_REQ_HELLO:
+  {
+    uint8_t *p = txPayload();
+    p[0] = HOST_VERSION;
+    put32(p + 1, micRate);
+    put16(p + 5, HOST_MAX_PAYLOAD);
+    sendFrame(HOST_MSG_HELLO, 7);
+    break;
+  }
+  case HOST_REQ_MIC:
+    if (r.len >= 1 && r.payload[0] && !micBlocks)
+    {
+      micBlocks = new MicBlock[HOST_MIC_BLOCKS];
+    }
+    micTail.store(micHead.load(std::memory_order_acquire), std::memory_order_release);
+    micOn.store(r.len >= 1 && r.payload[0], std::memory_order_release);
+    sendDone(HOST_REQ_MIC, HOST_STATUS_OK, micIndex);
+    break;
+  case HOST_REQ_LIST:
+    listFiles();
+    break;
+  case HOST_REQ_FETCH:
+    if (fetchFile)
+    {
+      fetchFile.close();
+    }
+    fetchFile = SD.open((const char *)r.payload, FILE_READ);
+    if (!fetchFile || fetchFile.isDirectory())
+    {
+      fetchFile.close();
+      sendDone(HOST_REQ_FETCH, HOST_STATUS_NOT_FOUND, 0);
+      break;
+    }
+    fetchOffset = 0;
+    sendFileInfo(fetchFile.size(), (const char *)r.payload);
+    break;
+  case HOST_REQ_TELEMETRY:
+    telemetryPeriod = r.len >= 2 ? r.payload[0] | r.payload[1] << 8 : 0;
+    telemetryLast = millis();
+    sendTelemetry();
+    break;
+  case HOST_REQ_BENCH:
+    benchUntil = millis() + 1000 * (r.len >= 2 ? r.payload[0] | r.payload[1] << 8 : 1);
+    benchFrames = 0;
+    break;
+  case HOST_REQ_EXIT:
+    stopStreams();
+    active.store(false);
+    Serial.println("Host link off, back to command keys");
+    break;
+  default:
+    sendDone(r.type, HOST_STATUS_BAD_REQUEST, 0);
+    break;
+  }
+}
+
+// Queued mic blocks, one frame each. Returns true if any were sent.
+static bool sendMic()
+{
+  bool sent = false;
+  uint32_t t = micTail.load(std::memory_order_relaxed);
+  while (micHead.load(std::memory_order_acquire) != t)
+  {
+    const MicBlock &b = micBlocks[t % HOST_MIC_BLOCKS];
+    uint8_t *p = txPayload();
+    put32(p, b.index);
+    memcpy(p + 4, b.samples, b.count * sizeof(int16_t));
+    micTail.store(++t, std::memory_order_release);
+    sendFrame(HOST_MSG_MIC, 4 + b.count * sizeof(int16_t));
+    sent = true;
+  }
+  return sent;
+}
+
+// Next chunk of the file being fetched
+static bool sendFileChunk()
+{
+  if (!fetchFile)
+  {
+    return false;
+  }
+  uint8_t *p = txPayload();
+  int n = fetchFile.read(p + 4, HOST_MAX_PAYLOAD - 4);
+  if (n <= 0)
+  {
+    bool complete = fetchOffset == fetchFile.size();
+    fetchFile.close();
+    sendDone(HOST_REQ_FETCH, complete ? HOST_STATUS_OK : HOST_STATUS_READ_ERROR, fetchOffset);
+    return true;
+  }
+  put32(p, fetchOffset);
+  sendFrame(HOST_MSG_DATA, 4 + n);
+  fetchOffset += n;
+  return true;
+}
+
+static bool sendBench()
+{
+  if (!benchUntil)
+  {
+    return false;
+  }
+  if ((int32_t)(millis() - benchUntil) >= 0)
+  {
+    benchUntil = 0;
+    sendDone(HOST_REQ_BENCH, HOST_STATUS_OK, benchFrames);
+    return true;
+  }
+  memset(txPayload(), (uint8_t)benchFrames, HOST_MAX_PAYLOAD);
+  sendFrame(HOST_MSG_BENCH, HOST_MAX_PAYLOAD);
+  benchFrames++;
+  return true;
+}
+
+static void hostTask(void *param)
+{
+  while (true)
+  {
+    uint32_t t = requestTail.load(std::memory_order_relaxed);
+    while (requestHead.load(std::memory_order_acquire) != t)
+    {
+      handleRequest(requests[t % HOST_REQUESTS]);
+      requestTail.store(++t, std::memory_order_release);
+    }
+    if (!active.load())
+    {
+      stopStreams();
+      vTaskDelay(pdMS_TO_TICKS(50));
+      continue;
+    }
+
+    // Mic first, a file or a benchmark only fills the gaps
+    bool busy = micBlocks && sendMic();
+    busy |= sendFileChunk();
+    busy |= sendBench();
+    if (telemetryPeriod && millis() - telemetryLast >= telemetryPeriod)
+    {
+      telemetryLast += telemetryPeriod;
+      sendTelemetry();
+    }
+    if (!busy)
+    {
+      vTaskDelay(pdMS_TO_TICKS(5));
+    }
+  }
+}
+
+void hostLinkBegin(i2s_port_t mic, i2s_port_t speaker, uint32_t sampleRate)
+{
+  micPort = mic;
+  speakerPort = speaker;
+  micRate = sampleRate;
+  for (int i = 0; i < 256; i++)
+  {
+    uint16_t crc = i << 8;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    crcTable[i] = crc;
+  }
+  xTaskCreate(hostTask, "hostlink", 4096, NULL, 1, NULL);
+}
+
+void hostLinkStart()
+{
+  Serial.println("Host link on, binary frames from here (scripts/jarvis_host.py)");
+  parseState = PARSE_SYNC0;
+  lastRequestMs = millis();
+  active.store(true);
+}
+
+bool hostLinkActive()
+{
+  return active.load();
+}
+
+static void queueRequest()
+{
+  uint32_t h = requestHead.load(std::memory_order_relaxed);
+  if (h - requestTail.load(std::memory_order_acquire) >= HOST_REQUESTS)
+  {
+    badFrames++; // The host retries after its timeout
+    return;
+  }
+  parsed.payload[parsed.len] = 0;
+  requests[h % HOST_REQUESTS] = parsed;
+  requestHead.store(h + 1, std::memory_order_release);
+  lastRequestMs = millis();
+}
+
+void hostLinkPoll()
+{
+  while (Serial.available())
+  {
+    uint8_t b = Serial.read();
+    switch (parseState)
+    {
+    case PARSE_SYNC0:
+      if (b == HOST_SYNC0)
+        parseState = PARSE_SYNC1;
+      break;
+    case PARSE_SYNC1:
+      parseState = b == HOST_SYNC1 ? PARSE_TYPE : (b == HOST_SYNC0 ? PARSE_SYNC1 : PARSE_SYNC0);
+      break;
+    case PARSE_TYPE:
+      parsed.type = b;
+      parseCrc = crcUpdate(0xFFFF, &b, 1);
+      parseState = PARSE_SEQ;
+      break;
+    case PARSE_SEQ:
+      parseCrc = crcUpdate(parseCrc, &b, 1);
+      parseState = PARSE_LEN_LO;
+      break;
+    case PARSE_LEN_LO:
+      parsed.len = b;
+      parseCrc = crcUpdate(parseCrc, &b, 1);
+      parseState = PARSE_LEN_HI;
+      break;
+    case PARSE_LEN_HI:
+      parsed.len |= b << 8;
+      parseCrc = crcUpdate(parseCrc, &b, 1);
+      parsePos = 0;
+      if (parsed.len > HOST_MAX_REQUEST)
+        parseState = PARSE_SYNC0; // Not a real header, resync
+      else
+        parseState = parsed.len ? PARSE_PAYLOAD : PARSE_CRC_LO;
+      break;
+    case PARSE_PAYLOAD:
+      parsed.payload[parsePos++] = b;
+      parseCrc = crcUpdate(parseCrc, &b, 1);
+      if (parsePos >= parsed.len)
+        parseState = PARSE_CRC_LO;
+      break;
+    case PARSE_CRC_LO:
+      parseCrc ^= b;
+      parseState = PARSE_CRC_HI;
+      break;
+    case PARSE_CRC_HI:
+      parseState = PARSE_SYNC0;
+      if ((parseCrc ^ (b << 8)) == 0)
+        queueRequest();
+      else
+        badFrames++;
+      break;
+    }
+  }
+
+  if (active.load() && millis() - lastRequestMs > HOST_IDLE_MS)
+  {
+    active.store(false);
+    Serial.printf("Host link idle, back to command keys (%lu bad frames)\n", badFrames);
+  }
+}
+
+void hostLinkMic(const int16_t *samples, size_t count)
+{
+  if (!micOn.load(std::memory_order_acquire))
+  {
+    return;
+  }
+  for (size_t pos = 0; pos < count;)
+  {
+    size_t n = min(count - pos, (size_t)HOST_MIC_BLOCK);
+    uint32_t h = micHead.load(std::memory_order_relaxed);
+    if (h - micTail.load(std::memory_order_acquire) >= HOST_MIC_BLOCKS)
+    {
+      streamDrops += n; // USB is behind, never wait for it here
+    }
+    else
+    {
+      MicBlock &b = micBlocks[h % HOST_MIC_BLOCKS];
+      b.index = micIndex;
+      b.count = n;
+      memcpy(b.samples, samples + pos, n * sizeof(int16_t));
+      micHead.store(h + 1, std::memory_order_release);
+    }
+    micIndex += n;
+    pos += n;
+  }
+}
@@ -0,0 +1,276 @@
+#include "http_response.h"
+#include <lwip/sockets.h>
+
+void httpResponseInit(HttpResponse &r, HttpBodyCallback onBody, void *ctx)
+{
+  r.status = 0;
+  r.contentLength = -1;
+  r.chunked = false;
+  r.keepAlive = true; // HTTP/1.1 default
+  r.contentType[0] = '\0';
+  r.bodyBytes = 0;
+  r.state = HTTP_STATUS_LINE;
+  r.remaining = 0;
+  r.lineLen = 0;
+  r.onBody = onBody;
+  r.ctx = ctx;
+}
+
+// Case-insensitive "Name:" check, returns the trimmed value or NULL
+static const char *headerValue(const char *line, const char *name)
+{
+  size_t n = strlen(name);
+  if (strncasecmp(line, name, n) != 0 || line[n] != ':')
+    return NULL;
+  const char *v = line + n + 1;
+  while (*v == ' ' || *v == '\t')
+    v++;
+  return v;
+}
+
+static void parseStatusLine(HttpResponse &r)
+{
+  // HTTP/1.1 200 OK
+  if (strncmp(r.line, "HTTP/1.", 7) != 0 || r.lineLen < 12)
+  {
+    r.state = HTTP_ERROR;
+    return;
+  }
+  r.status = atoi(r.line + 9);
+  if (r.line[7] == '0')
+    r.keepAlive = false; // HTTP/1.0 closes unless told otherwise
+  r.state = HTTP_HEADERS;
+}
+
+static void parseHeader(HttpResponse &r)
+{
+  const char *v;
+  if ((v = headerValue(r.line, "Content-Length")) != NULL)
+  {
+    r.contentLength = strtol(v, NULL, 10);
+  }
+  else if ((v = headerValue(r.line, "Transfer-Encoding")) != NULL)
+  {
+    r.chunked = strstr(v, "chunked") != NULL;
+  }
+  else if ((v = headerValue(r.line, "Connection")) != NULL)
+  {
+    if (strncasecmp(v, "close", 5) == 0)
+      r.keepAlive = false;
+    else if (strncasecmp(v, "keep-alive", 10) == 0)
+      r.keepAlive = true;
+  }
+  else if ((v = headerValue(r.line, "Content-Type")) != NULL)
+  {
+    strncpy(r.contentType, v, sizeof(r.contentType) - 1);
+    r.contentType[sizeof(r.contentType) - 1] = '\0';
+  }
+}
+
+// Blank line after the headers: decide how the body is framed
+static void startBody(HttpResponse &r)
+{
+  if (r.status == 101)
+  {
+    // Switching Protocols: what follows belongs to the new protocol
+    r.state = HTTP_DONE;
+    return;
+  }
+  if (r.status >= 100 && r.status < 200)
+  {
+    // 100 Continue and friends, the real response follows
+    bool keep = r.keepAlive;
+    httpResponseInit(r, r.onBody, r.ctx);
+    r.keepAlive = keep;
+    return;
+  }
+  if (r.status == 204 || r.status == 304)
+  {
+    r.state = HTTP_DONE;
+  }
+  else if (r.chunked)
+  {
+    r.state = HTTP_CHUNK_SIZE;
+  }
+  else if (r.contentLength >= 0)
+  {
+    r.remaining = r.contentLength;
+    r.state = r.remaining ? HTTP_BODY_LENGTH : HTTP_DONE;
+  }
+  else
+  {
+    r.keepAlive = false; // Only the close marks the end
+    r.state = HTTP_BODY_UNTIL_CLOSE;
+  }
+}
+
+static void lineComplete(HttpResponse &r)
+{
+  r.line[r.lineLen] = '\0';
+  switch (r.state)
+  {
+  case HTTP_STATUS_LINE:
+    parseStatusLine(r);
+    break;
+  case HTTP_HEADERS:
+    if (r.lineLen == 0)
+      startBody(r);
+    else
+      parseHeader(r);
+    break;
+  case HTTP_CHUNK_SIZE:
+  {
+    char *end;
+    r.remaining = strtoul(r.line, &end, 16); // Chunk extensions after ';' are ignored
+    if (end == r.line)
+      r.state = HTTP_ERROR;
+    else
+      r.state = r.remaining ? HTTP_CHUNK_DATA : HTTP_TRAILERS;
+    break;
+  }
+  case HTTP_CHUNK_DATA_END:
+    r.state = (r.lineLen == 0) ? HTTP_CHUNK_SIZE : HTTP_ERROR;
+    break;
+  case HTTP_TRAILERS:
+    if (r.lineLen == 0)
+      r.state = HTTP_DONE;
+    break;
+  default:
+    break;
+  }
+  r.lineLen = 0;
+}
+
+static bool deliver(HttpResponse &r, const uint8_t *data, size_t len)
+{
+  r.bodyBytes += len;
+  if (r.onBody && !r.onBody(r.ctx, data, len))
+  {
+    r.state = HTTP_ERROR;
+    return false;
+  }
+  return true;
+}
+
+size_t httpResponseFeed(HttpResponse &r, const uint8_t *data, size_t len)
+{
+  size_t pos = 0;
+  while (pos < len && r.state != HTTP_DONE && r.state != HTTP_ERROR)
+  {
+    switch (r.state)
+    {
+    case HTTP_BODY_LENGTH:
+    case HTTP_CHUNK_DATA:
+    {
+      size_t n = min((size_t)r.remaining, len - pos);
+      if (!deliver(r, data + pos, n))
+        return pos;
+      pos += n;
+      r.remaining -= n;
+      if (r.remaining == 0)
+        r.state = (r.state == HTTP_BODY_LENGTH) ? HTTP_DONE : HTTP_CHUNK_DATA_END;
+      break;
+    }
+    case HTTP_BODY_UNTIL_CLOSE:
+      if (!deliver(r, data + pos, len - pos))
+        return pos;
+      pos = len;
+      break;
+    default:
+    {
+      // Line-oriented states
+      char c = data[pos++];
+      if (c == '\n')
+      {
+        if (r.lineLen > 0 && r.line[r.lineLen - 1] == '\r')
+          r.lineLen--;
+        lineComplete(r);
+      }
+      else if (r.lineLen < HTTP_MAX_LINE - 1)
+      {
+        r.line[r.lineLen++] = c;
+      }
+      // Overlong header lines are truncated, we only need their start
+      break;
+    }
+    }
+  }
+  return pos;
+}
+
+void httpResponseEof(HttpResponse &r)
+{
+  if (r.state == HTTP_BODY_UNTIL_CLOSE)
+    r.state = HTTP_DONE;
+  else if (r.state != HTTP_DONE)
+    r.state = HTTP_ERROR;
+}
+
+// Block until the socket has data or timeoutMs passes. Only called when
+// available() is 0, which for TLS already counts decrypted bytes held by
+// mbedTLS, so new data has to come from the socket. Clients without a
+// socket fd fall back to a 1 ms poll.
+static void waitReadable(WiFiClient &client, uint32_t timeoutMs)
+{
+  int fd = client.fd();
+  if (fd < 0)
+  {
+    delay(1);
+    return;
+  }
+
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  select(fd + 1, &readSet, NULL, NULL, &tv);
+}
+
+bool httpReadResponse(WiFiClient &client, HttpResponse &r, uint32_t timeoutMs, HttpCarry *carry)
+{
+  uint8_t buffer[HTTP_READ_CHUNK];
+  uint32_t start = millis();
+
+  if (carry && carry->pos < carry->len)
+  {
+    carry->pos += httpResponseFeed(r, carry->data + carry->pos, carry->len - carry->pos);
+  }
+
+  while (!httpResponseDone(r) && !httpResponseFailed(r))
+  {
+    int available = client.available();
+    if (available > 0)
+    {
+      int n = client.read(buffer, min((size_t)available, sizeof(buffer)));
+      if (n > 0)
+      {
+        size_t used = httpResponseFeed(r, buffer, n);
+        if (carry && httpResponseDone(r) && used < (size_t)n)
+        {
+          // Start of the next pipelined response
+          memcpy(carry->data, buffer + used, n - used);
+          carry->pos = 0;
+          carry->len = n - used;
+        }
+      }
+      continue;
+    }
+
+    if (!client.connected())
+    {
+      httpResponseEof(r);
+      break;
+    }
+
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeoutMs)
+    {
+      break;
+    }
+    waitReadable(client, min(timeoutMs - elapsed, (uint32_t)100));
+  }
+
+  return httpResponseDone(r);
+}
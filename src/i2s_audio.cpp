@@ -0,0 +1,396 @@
+#include "i2s_audio.h"
+#include "loopback.h"
+#include <Preferences.h>
+#include <SD.h>
+
+#define CAL_FILE "/i2scal.raw"
+
+struct PortState
+{
+  bool installed;
+  i2s_config_t config; // As passed in, the default geometry
+  i2s_pin_config_t pins;
+  I2sGeometry geometry; // Installed
+  QueueHandle_t events;
+
+  volatile bool watched;
+  volatile uint32_t buffers;
+  volatile uint32_t drops;
+  volatile uint32_t dmaErrors;
+  uint32_t watchDrops; // drops when the watch started
+};
+
+static PortState ports[I2S_NUM_MAX];
+static SemaphoreHandle_t lock = NULL; // Held while queues are drained or replaced
+
+static const uint16_t calCounts[] = {2, 3, 4, 6, 8, 12, 16};
+static const uint16_t calLens[] = {1024, 512, 256, 128};
+static uint32_t loadSeed = 0;
+
+static bool isMic(const PortState &p)
+{
+  return p.config.mode & I2S_MODE_RX;
+}
+
+// Caller holds the lock
+static void drain(PortState &p)
+{
+  i2s_event_t event;
+  while (p.events && xQueueReceive(p.events, &event, 0) == pdTRUE)
+  {
+    if (!p.watched)
+    {
+      continue;
+    }
+    switch (event.type)
+    {
+    case I2S_EVENT_RX_DONE:
+    case I2S_EVENT_TX_DONE:
+      p.buffers++;
+      break;
+    case I2S_EVENT_RX_Q_OVF: // Every buffer full, the oldest was dropped
+    case I2S_EVENT_TX_Q_OVF: // Every buffer played, one was played again or as silence
+      p.drops++;
+      break;
+    case I2S_EVENT_DMA_ERROR:
+      p.dmaErrors++;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static void eventTask(void *param)
+{
+  while (true)
+  {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < I2S_NUM_MAX; i++)
+    {
+      drain(ports[i]);
+    }
+    xSemaphoreGive(lock);
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+static void geometryKeys(i2s_port_t port, char *countKey, char *lenKey)
+{
+  sprintf(countKey, "count%d", port);
+  sprintf(lenKey, "len%d", port);
+}
+
+static I2sGeometry loadGeometry(i2s_port_t port, const i2s_config_t &config)
+{
+  char countKey[12], lenKey[12];
+  geometryKeys(port, countKey, lenKey);
+
+  Preferences prefs;
+  prefs.begin("audio", true);
+  I2sGeometry g = {prefs.getUShort(countKey, config.dma_buf_count), prefs.getUShort(lenKey, config.dma_buf_len)};
+  prefs.end();
+
+  // Driver limits
+  if (g.count < 2 || g.count > 128 || g.len < 8 || g.len > 1024)
+  {
+    g.count = config.dma_buf_count;
+    g.len = config.dma_buf_len;
+  }
+  return g;
+}
+
+static void saveGeometry(i2s_port_t port, I2sGeometry g)
+{
+  char countKey[12], lenKey[12];
+  geometryKeys(port, countKey, lenKey);
+
+  Preferences prefs;
+  prefs.begin("audio", false);
+  prefs.putUShort(countKey, g.count);
+  prefs.putUShort(lenKey, g.len);
+  prefs.end();
+}
+
+static bool install(i2s_port_t port, I2sGeometry geometry)
+{
+  PortState &p = ports[port];
+  i2s_config_t config = p.config;
+  config.dma_buf_count = geometry.count;
+  config.dma_buf_len = geometry.len;
+
+  QueueHandle_t events = NULL;
+  esp_err_t result = i2s_driver_install(port, &config, I2S_EVENT_QUEUE_LEN, &events);
+  if (result != ESP_OK)
+  {
+    Serial.printf("ERROR: Failed to install I2S driver %d: %s\n", port, esp_err_to_name(result));
+    return false;
+  }
+  result = i2s_set_pin(port, &p.pins);
+  if (result != ESP_OK)
+  {
+    Serial.printf("ERROR: Failed to set I2S pins %d: %s\n", port, esp_err_to_name(result));
+    i2s_driver_uninstall(port);
+    return false;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  p.events = events;
+  p.geometry = geometry;
+  p.installed = true;
+  xSemaphoreGive(lock);
+  return true;
+}
+
+static void uninstall(i2s_port_t port)
+{
+  PortState &p = ports[port];
+  xSemaphoreTake(lock, portMAX_DELAY);
+  p.events = NULL; // Deleted with the driver
+  p.installed = false;
+  xSemaphoreGive(lock);
+  i2s_driver_uninstall(port);
+}
+
+bool i2sAudioInstall(i2s_port_t port, const i2s_config_t &config, const i2s_pin_config_t &pins)
+{
+  if (!lock)
+  {
+    lock = xSemaphoreCreateMutex();
+    xTaskCreate(eventTask, "i2sevents", 2048, NULL, 2, NULL);
+  }
+
+  PortState &p = ports[port];
+  p.config = config;
+  p.pins = pins;
+  return install(port, loadGeometry(port, config));
+}
+
+I2sGeometry i2sAudioGeometry(i2s_port_t port)
+{
+  return ports[port].geometry;
+}
+
+void i2sAudioWatch(i2s_port_t port, bool on)
+{
+  PortState &p = ports[port];
+  if (!p.installed || p.watched == on)
+  {
+    return;
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  if (on)
+  {
+    xQueueReset(p.events); // Whatever happened before does not count
+    p.watchDrops = p.drops;
+  }
+  else
+  {
+    drain(p); // Up to now, without waiting for the task
+  }
+  p.watched = on;
+  xSemaphoreGive(lock);
+
+  uint32_t drops = p.drops - p.watchDrops;
+  if (!on && drops)
+  {
+    Serial.printf("WARNING: %lu I2S %s\n", drops,
+                  isMic(p) ? "mic overflows, audio was lost" : "speaker underruns, gaps were played");
+  }
+}
+
+I2sCounters i2sAudioCounters(i2s_port_t port)
+{
+  const PortState &p = ports[port];
+  I2sCounters counters = {p.buffers, p.drops, p.dmaErrors};
+  return counters;
+}
+
+void i2sAudioReport()
+{
+  Serial.println("\n=== I2S audio ===");
+  for (int i = 0; i < I2S_NUM_MAX; i++)
+  {
+    const PortState &p = ports[i];
+    if (!p.installed)
+    {
+      continue;
+    }
+    bool mic = isMic(p);
+    uint32_t ringMs = (uint32_t)p.geometry.count * p.geometry.len * 1000 / p.config.sample_rate;
+    Serial.printf("%-7s DMA %u x %u samples (%lu ms), %lu buffers, %lu %s, %lu DMA errors\n", mic ? "Mic" : "Speaker",
+                  p.geometry.count, p.geometry.len, ringMs, p.buffers, p.drops, mic ? "overflows" : "underruns",
+                  p.dmaErrors);
+  }
+}
+
+// The recording loop's work per chunk: an SD write, then a network wait
+static void syntheticLoad(File &file, const int16_t *chunk, int n)
+{
+  if (file)
+  {
+    file.write((const uint8_t *)chunk, I2S_CAL_CHUNK * sizeof(int16_t));
+  }
+  loadSeed = loadSeed * 1664525 + 1013904223;
+  uint32_t wait = (loadSeed >> 16) % (I2S_CAL_STALL_MAX_MS + 1);
+  if (n % I2S_CAL_SPIKE_EVERY == I2S_CAL_SPIKE_EVERY - 1)
+  {
+    wait += I2S_CAL_SPIKE_MS;
+  }
+  delay(wait);
+}
+
+// Run the load on one port, true if it did not drop anything
+static bool trial(i2s_port_t port, File &file)
+{
+  static int16_t chunk[I2S_CAL_CHUNK];
+  PortState &p = ports[port];
+  bool mic = isMic(p);
+  size_t done = 0;
+
+  if (!mic)
+  {
+    // Quiet tone, and a full ring before counting
+    for (int i = 0; i < I2S_CAL_CHUNK; i++)
+    {
+      chunk[i] = sineTable1k[i % 16] / 8;
+    }
+    for (uint32_t queued = 0; queued < (uint32_t)p.geometry.count * p.geometry.len; queued += I2S_CAL_CHUNK)
+    {
+      i2s_write(port, chunk, sizeof(chunk), &done, portMAX_DELAY);
+    }
+  }
+
+  loadSeed = 1;
+  i2sAudioWatch(port, true);
+  uint32_t start = millis();
+  for (int n = 0; millis() - start < I2S_CAL_TRIAL_MS && p.drops == p.watchDrops; n++)
+  {
+    if (mic)
+    {
+      i2s_read(port, chunk, sizeof(chunk), &done, portMAX_DELAY);
+    }
+    else
+    {
+      i2s_write(port, chunk, sizeof(chunk), &done, portMAX_DELAY);
+    }
+    syntheticLoad(file, chunk, n);
+  }
+
+  xSemaphoreTake(lock, portMAX_DELAY);
+  drain(p);
+  p.watched = false;
+  xSemaphoreGive(lock);
+  if (!mic)
+  {
+    i2s_zero_dma_buffer(port);
+  }
+  return p.drops == p.watchDrops;
+}
+
+bool i2sAudioCalibrate()
+{
+  // Candidates by ring size, fewer interrupts first on a tie
+  I2sGeometry candidates[sizeof(calCounts) / sizeof(calCounts[0]) * sizeof(calLens) / sizeof(calLens[0])];
+  int candidateCount = 0;
+  for (uint16_t count : calCounts)
+  {
+    for (uint16_t len : calLens)
+    {
+      if ((uint32_t)count * len > I2S_CAL_MAX_SAMPLES)
+      {
+        continue;
+      }
+      I2sGeometry g = {count, len};
+      int i = candidateCount++;
+      for (; i > 0; i--)
+      {
+        const I2sGeometry &prev = candidates[i - 1];
+        uint32_t prevSize = (uint32_t)prev.count * prev.len, size = (uint32_t)count * len;
+        if (prevSize < size || (prevSize == size && prev.len > len))
+        {
+          break;
+        }
+        candidates[i] = prev;
+      }
+      candidates[i] = g;
+    }
+  }
+
+  File file = SD.open(CAL_FILE, FILE_WRITE);
+  if (!file)
+  {
+    Serial.println("WARNING: No SD card, calibrating without the SD part of the load");
+  }
+  Serial.printf("Calibrating I2S DMA: %d geometries, load %d+%d ms stalls\n", candidateCount,
+                I2S_CAL_STALL_MAX_MS, I2S_CAL_SPIKE_MS);
+
+  I2sGeometry best[I2S_NUM_MAX];
+  bool found[I2S_NUM_MAX] = {};
+  int remaining = 0;
+  for (int port = 0; port < I2S_NUM_MAX; port++)
+  {
+    remaining += ports[port].installed;
+  }
+
+  for (int c = 0; c < candidateCount && remaining > 0; c++)
+  {
+    const I2sGeometry &g = candidates[c];
+    for (int port = 0; port < I2S_NUM_MAX; port++)
+    {
+      PortState &p = ports[port];
+      if (!p.installed || found[port])
+      {
+        continue;
+      }
+      uninstall((i2s_port_t)port);
+      if (!install((i2s_port_t)port, g))
+      {
+        install((i2s_port_t)port, p.geometry); // Put the last good one back
+        continue;
+      }
+
+      bool clean = trial((i2s_port_t)port, file);
+      Serial.printf("  %-7s %2u x %4u (%3lu ms): %s\n", isMic(p) ? "mic" : "speaker", g.count, g.len,
+                    (uint32_t)g.count * g.len * 1000 / p.config.sample_rate, clean ? "no drops" : "dropped");
+      if (clean)
+      {
+        best[port] = g;
+        found[port] = true;
+        remaining--;
+      }
+    }
+  }
+
+  if (file)
+  {
+    file.close();
+    SD.remove(CAL_FILE);
+  }
+
+  bool ok = true;
+  for (int port = 0; port < I2S_NUM_MAX; port++)
+  {
+    PortState &p = ports[port];
+    if (!p.installed)
+    {
+      continue;
+    }
+    if (!found[port])
+    {
+      Serial.printf("Calibration: nothing up to %d samples kept the %s clean, keeping the old setting\n",
+                    I2S_CAL_MAX_SAMPLES, isMic(p) ? "mic" : "speaker");
+      best[port] = loadGeometry((i2s_port_t)port, p.config);
+      ok = false;
+    }
+    else
+    {
+      saveGeometry((i2s_port_t)port, best[port]);
+    }
+    uninstall((i2s_port_t)port);
+    install((i2s_port_t)port, best[port]);
+  }
+  i2sAudioReport();
+  return ok;
+}
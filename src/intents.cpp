@@ -0,0 +1,390 @@
+#include <Arduino.h>
+#include "intents.h"
+
+// Word ids are FNV-1a hashes of the lowercased word, SLOT_NUMBER marks a slot edge
+#define SLOT_NUMBER 0xFFFFFFFFu
+#define NO_INDEX 0xFFFF
+#define MAX_PATTERN_WORDS 12
+#define NUMBER_BAD -2 // Number words that do not read as one number
+
+struct IntentEdge
+{
+  uint32_t word;
+  uint16_t child;
+  uint16_t next; // Next sibling edge of the same node
+};
+
+struct IntentNode
+{
+  uint16_t firstEdge;
+  uint8_t intent; // IntentId accepted here, INTENT_NONE if not a final node
+};
+
+enum NumberKind : uint8_t
+{
+  NUM_NONE = 0,
+  NUM_DIGITS,
+  NUM_UNIT, // zero .. nineteen
+  NUM_TENS, // twenty .. ninety
+  NUM_HUNDRED
+};
+
+struct Token
+{
+  uint32_t word;
+  int32_t number; // -1 if the word is not a number, NUMBER_BAD for a bad run
+  NumberKind kind;
+};
+
+static IntentNode nodes[INTENT_MAX_NODES];
+static IntentEdge edges[INTENT_MAX_EDGES];
+static uint16_t nodeCount = 0;
+static uint16_t edgeCount = 0;
+
+static uint32_t hashWord(const char *word, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    h ^= (uint8_t)tolower(word[i]);
+    h *= 16777619u;
+  }
+  return h == SLOT_NUMBER ? h - 1 : h;
+}
+
+static const char *const numberWords[] = {
+    "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten",
+    "eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen", "seventeen", "eighteen", "nineteen"};
+static const char *const tensWords[] = {"twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety"};
+
+static int32_t parseNumber(const char *word, size_t len, NumberKind &kind)
+{
+  kind = NUM_NONE;
+  if (isdigit((uint8_t)word[0]))
+  {
+    int32_t value = 0;
+    for (size_t i = 0; i < len && isdigit((uint8_t)word[i]); i++)
+    {
+      value = value * 10 + (word[i] - '0');
+    }
+    kind = NUM_DIGITS;
+    return value;
+  }
+
+  for (size_t i = 0; i < sizeof(numberWords) / sizeof(numberWords[0]); i++)
+  {
+    if (strlen(numberWords[i]) == len && strncasecmp(word, numberWords[i], len) == 0)
+    {
+      kind = NUM_UNIT;
+      return i;
+    }
+  }
+  for (size_t i = 0; i < sizeof(tensWords) / sizeof(tensWords[0]); i++)
+  {
+    if (strlen(tensWords[i]) == len && strncasecmp(word, tensWords[i], len) == 0)
+    {
+      kind = NUM_TENS;
+      return (i + 2) * 10;
+    }
+  }
+  if (len == 7 && strncasecmp(word, "hundred", 7) == 0)
+  {
+    kind = NUM_HUNDRED;
+    return 100;
+  }
+  return -1;
+}
+
+// Value of the number words tokens[0..count), "and" tokens skipped, or
+// NUMBER_BAD: [digits | unit | tens [unit]] [hundred [tens] [unit]]
+static int32_t runValue(const Token *tokens, size_t count)
+{
+  int32_t hundreds = -1, part = -1;
+  NumberKind last = NUM_NONE;
+  for (size_t i = 0; i < count; i++)
+  {
+    const Token &t = tokens[i];
+    bool ok = true;
+    switch (t.kind)
+    {
+    case NUM_DIGITS:
+      ok = last == NUM_NONE;
+      part = t.number;
+      break;
+    case NUM_TENS:
+      ok = part < 0;
+      part = t.number;
+      break;
+    case NUM_UNIT:
+      ok = part < 0 || (last == NUM_TENS && t.number > 0 && t.number < 10);
+      part = max(part, (int32_t)0) + t.number;
+      break;
+    case NUM_HUNDRED:
+      ok = hundreds < 0; // A bare "hundred" counts one
+      hundreds = (part < 0 ? 1 : part) * 100;
+      part = -1;
+      break;
+    default:
+      continue; // "and"
+    }
+    if (!ok)
+      return NUMBER_BAD;
+    last = t.kind;
+  }
+  return max(hundreds, (int32_t)0) + max(part, (int32_t)0);
+}
+
+// Merge each run of number words into its first token, so "twenty five",
+// "seventy-five" and "one hundred and five" fill a slot as one number
+static size_t mergeNumbers(Token *tokens, size_t count)
+{
+  static const uint32_t andWord = hashWord("and", 3);
+  size_t out = 0;
+  for (size_t i = 0; i < count;)
+  {
+    size_t end = i + 1;
+    if (tokens[i].kind != NUM_NONE)
+    {
+      while (end < count && (tokens[end].kind != NUM_NONE ||
+                             (tokens[end].word == andWord && tokens[end - 1].kind == NUM_HUNDRED && end + 1 < count &&
+                              tokens[end + 1].kind != NUM_NONE)))
+        end++;
+    }
+    tokens[out] = tokens[i];
+    if (end - i > 1)
+      tokens[out].number = runValue(tokens + i, end - i);
+    out++;
+    i = end;
+  }
+  return out;
+}
+
+// Split on anything that is not a letter or digit. Apostrophes are dropped
+// so "what's" and "whats" match the same, "%" becomes the word "percent".
+// Runs of number words are merged afterwards.
+static size_t tokenize(const char *text, Token *tokens, size_t maxTokens)
+{
+  static const uint32_t percentWord = hashWord("percent", 7);
+  char word[24];
+  size_t len = 0;
+  size_t count = 0;
+
+  for (const char *p = text;; p++)
+  {
+    char c = *p;
+    if (isalnum((uint8_t)c))
+    {
+      if (len < sizeof(word))
+        word[len++] = c;
+      continue;
+    }
+    if (c == '\'')
+    {
+      continue;
+    }
+
+    if (len > 0)
+    {
+      if (count >= maxTokens)
+        return count + 1; // Signal "too long"
+      tokens[count].word = hashWord(word, len);
+      tokens[count].number = parseNumber(word, len, tokens[count].kind);
+      count++;
+      len = 0;
+    }
+    if (c == '%' && count < maxTokens)
+    {
+      tokens[count].word = percentWord;
+      tokens[count].number = -1;
+      tokens[count].kind = NUM_NONE;
+      count++;
+    }
+    if (c == '\0')
+      break;
+  }
+  return mergeNumbers(tokens, count);
+}
+
+static uint16_t newNode()
+{
+  if (nodeCount >= INTENT_MAX_NODES)
+    return NO_INDEX;
+  nodes[nodeCount].firstEdge = NO_INDEX;
+  nodes[nodeCount].intent = INTENT_NONE;
+  return nodeCount++;
+}
+
+static uint16_t childFor(uint16_t node, uint32_t word)
+{
+  for (uint16_t e = nodes[node].firstEdge; e != NO_INDEX; e = edges[e].next)
+  {
+    if (edges[e].word == word)
+      return edges[e].child;
+  }
+
+  if (edgeCount >= INTENT_MAX_EDGES)
+    return NO_INDEX;
+  uint16_t child = newNode();
+  if (child == NO_INDEX)
+    return NO_INDEX;
+
+  IntentEdge &edge = edges[edgeCount];
+  edge.word = word;
+  edge.child = child;
+  edge.next = nodes[node].firstEdge;
+  nodes[node].firstEdge = edgeCount++;
+  return child;
+}
+
+// Insert every expansion of the optional words below node
+static bool insertPattern(uint16_t node, const uint32_t *words, const bool *optional, size_t count, IntentId intent)
+{
+  if (count == 0)
+  {
+    nodes[node].intent = intent;
+    return true;
+  }
+  if (optional[0] && !insertPattern(node, words + 1, optional + 1, count - 1, intent))
+    return false;
+
+  uint16_t child = childFor(node, words[0]);
+  if (child == NO_INDEX)
+    return false;
+  return insertPattern(child, words + 1, optional + 1, count - 1, intent);
+}
+
+bool intentCompile(const IntentRule *rules, size_t count)
+{
+  nodeCount = 0;
+  edgeCount = 0;
+  newNode(); // Root
+
+  for (size_t r = 0; r < count; r++)
+  {
+    uint32_t words[MAX_PATTERN_WORDS];
+    bool optional[MAX_PATTERN_WORDS];
+    size_t n = 0;
+    const char *p = rules[r].pattern;
+
+    while (*p)
+    {
+      while (*p == ' ')
+        p++;
+      if (!*p)
+        break;
+      if (n >= MAX_PATTERN_WORDS)
+        return false;
+
+      const char *start = p;
+      while (*p && *p != ' ')
+        p++;
+      size_t len = p - start;
+
+      optional[n] = (start[0] == '[' && start[len - 1] == ']');
+      if (optional[n])
+      {
+        start++;
+        len -= 2;
+      }
+      if (len == 3 && strncmp(start, "{n}", 3) == 0)
+        words[n] = SLOT_NUMBER;
+      else
+        words[n] = hashWord(start, len);
+      n++;
+    }
+
+    if (!insertPattern(0, words, optional, n, rules[r].intent))
+    {
+      Serial.printf("Intent grammar too large at rule %u: %s\n", (unsigned)r, rules[r].pattern);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Walk the trie from tokens[pos], keep the longest accepted match
+static void walk(uint16_t node, const Token *tokens, size_t pos, size_t count, int32_t slot,
+                 IntentMatch &best, uint8_t start)
+{
+  if (nodes[node].intent != INTENT_NONE && pos - start > (size_t)(best.end - best.start))
+  {
+    best.intent = (IntentId)nodes[node].intent;
+    best.slot = slot;
+    best.start = start;
+    best.end = pos;
+  }
+  if (pos >= count)
+    return;
+
+  for (uint16_t e = nodes[node].firstEdge; e != NO_INDEX; e = edges[e].next)
+  {
+    if (edges[e].word == tokens[pos].word)
+      walk(edges[e].child, tokens, pos + 1, count, slot, best, start);
+    else if (edges[e].word == SLOT_NUMBER && tokens[pos].number >= 0)
+      walk(edges[e].child, tokens, pos + 1, count, tokens[pos].number, best, start);
+  }
+}
+
+bool intentMatch(const char *transcript, IntentMatch &match)
+{
+  match.intent = INTENT_NONE;
+  match.slot = -1;
+  match.start = 0;
+  match.end = 0;
+
+  if (nodeCount == 0)
+    return false;
+
+  Token tokens[INTENT_MAX_WORDS];
+  size_t count = tokenize(transcript, tokens, INTENT_MAX_WORDS);
+  if (count == 0 || count > INTENT_MAX_WORDS)
+    return false;
+
+  // "Don't turn on the light" is not a command
+  static const uint32_t blockers[] = {hashWord("dont", 4), hashWord("not", 3), hashWord("never", 5)};
+  for (size_t i = 0; i < count; i++)
+  {
+    for (uint32_t blocker : blockers)
+    {
+      if (tokens[i].word == blocker)
+        return false;
+    }
+  }
+
+  for (size_t start = 0; start < count; start++)
+  {
+    walk(0, tokens, start, count, -1, match, start);
+  }
+
+  // A command buried in a longer sentence is probably a question about it
+  if (match.intent != INTENT_NONE && count - (match.end - match.start) > INTENT_MAX_EXTRA_WORDS)
+  {
+    match.intent = INTENT_NONE;
+  }
+  return match.intent != INTENT_NONE;
+}
+
+const char *intentName(IntentId intent)
+{
+  switch (intent)
+  {
+  case INTENT_LIGHT_ON:
+    return "LIGHT_ON";
+  case INTENT_LIGHT_OFF:
+    return "LIGHT_OFF";
+  case INTENT_LIGHT_DIM:
+    return "LIGHT_DIM";
+  case INTENT_VOLUME_UP:
+    return "VOLUME_UP";
+  case INTENT_VOLUME_DOWN:
+    return "VOLUME_DOWN";
+  case INTENT_VOLUME_SET:
+    return "VOLUME_SET";
+  case INTENT_REPEAT:
+    return "REPEAT";
+  case INTENT_STOP_LISTENING:
+    return "STOP_LISTENING";
+  default:
+    return "NONE";
+  }
+}
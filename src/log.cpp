@@ -0,0 +1,187 @@
+#include "log.h"
+#include <SD.h>
+#include <atomic>
+
+struct LogRecord
+{
+  std::atomic<uint32_t> seq; // Ring position this slot is ready for, see logPush
+  const char *fmt;
+  uint32_t timeUs;
+  uint8_t level;
+  uint8_t argc;
+  uint32_t args[LOG_MAX_ARGS];
+};
+
+// Bounded multi-producer ring (Vyukov): producers claim a position with a
+// CAS on head, the single drain task owns tail. A slot is free for
+// position p when seq == p and holds a record when seq == p + 1.
+static LogRecord ring[LOG_RING_RECORDS];
+static std::atomic<uint32_t> head(0);
+static uint32_t tail = 0;
+static std::atomic<uint32_t> dropped(0);
+
+// The file is only touched by the drain task, logSdSink() just asks
+static volatile bool sdSink = false;
+static File sdFile;
+
+static const char levelChar[] = {'-', 'E', 'W', 'I', 'D'};
+
+void logPush(uint8_t level, const char *fmt, const uint32_t *args, uint8_t argc)
+{
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  LogRecord *r;
+  while (true)
+  {
+    r = &ring[pos & (LOG_RING_RECORDS - 1)];
+    int32_t diff = (int32_t)(r->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0)
+    {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed); // Full, never block the caller
+      return;
+    }
+    else
+    {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  r->fmt = fmt;
+  r->timeUs = micros();
+  r->level = level;
+  r->argc = argc;
+  memcpy(r->args, args, argc * sizeof(uint32_t));
+  r->seq.store(pos + 1, std::memory_order_release);
+}
+
+static void writeLine(const char *line, size_t len)
+{
+  Serial.write((const uint8_t *)line, len);
+  if (sdFile)
+  {
+    sdFile.write((const uint8_t *)line, len);
+  }
+}
+
+// Format and write everything queued, returns the records drained
+static int logDrain()
+{
+  char line[160];
+  int count = 0;
+
+  while (true)
+  {
+    LogRecord &r = ring[tail & (LOG_RING_RECORDS - 1)];
+    if (r.seq.load(std::memory_order_acquire) != tail + 1)
+      break;
+
+    // Unused argument slots are passed too, harmless for 32-bit varargs
+    int n = snprintf(line, sizeof(line), "[%8lu][%c] ", r.timeUs / 1000, levelChar[r.level]);
+    n += snprintf(line + n, sizeof(line) - n - 1, r.fmt, r.args[0], r.args[1], r.args[2], r.args[3]);
+    n = min(n, (int)sizeof(line) - 2);
+    line[n++] = '\n';
+
+    r.seq.store(tail + LOG_RING_RECORDS, std::memory_order_release);
+    tail++;
+    writeLine(line, n);
+    count++;
+  }
+
+  uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+  if (lost)
+  {
+    int n = snprintf(line, sizeof(line), "[log] %lu records dropped, ring full\n", lost);
+    writeLine(line, n);
+  }
+  return count;
+}
+
+static void logTask(void *param)
+{
+  uint32_t lastFlush = millis();
+  while (true)
+  {
+    if (sdSink && !sdFile)
+    {
+      sdFile = SD.open(LOG_SD_PATH, FILE_APPEND);
+      if (!sdFile)
+      {
+        Serial.println("Cannot open " LOG_SD_PATH);
+        sdSink = false;
+      }
+    }
+    else if (!sdSink && sdFile)
+    {
+      sdFile.close();
+    }
+
+    if (logDrain() == 0)
+    {
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+    if (sdFile && millis() - lastFlush > 1000)
+    {
+      sdFile.flush();
+      lastFlush = millis();
+    }
+  }
+}
+
+void logBegin()
+{
+  for (uint32_t i = 0; i < LOG_RING_RECORDS; i++)
+  {
+    ring[i].seq.store(i, std::memory_order_relaxed);
+  }
+  xTaskCreate(logTask, "log", 4096, NULL, 1, NULL);
+}
+
+void logSdSink(bool enable)
+{
+  sdSink = enable;
+}
+
+bool logSdSinkEnabled()
+{
+  return sdSink;
+}
+
+void logBenchmark(int iterations)
+{
+  uint32_t deferred = 0;
+  for (int done = 0; done < iterations;)
+  {
+    int batch = min(iterations - done, LOG_RING_RECORDS / 2);
+    uint32_t start = micros();
+    for (int i = 0; i < batch; i++)
+    {
+      LOG_I("bench %d of %d", done + i, iterations);
+    }
+    deferred += micros() - start;
+    done += batch;
+    delay(50); // Let the drain task empty the ring so nothing is dropped
+  }
+
+  uint32_t t0 = micros();
+  for (int i = 0; i < iterations; i++)
+  {
+    LOG_D("bench %d of %d", i, iterations);
+  }
+  uint32_t disabled = micros() - t0;
+
+  t0 = micros();
+  for (int i = 0; i < iterations; i++)
+  {
+    Serial.printf("bench %d of %d\n", i, iterations);
+  }
+  uint32_t direct = micros() - t0;
+
+  Serial.printf("Log call cost over %d calls: deferred %.2f us, Serial.printf %.2f us, %s %.2f us\n",
+                iterations, (float)deferred / iterations, (float)direct / iterations,
+                LOG_ENABLED(LOG_LEVEL_DEBUG) ? "debug (enabled)" : "debug (compiled out)",
+                (float)disabled / iterations);
+}
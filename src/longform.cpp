@@ -0,0 +1,458 @@
+#include "longform.h"
+#include "turn_scheduler.h"
+#include "wifi_manager.h"
+#include <SD.h>
+
+#define OVERLAP_SAMPLES (LF_SAMPLE_RATE * LF_OVERLAP_MS / 1000)
+#define WAV_HEADER_BYTES 44
+#define PATH_MAX_LEN 40
+#define TAIL_MAX 160
+
+enum SlotState
+{
+  SLOT_FREE = 0,
+  SLOT_UPLOADING,
+  SLOT_WAITING, // Failed, tried again once Wi-Fi is up
+  SLOT_DONE     // Waiting for the segments before it to be written
+};
+
+// One segment from upload to the document
+struct Slot
+{
+  SlotState state;
+  int index;
+  int attempts;
+  HedgeRace *race;
+  bool ok;
+  String transcript;
+};
+
+// Owned by the upload task's race
+struct SegmentUpload
+{
+  char path[PATH_MAX_LEN];
+  String transcript;
+  WiFiClientSecure tcp;
+};
+
+static LongFormTranscribe transcribeFn = NULL;
+static LongFormFinish finishFn = NULL;
+
+static bool recording = false;
+static uint32_t session = 0; // millis() at the start, names the files
+static uint32_t stoppedAt = 0;
+static File segment;
+static uint32_t segmentSamples = 0; // Including the overlap at its start
+static uint32_t overlapSamples = 0; // Overlap at the start of this segment
+static int segments = 0;            // Closed, ready to upload
+static int nextUpload = 0;
+static int nextWrite = 0;
+
+static uint32_t noiseFloor = 0;
+static uint32_t quietMs = 0;
+static int16_t overlap[OVERLAP_SAMPLES];
+static size_t overlapHead = 0; // Next write position
+static bool overlapFull = false;
+
+static Slot slots[LF_IN_FLIGHT];
+static char tail[TAIL_MAX]; // Last words written, for the seam check
+static uint32_t words = 0;
+static int failures = 0;
+
+static void segmentPath(int index, char *path)
+{
+  snprintf(path, PATH_MAX_LEN, "/long_%lu_%03d.wav", session, index);
+}
+
+static void documentPath(char *path)
+{
+  snprintf(path, PATH_MAX_LEN, "/long_%lu.txt", session);
+}
+
+static void overlapPush(const int16_t *samples, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    overlap[overlapHead++] = samples[i];
+    if (overlapHead == OVERLAP_SAMPLES)
+    {
+      overlapHead = 0;
+      overlapFull = true;
+    }
+  }
+}
+
+static bool openSegment()
+{
+  char path[PATH_MAX_LEN];
+  segmentPath(segments, path);
+  segment = SD.open(path, FILE_WRITE);
+  if (!segment)
+  {
+    return false;
+  }
+
+  // Header space, filled in by finishFn
+  uint8_t header[WAV_HEADER_BYTES] = {};
+  segment.write(header, sizeof(header));
+
+  // The end of the previous segment, oldest first
+  segmentSamples = 0;
+  if (overlapFull)
+  {
+    segment.write((const uint8_t *)(overlap + overlapHead), (OVERLAP_SAMPLES - overlapHead) * sizeof(int16_t));
+    segmentSamples += OVERLAP_SAMPLES - overlapHead;
+  }
+  segment.write((const uint8_t *)overlap, overlapHead * sizeof(int16_t));
+  segmentSamples += overlapHead;
+  overlapSamples = segmentSamples;
+  quietMs = 0;
+  return true;
+}
+
+static void closeSegment()
+{
+  finishFn(segment, segmentSamples * sizeof(int16_t));
+  segment.close();
+  segments++;
+}
+
+// Words as pointers to their first character, at most max
+static int splitWords(const char *text, const char **starts, int max)
+{
+  int n = 0;
+  while (n < max)
+  {
+    while (isspace((uint8_t)*text))
+      text++;
+    if (!*text)
+      break;
+    starts[n++] = text;
+    while (*text && !isspace((uint8_t)*text))
+      text++;
+  }
+  return n;
+}
+
+// Same word, ignoring case and punctuation
+static bool sameWord(const char *a, const char *b)
+{
+  while (true)
+  {
+    while (*a && !isspace((uint8_t)*a) && !isalnum((uint8_t)*a))
+      a++;
+    while (*b && !isspace((uint8_t)*b) && !isalnum((uint8_t)*b))
+      b++;
+    bool endA = !*a || isspace((uint8_t)*a);
+    bool endB = !*b || isspace((uint8_t)*b);
+    if (endA || endB)
+    {
+      return endA && endB;
+    }
+    if (tolower((uint8_t)*a++) != tolower((uint8_t)*b++))
+    {
+      return false;
+    }
+  }
+}
+
+// Words at the start of text that repeat the end of the document
+static int seamWords(const char *text)
+{
+  const char *tailWords[LF_DEDUP_WORDS], *headWords[LF_DEDUP_WORDS];
+  int nt = splitWords(tail, tailWords, LF_DEDUP_WORDS);
+  int nh = splitWords(text, headWords, LF_DEDUP_WORDS);
+  for (int k = min(nt, nh); k > 0; k--)
+  {
+    int j = 0;
+    while (j < k && sameWord(tailWords[nt - k + j], headWords[j]))
+      j++;
+    if (j == k)
+    {
+      return k;
+    }
+  }
+  return 0;
+}
+
+static const char *skipWords(const char *text, int n)
+{
+  for (; n > 0; n--)
+  {
+    while (isspace((uint8_t)*text))
+      text++;
+    while (*text && !isspace((uint8_t)*text))
+      text++;
+  }
+  while (isspace((uint8_t)*text))
+    text++;
+  return text;
+}
+
+// Start of the last n words of text
+static const char *lastWords(const char *text, int n)
+{
+  const char *p = text + strlen(text);
+  while (n > 0 && p > text)
+  {
+    while (p > text && isspace((uint8_t)p[-1]))
+      p--;
+    while (p > text && !isspace((uint8_t)p[-1]))
+      p--;
+    n--;
+  }
+  return p;
+}
+
+static void writeSegment(const Slot &slot)
+{
+  char path[PATH_MAX_LEN];
+  documentPath(path);
+  File doc = SD.open(path, FILE_APPEND);
+
+  char audioPath[PATH_MAX_LEN];
+  segmentPath(slot.index, audioPath);
+  if (!slot.ok)
+  {
+    Serial.printf("Long-form segment %d: not transcribed, audio kept in %s\n", slot.index, audioPath);
+    doc.printf("[segment %d not transcribed, audio in %s]\n", slot.index, audioPath);
+    tail[0] = '\0';
+    failures++;
+    doc.close();
+    return;
+  }
+
+  int seam = seamWords(slot.transcript.c_str());
+  const char *text = skipWords(slot.transcript.c_str(), seam);
+  if (*text)
+  {
+    doc.print(text);
+    doc.print('\n');
+    strlcpy(tail, lastWords(text, LF_DEDUP_WORDS), sizeof(tail));
+  }
+  doc.close();
+  SD.remove(audioPath);
+
+  int n = 0;
+  for (const char *p = text; *p; p = skipWords(p, 1))
+    n++;
+  words += n;
+  Serial.printf("Long-form segment %d: %d words%s\n", slot.index, n, seam ? ", seam repeat dropped" : "");
+}
+
+static bool uploadRequest(void *ctx, uint32_t deadline)
+{
+  SegmentUpload *upload = (SegmentUpload *)ctx;
+  return transcribeFn(upload->tcp, upload->path, upload->transcript, deadline);
+}
+
+static void uploadRelease(void *ctx)
+{
+  delete (SegmentUpload *)ctx;
+}
+
+static void uploadFailed(Slot &slot)
+{
+  slot.state = slot.attempts > LF_RETRIES ? SLOT_DONE : SLOT_WAITING;
+  slot.ok = false;
+}
+
+static void upload(Slot &slot)
+{
+  SegmentUpload *u = new SegmentUpload;
+  segmentPath(slot.index, u->path);
+  slot.attempts++;
+  slot.race = backgroundStart(uploadRequest, u, uploadRelease, millis() + LF_UPLOAD_TIMEOUT_MS);
+  if (slot.race)
+  {
+    slot.state = SLOT_UPLOADING;
+  }
+  else
+  {
+    uploadFailed(slot);
+  }
+}
+
+bool longFormStart(LongFormTranscribe transcribe, LongFormFinish finish)
+{
+  if (longFormBusy())
+  {
+    Serial.println("Long-form: the last session is still being transcribed");
+    return false;
+  }
+
+  transcribeFn = transcribe;
+  finishFn = finish;
+  session = millis();
+  segments = nextUpload = nextWrite = 0;
+  words = 0;
+  failures = 0;
+  tail[0] = '\0';
+  noiseFloor = 0;
+  overlapHead = 0;
+  overlapFull = false;
+  if (!openSegment())
+  {
+    Serial.println("ERROR: Failed to create long-form segment file!");
+    return false;
+  }
+
+  recording = true;
+  char path[PATH_MAX_LEN];
+  documentPath(path);
+  Serial.printf("Long-form recording started, transcript goes to %s\n", path);
+  return true;
+}
+
+void longFormStop()
+{
+  if (!recording)
+  {
+    return;
+  }
+  recording = false;
+  stoppedAt = millis();
+
+  // Less than a pause of new audio is not worth a request
+  if (segmentSamples - overlapSamples > LF_SAMPLE_RATE * LF_SILENCE_MS / 1000)
+  {
+    closeSegment();
+  }
+  else
+  {
+    char path[PATH_MAX_LEN];
+    segmentPath(segments, path);
+    segment.close();
+    SD.remove(path);
+  }
+  Serial.printf("Long-form recording stopped, %d segments, %d still to transcribe\n", segments, segments - nextWrite);
+}
+
+bool longFormRecording()
+{
+  return recording;
+}
+
+bool longFormBusy()
+{
+  return recording || nextWrite < segments;
+}
+
+void longFormFeed(const int16_t *samples, size_t count)
+{
+  if (!recording)
+  {
+    return;
+  }
+
+  size_t bytes = count * sizeof(int16_t);
+  if (segment.write((const uint8_t *)samples, bytes) != bytes)
+  {
+    Serial.println("ERROR: Long-form SD write failed, recording stopped");
+    longFormStop();
+    return;
+  }
+  segmentSamples += count;
+  overlapPush(samples, count);
+
+  uint64_t sum = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += (int32_t)samples[i] * samples[i];
+  }
+  uint32_t rms = count ? sqrtf((float)(sum / count)) : 0;
+  if (rms > max((uint32_t)LF_MIN_SPEECH_RMS, noiseFloor * LF_NOISE_MULT))
+  {
+    quietMs = 0;
+  }
+  else
+  {
+    quietMs += count * 1000 / LF_SAMPLE_RATE;
+    noiseFloor = noiseFloor ? (noiseFloor * 15 + rms) / 16 : rms;
+  }
+
+  uint32_t segmentMs = segmentSamples * 1000 / LF_SAMPLE_RATE;
+  bool pause = segmentMs >= LF_SEGMENT_MIN_MS && quietMs >= LF_SILENCE_MS;
+  if (!pause && segmentMs < LF_SEGMENT_MAX_MS)
+  {
+    return;
+  }
+
+  Serial.printf("Long-form segment %d: %lu ms, cut at %s\n", segments, segmentMs, pause ? "a pause" : "the length limit");
+  closeSegment();
+  if (!openSegment())
+  {
+    Serial.println("ERROR: Failed to create long-form segment file, recording stopped");
+    recording = false;
+    stoppedAt = millis();
+  }
+}
+
+void longFormPoll()
+{
+  if (!longFormBusy())
+  {
+    return;
+  }
+
+  for (Slot &slot : slots)
+  {
+    if (slot.state == SLOT_UPLOADING && backgroundDone(slot.race))
+    {
+      SegmentUpload *u = (SegmentUpload *)backgroundWait(slot.race, millis());
+      if (u)
+      {
+        slot.transcript = u->transcript;
+        slot.ok = true;
+        slot.state = SLOT_DONE;
+      }
+      else
+      {
+        Serial.printf("Long-form segment %d: upload failed (attempt %d)\n", slot.index, slot.attempts);
+        uploadFailed(slot);
+      }
+      hedgeDone(slot.race);
+      slot.race = NULL;
+    }
+    if (slot.state == SLOT_WAITING && wifiConnected())
+    {
+      upload(slot);
+    }
+  }
+
+  // Into the document in segment order
+  bool wrote = true;
+  while (wrote)
+  {
+    wrote = false;
+    for (Slot &slot : slots)
+    {
+      if (slot.state == SLOT_DONE && slot.index == nextWrite)
+      {
+        writeSegment(slot);
+        slot.transcript = "";
+        slot.state = SLOT_FREE;
+        nextWrite++;
+        wrote = true;
+      }
+    }
+  }
+
+  for (Slot &slot : slots)
+  {
+    if (slot.state == SLOT_FREE && nextUpload < segments && wifiConnected())
+    {
+      slot.index = nextUpload++;
+      slot.attempts = 0;
+      upload(slot);
+    }
+  }
+
+  if (!longFormBusy())
+  {
+    char path[PATH_MAX_LEN];
+    documentPath(path);
+    Serial.printf("\n=== Long-form transcript: %d segments, %lu words, %d failed ===\n", segments, words, failures);
+    Serial.printf("Complete %lu ms after recording stopped: %s\n", millis() - stoppedAt, path);
+  }
+}
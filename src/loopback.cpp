@@ -0,0 +1,175 @@
+#include "loopback.h"
+
+const int16_t sineTable1k[16] = {0, 3061, 5657, 7391, 8000, 7391, 5657, 3061,
+                                 0, -3061, -5657, -7391, -8000, -7391, -5657, -3061};
+
+static int16_t mlsTable[LOOPBACK_MLS_LEN];
+static bool mlsReady = false;
+
+// Galois LFSR for x^10 + x^7 + 1, one full period as +/-amplitude samples
+static void buildMls()
+{
+  uint16_t state = 1;
+  for (int i = 0; i < LOOPBACK_MLS_LEN; i++)
+  {
+    mlsTable[i] = (state & 1) ? LOOPBACK_AMPLITUDE : -LOOPBACK_AMPLITUDE;
+    state = (state >> 1) ^ ((state & 1) ? 0x240 : 0);
+  }
+  mlsReady = true;
+}
+
+static int32_t correlate(const int16_t *capture, int lag)
+{
+  int32_t sum = 0;
+  for (int i = 0; i < LOOPBACK_MLS_LEN; i++)
+  {
+    sum += mlsTable[i] > 0 ? capture[lag + i] : -capture[lag + i];
+  }
+  return abs(sum); // Polarity depends on the speaker wiring
+}
+
+// Lag of the best match in samples, with parabolic interpolation between
+// neighbouring lags. ratio is the peak over the mean correlation.
+static float findDelay(const int16_t *capture, int lags, float &ratio)
+{
+  int32_t best = 0;
+  int bestLag = 0;
+  int64_t total = 0;
+
+  for (int lag = 0; lag < lags; lag++)
+  {
+    int32_t c = correlate(capture, lag);
+    total += c;
+    if (c > best)
+    {
+      best = c;
+      bestLag = lag;
+    }
+  }
+
+  int32_t mean = total / lags;
+  ratio = mean > 0 ? (float)best / mean : 0;
+
+  float frac = 0;
+  if (bestLag > 0 && bestLag < lags - 1)
+  {
+    float prev = correlate(capture, bestLag - 1);
+    float next = correlate(capture, bestLag + 1);
+    float denom = prev - 2.0f * best + next;
+    if (denom != 0)
+      frac = 0.5f * (prev - next) / denom;
+  }
+  return bestLag + frac;
+}
+
+static bool captureTrial(i2s_port_t speaker, i2s_port_t mic, int dmaBufLen, int16_t *capture, size_t samples)
+{
+  size_t n = 0;
+
+  // Drop stale mic data, then block on one fresh DMA buffer so the
+  // capture starts on a buffer boundary, right before the sequence is queued
+  while (i2s_read(mic, capture, dmaBufLen * sizeof(int16_t), &n, 0) == ESP_OK && n > 0)
+  {
+  }
+  i2s_read(mic, capture, dmaBufLen * sizeof(int16_t), &n, portMAX_DELAY);
+
+  // May block while the speaker DMA drains, the mic DMA keeps recording meanwhile
+  i2s_write(speaker, mlsTable, sizeof(mlsTable), &n, portMAX_DELAY);
+
+  size_t got = 0;
+  size_t want = samples * sizeof(int16_t);
+  while (got < want)
+  {
+    if (i2s_read(mic, (uint8_t *)capture + got, want - got, &n, pdMS_TO_TICKS(500)) != ESP_OK || n == 0)
+    {
+      break;
+    }
+    got += n;
+  }
+  i2s_zero_dma_buffer(speaker); // Or the TX DMA replays the tail of the sequence
+  return got == want;
+}
+
+bool loopbackMeasure(i2s_port_t speaker, i2s_port_t mic, uint32_t sampleRate, int dmaBufLen,
+                     LoopbackResult &result)
+{
+  if (!mlsReady)
+  {
+    buildMls();
+  }
+
+  int lags = LOOPBACK_MAX_LAG_MS * sampleRate / 1000;
+  size_t samples = lags + LOOPBACK_MLS_LEN;
+  int16_t *capture = (int16_t *)malloc(samples * sizeof(int16_t));
+  if (!capture)
+  {
+    Serial.println("Loopback: not enough memory for the capture");
+    return false;
+  }
+
+  float latency[LOOPBACK_TRIALS];
+  memset(&result, 0, sizeof(result));
+  result.peakRatio = 1e9;
+
+  for (int t = 0; t < LOOPBACK_TRIALS; t++)
+  {
+    if (!captureTrial(speaker, mic, dmaBufLen, capture, samples))
+    {
+      Serial.printf("Loopback trial %d: capture incomplete\n", t + 1);
+      continue;
+    }
+
+    for (size_t i = 0; i < samples; i++)
+    {
+      if (abs(capture[i]) >= LOOPBACK_CLIP_LEVEL)
+        result.clipped++;
+    }
+
+    uint32_t t0 = micros();
+    float ratio;
+    float lag = findDelay(capture, lags, ratio);
+    uint32_t correlateUs = micros() - t0;
+
+    if (ratio < LOOPBACK_MIN_PEAK_RATIO)
+    {
+      Serial.printf("Loopback trial %d: sequence not heard (peak ratio %.1f)\n", t + 1, ratio);
+      continue;
+    }
+    latency[result.trials++] = lag * 1000.0f / sampleRate;
+    result.peakRatio = min(result.peakRatio, ratio);
+    Serial.printf("Loopback trial %d: %.2f ms (peak ratio %.1f, correlation %lu us)\n", t + 1,
+                  latency[result.trials - 1], ratio, correlateUs);
+    delay(100);
+  }
+  free(capture);
+
+  if (result.trials == 0)
+  {
+    Serial.println("Loopback: no echo found, is the speaker near the mic and loud enough?");
+    return false;
+  }
+
+  float sum = 0;
+  result.minMs = latency[0];
+  result.maxMs = latency[0];
+  for (int i = 0; i < result.trials; i++)
+  {
+    sum += latency[i];
+    result.minMs = min(result.minMs, latency[i]);
+    result.maxMs = max(result.maxMs, latency[i]);
+  }
+  result.latencyMs = sum / result.trials;
+
+  float var = 0;
+  for (int i = 0; i < result.trials; i++)
+  {
+    var += (latency[i] - result.latencyMs) * (latency[i] - result.latencyMs);
+  }
+  result.jitterMs = sqrtf(var / result.trials);
+
+  Serial.printf("Loopback: %d/%d trials, round trip %.2f ms (min %.2f, max %.2f), jitter %.2f ms\n",
+                result.trials, LOOPBACK_TRIALS, result.latencyMs, result.minMs, result.maxMs, result.jitterMs);
+  Serial.printf("          worst peak ratio %.1f, %lu clipped samples%s\n", result.peakRatio,
+                (unsigned long)result.clipped, result.clipped ? " (mic overdriven, lower the volume)" : "");
+  return true;
+}
@@ -0,0 +1,124 @@
+#include "mem_telemetry.h"
+#include "log.h"
+#include <esp_heap_caps.h>
+
+struct MemPoint
+{
+  const char *name;
+  char task[16]; // Task that last sampled here, copied as tasks come and go
+  uint32_t count;
+  uint32_t freeLast;
+  uint32_t freeMin;
+  uint32_t largestMin;
+  uint32_t psramMin;
+  uint32_t stackMin; // Bytes of stack never used, lowest seen
+};
+
+static MemPoint points[MEM_POINTS];
+static int pointCount = 0;
+static portMUX_TYPE memLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t lastTrend = 0;
+
+// Long-lived tasks reported by name, the ones missing in a build are skipped
+static const char *const watchedTasks[] = {"loopTask", "log", "tiT", "wifi", "sys_evt", "IDLE"};
+
+#if MEM_TELEMETRY
+void memSample(const char *point)
+{
+  uint32_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  uint32_t psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  uint32_t stack = uxTaskGetStackHighWaterMark(NULL);
+  const char *task = pcTaskGetName(NULL);
+
+  portENTER_CRITICAL(&memLock);
+  MemPoint *p = NULL;
+  for (int i = 0; i < pointCount; i++)
+  {
+    if (points[i].name == point)
+    {
+      p = &points[i];
+      break;
+    }
+  }
+  if (!p && pointCount < MEM_POINTS)
+  {
+    p = &points[pointCount++];
+    *p = {point, "", 0, freeHeap, freeHeap, largest, psram, stack};
+  }
+  if (p)
+  {
+    strlcpy(p->task, task, sizeof(p->task));
+    p->count++;
+    p->freeLast = freeHeap;
+    p->freeMin = min(p->freeMin, freeHeap);
+    p->largestMin = min(p->largestMin, largest);
+    p->psramMin = min(p->psramMin, psram);
+    p->stackMin = min(p->stackMin, stack);
+  }
+  portEXIT_CRITICAL(&memLock);
+}
+#endif
+
+void memPoll()
+{
+  if (millis() - lastTrend < MEM_TREND_MS)
+  {
+    return;
+  }
+  lastTrend = millis();
+
+  uint32_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  LOG_I("mem: free %u, largest block %u, lowest ever %u, psram free %u", freeHeap, largest,
+        heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT), heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  if (largest < MEM_LOW_BLOCK)
+  {
+    LOG_W("mem: largest free block %u bytes, TLS connections may fail", largest);
+  }
+}
+
+void memReport()
+{
+  uint32_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  Serial.println("\n=== Memory ===");
+  Serial.printf("Heap: %lu of %u bytes free, lowest ever %u\n", freeHeap,
+                heap_caps_get_total_size(MALLOC_CAP_8BIT), heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+  Serial.printf("Largest free block: %lu bytes, fragmentation %lu%%\n", largest,
+                freeHeap ? 100 - largest * 100 / freeHeap : 0);
+  uint32_t psramTotal = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+  if (psramTotal)
+  {
+    Serial.printf("PSRAM: %u of %lu bytes free\n", heap_caps_get_free_size(MALLOC_CAP_SPIRAM), psramTotal);
+  }
+
+  // Copy out so the printing is not done under the lock
+  MemPoint snapshot[MEM_POINTS];
+  portENTER_CRITICAL(&memLock);
+  int count = pointCount;
+  memcpy(snapshot, points, count * sizeof(MemPoint));
+  portEXIT_CRITICAL(&memLock);
+
+  if (count)
+  {
+    Serial.println("Point              count   free last  free min  block min  psram min  stack min  task");
+    for (int i = 0; i < count; i++)
+    {
+      const MemPoint &p = snapshot[i];
+      Serial.printf("  %-16s %6lu  %9lu %9lu %10lu %10lu %10lu  %s\n", p.name, p.count, p.freeLast, p.freeMin,
+                    p.largestMin, p.psramMin, p.stackMin, p.task);
+    }
+  }
+
+  Serial.println("Task stack never used:");
+  for (const char *name : watchedTasks)
+  {
+    TaskHandle_t handle = xTaskGetHandle(name);
+    if (handle)
+    {
+      Serial.printf("  %-10s %6u bytes\n", name, uxTaskGetStackHighWaterMark(handle));
+    }
+  }
+  Serial.println("==============\n");
+}
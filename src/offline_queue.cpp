@@ -0,0 +1,225 @@
+#include "offline_queue.h"
+#include "turn_scheduler.h"
+#include <SD.h>
+
+static uint32_t nextSeq = 1;
+static int pending = 0;
+static uint32_t retryAt = 0;
+static uint32_t retryMs = 0; // 0 after a drain that finished its batch
+
+// Queue entries are "<seq>_<original name>", the fixed-width sequence
+// number makes name order the capture order
+static bool isJob(const char *name)
+{
+  return isdigit((uint8_t)name[0]) && strchr(name, '_') != NULL;
+}
+
+bool queueBegin()
+{
+  if (!SD.exists(QUEUE_DIR) && !SD.mkdir(QUEUE_DIR))
+  {
+    Serial.println("Offline queue: cannot create " QUEUE_DIR);
+    return false;
+  }
+
+  File dir = SD.open(QUEUE_DIR);
+  pending = 0;
+  File file = dir.openNextFile();
+  while (file)
+  {
+    if (!file.isDirectory() && isJob(file.name()))
+    {
+      uint32_t seq = strtoul(file.name(), NULL, 10);
+      nextSeq = max(nextSeq, seq + 1);
+      pending++;
+    }
+    file.close();
+    file = dir.openNextFile();
+  }
+  dir.close();
+
+  if (pending > 0)
+  {
+    Serial.printf("Offline queue: %d recordings waiting\n", pending);
+  }
+  return true;
+}
+
+bool queueAdd(const char *path)
+{
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+
+  char queued[96];
+  snprintf(queued, sizeof(queued), QUEUE_DIR "/%08lu_%s", (unsigned long)nextSeq, base);
+  if (!SD.rename(path, queued))
+  {
+    Serial.printf("Offline queue: cannot move %s\n", path);
+    return false;
+  }
+  nextSeq++;
+  pending++;
+  return true;
+}
+
+int queuePending()
+{
+  return pending;
+}
+
+// Move a finished job back next to the other recordings
+static void queueComplete(const String &job)
+{
+  int sep = job.indexOf('_', strlen(QUEUE_DIR) + 1);
+  String restored = "/" + job.substring(sep + 1);
+  if (!SD.rename(job, restored))
+  {
+    SD.remove(job);
+  }
+  pending--;
+}
+
+// Paths of the oldest count jobs, in order
+static int listOldest(String *jobs, int count)
+{
+  int found = 0;
+  File dir = SD.open(QUEUE_DIR);
+  if (!dir)
+  {
+    return 0;
+  }
+
+  File file = dir.openNextFile();
+  while (file)
+  {
+    if (!file.isDirectory() && isJob(file.name()))
+    {
+      String path = String(QUEUE_DIR) + "/" + file.name();
+
+      // Insertion into the sorted, bounded list
+      int i = found < count ? found++ : count;
+      while (i > 0 && path < jobs[i - 1])
+      {
+        if (i < count)
+          jobs[i] = jobs[i - 1];
+        i--;
+      }
+      if (i < count)
+        jobs[i] = path;
+    }
+    file.close();
+    file = dir.openNextFile();
+  }
+  dir.close();
+  return found;
+}
+
+static bool appendBody(void *ctx, const uint8_t *data, size_t len)
+{
+  String *body = (String *)ctx;
+  body->reserve(body->length() + len);
+  for (size_t i = 0; i < len; i++)
+  {
+    *body += (char)data[i];
+  }
+  return true;
+}
+
+int queueDrain(WiFiClientSecure &client, const QueueTarget &target)
+{
+  if (retryMs && (int32_t)(millis() - retryAt) < 0)
+  {
+    return 0;
+  }
+
+  String jobs[QUEUE_BATCH];
+  int count = listOldest(jobs, QUEUE_BATCH);
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  static HttpCarry carry; // Off the loop task stack
+  uint32_t t0 = millis();
+  int sent = 0;
+  int done = 0;
+  int completed = 0;
+  int connects = 0;
+  bool connected = false;
+
+  Serial.printf("Offline queue: draining %d of %d recordings\n", count, pending);
+
+  while (done < count)
+  {
+    if (!connected)
+    {
+      if (connects > QUEUE_MAX_RECONNECTS)
+      {
+        break;
+      }
+      client.stop();
+      connects++;
+      if (!connectWithRetry(client, target.host, target.port, millis() + QUEUE_JOB_TIMEOUT_MS))
+      {
+        break;
+      }
+      connected = true;
+      httpCarryReset(carry);
+      sent = done; // Anything unanswered goes out again
+    }
+
+    // Keep the pipeline full
+    while (sent < count && sent - done < QUEUE_PIPELINE_DEPTH)
+    {
+      if (!target.send(client, jobs[sent].c_str()))
+      {
+        connected = false;
+        break;
+      }
+      sent++;
+    }
+    if (!connected)
+    {
+      continue;
+    }
+
+    String body;
+    HttpResponse r;
+    httpResponseInit(r, appendBody, &body);
+    if (!httpReadResponse(client, r, QUEUE_JOB_TIMEOUT_MS, &carry))
+    {
+      Serial.printf("Offline queue: no response for %s (HTTP %d)\n", jobs[done].c_str(), r.status);
+      connected = false;
+      continue;
+    }
+
+    if (target.done(target.ctx, jobs[done].c_str(), r, body))
+    {
+      queueComplete(jobs[done]);
+      completed++;
+    }
+    done++;
+
+    if (!r.keepAlive)
+    {
+      connected = false;
+    }
+  }
+  client.stop();
+
+  uint32_t elapsed = millis() - t0;
+  Serial.printf("Offline queue: %d/%d done in %lu ms (%.1f utterances/min), %d connection(s), %d left\n",
+                completed, count, elapsed, elapsed ? completed * 60000.0 / elapsed : 0.0, connects, pending);
+
+  if (completed == count)
+  {
+    retryMs = 0;
+  }
+  else
+  {
+    retryMs = retryMs ? min(retryMs * 2, (uint32_t)QUEUE_RETRY_MAX_MS) : QUEUE_RETRY_MIN_MS;
+    retryAt = millis() + retryMs;
+    Serial.printf("Offline queue: next try in %lu s\n", retryMs / 1000);
+  }
+  return completed;
+}
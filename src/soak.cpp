@@ -0,0 +1,242 @@
+#include "soak.h"
+#include "backends.h"
+#include "mem_telemetry.h"
+#include <SD.h>
+#include <lwip/sockets.h>
+
+enum SoakMetric
+{
+  SOAK_HEAP_USED = 0,
+  SOAK_FRAGMENTATION,
+  SOAK_STT_MS,
+  SOAK_LLM_MS,
+  SOAK_TTS_MS,
+  SOAK_SOCKETS,
+  SOAK_FILES,
+  SOAK_TASKS,
+  SOAK_SD_WRITE_US,
+  SOAK_SD_USED_KB,
+  SOAK_METRICS
+};
+
+struct MetricInfo
+{
+  const char *name;
+  float limit; // Growth per 100 turns that fails the run
+};
+
+// Latency limits are loose: the mocks are steady, so growth of a few
+// milliseconds per hundred turns is already a trend and not noise
+static const MetricInfo metrics[SOAK_METRICS] = {
+    {"heap_used", 2048},     {"fragmentation_pct", 2}, {"stt_ms", 50},   {"llm_ms", 50},
+    {"tts_ms", 50},          {"sockets", 0.5},         {"files", 0.5},   {"tasks", 0.5},
+    {"sd_write_us", 2000},   {"sd_used_kb", 1024},
+};
+
+// Running least-squares sums per metric, x is the turn number
+struct Trend
+{
+  double sx, sy, sxy, sxx;
+  uint32_t n;
+  float first, last, peak;
+};
+
+static Trend trends[SOAK_METRICS];
+static SoakTurn soakTurn = NULL;
+static uint32_t cycle = 0;
+static uint32_t totalCycles = 0;
+static uint32_t failedTurns = 0;
+static uint32_t startMs = 0;
+static bool active = false;
+
+static float slopePer100(const Trend &t)
+{
+  double d = t.n * t.sxx - t.sx * t.sx;
+  return t.n < 2 || d == 0 ? 0 : 100 * (t.n * t.sxy - t.sx * t.sy) / d;
+}
+
+static void trendAdd(Trend &t, uint32_t x, float y)
+{
+  if (t.n == 0)
+  {
+    t.first = t.peak = y;
+  }
+  t.sx += x;
+  t.sy += y;
+  t.sxy += (double)x * y;
+  t.sxx += (double)x * x;
+  t.n++;
+  t.last = y;
+  t.peak = max(t.peak, y);
+}
+
+// Descriptors in use: VFS files below the lwIP range, sockets in it
+static void countDescriptors(uint32_t &files, uint32_t &sockets)
+{
+  files = sockets = 0;
+#ifdef LWIP_SOCKET_OFFSET
+  for (int fd = 0; fd < LWIP_SOCKET_OFFSET + CONFIG_LWIP_MAX_SOCKETS; fd++)
+  {
+    if (fcntl(fd, F_GETFL) >= 0)
+    {
+      (fd < LWIP_SOCKET_OFFSET ? files : sockets)++;
+    }
+  }
+#endif
+}
+
+// The same small write every turn; its time grows as the card fills and
+// the FAT gets fragmented
+static uint32_t sdWriteProbe()
+{
+  static uint8_t block[512];
+  uint32_t t0 = micros();
+  File f = SD.open(SOAK_PROBE, FILE_WRITE);
+  if (!f)
+  {
+    return 0;
+  }
+  for (int i = 0; i < SOAK_PROBE_BYTES / (int)sizeof(block); i++)
+  {
+    f.write(block, sizeof(block));
+  }
+  f.close();
+  SD.remove(SOAK_PROBE);
+  return micros() - t0;
+}
+
+void soakStart(uint32_t cycles, SoakTurn turn)
+{
+  memset(trends, 0, sizeof(trends));
+  soakTurn = turn;
+  cycle = 0;
+  totalCycles = cycles;
+  failedTurns = 0;
+  startMs = millis();
+  active = true;
+  backendOnly(SOAK_BACKEND);
+
+  SD.remove(SOAK_CSV);
+  File csv = SD.open(SOAK_CSV, FILE_WRITE);
+  if (csv)
+  {
+    csv.print("cycle,ms,ok");
+    for (int m = 0; m < SOAK_METRICS; m++)
+    {
+      csv.printf(",%s", metrics[m].name);
+    }
+    csv.println();
+    csv.close();
+  }
+  Serial.printf("Soak: %lu turns against the '%s' backends, metrics in %s\n", cycles, SOAK_BACKEND, SOAK_CSV);
+}
+
+void soakStop(const char *why)
+{
+  if (!active)
+  {
+    return;
+  }
+  active = false;
+  backendOnly(NULL);
+  Serial.printf("Soak stopped after %lu turns: %s\n", cycle, why);
+  soakReport();
+}
+
+bool soakActive()
+{
+  return active;
+}
+
+void soakPoll()
+{
+  if (!active)
+  {
+    return;
+  }
+
+  uint32_t t0 = millis();
+  soakTurn(cycle);
+  uint32_t turnMs = millis() - t0;
+  bool ok = stageOk(STAGE_STT) && stageOk(STAGE_LLM) && stageOk(STAGE_TTS);
+  failedTurns += !ok;
+
+  float values[SOAK_METRICS];
+  uint32_t files, sockets;
+  countDescriptors(files, sockets);
+  uint32_t freeHeap = ESP.getFreeHeap();
+  values[SOAK_HEAP_USED] = ESP.getHeapSize() - freeHeap;
+  values[SOAK_FRAGMENTATION] = freeHeap ? 100.0f - 100.0f * ESP.getMaxAllocHeap() / freeHeap : 0;
+  values[SOAK_STT_MS] = stageElapsed(STAGE_STT);
+  values[SOAK_LLM_MS] = stageElapsed(STAGE_LLM);
+  values[SOAK_TTS_MS] = stageElapsed(STAGE_TTS);
+  values[SOAK_SOCKETS] = sockets;
+  values[SOAK_FILES] = files;
+  values[SOAK_TASKS] = uxTaskGetNumberOfTasks();
+  values[SOAK_SD_WRITE_US] = sdWriteProbe();
+  values[SOAK_SD_USED_KB] = SD.usedBytes() / 1024;
+
+  // Failed turns time out instead of measuring the pipeline
+  if (cycle >= SOAK_WARMUP)
+  {
+    for (int m = 0; m < SOAK_METRICS; m++)
+    {
+      bool latency = m == SOAK_STT_MS || m == SOAK_LLM_MS || m == SOAK_TTS_MS;
+      if (ok || !latency)
+      {
+        trendAdd(trends[m], cycle, values[m]);
+      }
+    }
+  }
+
+  File csv = SD.open(SOAK_CSV, FILE_APPEND);
+  if (csv)
+  {
+    csv.printf("%lu,%lu,%d", cycle, turnMs, ok);
+    for (int m = 0; m < SOAK_METRICS; m++)
+    {
+      csv.printf(",%.0f", values[m]);
+    }
+    csv.println();
+    csv.close();
+  }
+  Serial.printf("Soak %lu/%lu: %s %lu ms, heap %.0f, frag %.0f%%, sockets %lu, files %lu, SD write %.0f us\n", cycle + 1,
+                totalCycles, ok ? "ok" : "FAILED", turnMs, values[SOAK_HEAP_USED], values[SOAK_FRAGMENTATION], sockets,
+                files, values[SOAK_SD_WRITE_US]);
+
+  cycle++;
+  if (ESP.getMaxAllocHeap() < MEM_LOW_BLOCK)
+  {
+    soakStop("largest free block below MEM_LOW_BLOCK, the next TLS handshake would fail");
+  }
+  else if (cycle >= totalCycles)
+  {
+    soakStop("done");
+  }
+  else if (cycle % SOAK_CHECK_EVERY == 0)
+  {
+    soakReport();
+  }
+}
+
+void soakReport()
+{
+  Serial.printf("\n=== Soak: %lu turns, %lu failed, %lu min ===\n", cycle, failedTurns, (millis() - startMs) / 60000);
+  Serial.println("metric             first     last     peak  per 100 turns  limit");
+  int failing = 0;
+  for (int m = 0; m < SOAK_METRICS; m++)
+  {
+    const Trend &t = trends[m];
+    float slope = slopePer100(t);
+    bool fail = t.n >= SOAK_MIN_SAMPLES && slope > metrics[m].limit;
+    failing += fail;
+    Serial.printf("%-17s %7.0f  %7.0f  %7.0f  %+13.1f  %5.1f %s\n", metrics[m].name, t.first, t.last, t.peak, slope,
+                  metrics[m].limit, fail ? "FAIL" : t.n < SOAK_MIN_SAMPLES ? "(too few turns)" : "");
+  }
+  bool tooManyFailed = cycle && failedTurns * 100 > cycle * SOAK_MAX_FAILED_PCT;
+  if (tooManyFailed)
+  {
+    Serial.printf("More than %d%% of the turns failed\n", SOAK_MAX_FAILED_PCT);
+  }
+  Serial.printf("Soak verdict: %s\n", failing || tooManyFailed ? "FAIL" : "pass");
+}
@@ -0,0 +1,643 @@
+#include "stt_result.h"
+#include "log.h"
+
+enum
+{
+  S_VALUE,          // Expecting a value
+  S_VALUE_OR_CLOSE, // Just after '['
+  S_KEY_OR_CLOSE,   // Just after '{'
+  S_KEY,            // After ',' in an object
+  S_COLON,
+  S_AFTER_VALUE,
+  S_STRING,
+  S_ESCAPE,
+  S_UNICODE,
+  S_NUMBER,
+  S_LITERAL,
+  S_DONE
+};
+
+// Keys on the way to what we keep
+enum
+{
+  K_OTHER,
+  K_RESULTS,
+  K_CHANNELS,
+  K_ALTERNATIVES,
+  K_TRANSCRIPT,
+  K_CONFIDENCE,
+  K_WORDS,
+  K_START,
+  K_END
+};
+
+static const char *const keyNames[] = {"", "results", "channels", "alternatives", "transcript",
+                                       "confidence", "words", "start", "end"};
+
+// String targets: discard, a key, or the transcript of alternative n - 2
+enum
+{
+  T_DISCARD,
+  T_KEY,
+  T_ALT0
+};
+
+// Buffers are only terminated, not cleared, so a reset costs next to nothing
+void sttResultInit(SttResult &r)
+{
+  r.transcript[0] = '\0';
+  r.length = 0;
+  r.confidence = -1;
+  r.wordCount = r.wordsTotal = 0;
+  r.alternatives = 0;
+  for (int i = 0; i < STT_RESULT_ALTS_MAX - 1; i++)
+  {
+    r.altTranscript[i][0] = '\0';
+    r.altConfidence[i] = -1;
+  }
+  r.truncated = r.complete = r.failed = false;
+  r.bytes = 0;
+  r.head[0] = '\0';
+  r.state = S_VALUE;
+  r.depth = 0;
+  r.target = T_DISCARD;
+}
+
+// Inside results.channels[0].alternatives, which is level 4
+static bool inAlternatives(const SttResult &r)
+{
+  return r.depth >= 5 && !r.levels[0].array && r.levels[0].key == K_RESULTS && !r.levels[1].array &&
+         r.levels[1].key == K_CHANNELS && r.levels[2].array && r.levels[2].index == 0 && !r.levels[3].array &&
+         r.levels[3].key == K_ALTERNATIVES && r.levels[4].array;
+}
+
+// Directly inside an alternative object, returns its number or -1
+static int alternativeAt(const SttResult &r)
+{
+  return r.depth == 6 && inAlternatives(r) && !r.levels[5].array ? r.levels[4].index : -1;
+}
+
+// Directly inside a word object of alternative 0, returns its number or -1
+static int wordAt(const SttResult &r)
+{
+  return r.depth == 8 && inAlternatives(r) && r.levels[4].index == 0 && r.levels[5].key == K_WORDS &&
+                 r.levels[6].array && !r.levels[7].array
+             ? r.levels[6].index
+             : -1;
+}
+
+static char *targetBuffer(SttResult &r, size_t &size)
+{
+  if (r.target == T_KEY)
+  {
+    size = sizeof(r.token);
+    return r.token;
+  }
+  if (r.target == T_ALT0)
+  {
+    size = sizeof(r.transcript);
+    return r.transcript;
+  }
+  size = STT_RESULT_ALT_TEXT_MAX;
+  return r.altTranscript[r.target - T_ALT0 - 1];
+}
+
+// Append bytes that belong together (one UTF-8 character), or none of them
+static void put(SttResult &r, const char *bytes, size_t n)
+{
+  if (r.target == T_DISCARD)
+  {
+    return;
+  }
+  size_t size;
+  char *buf = targetBuffer(r, size);
+  if (r.targetFull || r.targetLen + n >= size)
+  {
+    r.targetFull = true; // Nothing more goes in, not even a shorter character
+    if (r.target != T_KEY)
+    {
+      r.truncated = true;
+    }
+    return;
+  }
+  memcpy(buf + r.targetLen, bytes, n);
+  r.targetLen += n;
+  buf[r.targetLen] = '\0'; // Terminated even if the body stops here
+  if (r.target == T_ALT0)
+  {
+    r.length = r.targetLen;
+  }
+}
+
+static void putCodepoint(SttResult &r, uint32_t cp)
+{
+  char utf8[4];
+  size_t n;
+  if (cp < 0x80)
+  {
+    utf8[0] = cp;
+    n = 1;
+  }
+  else if (cp < 0x800)
+  {
+    utf8[0] = 0xC0 | (cp >> 6);
+    utf8[1] = 0x80 | (cp & 0x3F);
+    n = 2;
+  }
+  else if (cp < 0x10000)
+  {
+    utf8[0] = 0xE0 | (cp >> 12);
+    utf8[1] = 0x80 | ((cp >> 6) & 0x3F);
+    utf8[2] = 0x80 | (cp & 0x3F);
+    n = 3;
+  }
+  else
+  {
+    utf8[0] = 0xF0 | (cp >> 18);
+    utf8[1] = 0x80 | ((cp >> 12) & 0x3F);
+    utf8[2] = 0x80 | ((cp >> 6) & 0x3F);
+    utf8[3] = 0x80 | (cp & 0x3F);
+    n = 4;
+  }
+  put(r, utf8, n);
+}
+
+// A lone high surrogate is written as U+FFFD when no low one follows
+static void flushSurrogate(SttResult &r)
+{
+  if (r.highSurrogate)
+  {
+    putCodepoint(r, 0xFFFD);
+    r.highSurrogate = 0;
+  }
+}
+
+static void startString(SttResult &r, bool key)
+{
+  r.state = S_STRING;
+  r.targetLen = 0;
+  r.targetFull = false;
+  r.highSurrogate = 0;
+  r.target = T_DISCARD;
+  if (key)
+  {
+    r.target = T_KEY;
+    return;
+  }
+  int alt = alternativeAt(r);
+  if (alt >= 0 && alt < STT_RESULT_ALTS_MAX && r.levels[5].key == K_TRANSCRIPT)
+  {
+    r.target = T_ALT0 + alt;
+  }
+}
+
+// Raw UTF-8 bytes are copied one at a time; if the buffer filled up in the
+// middle of a character, its first bytes are dropped here
+static size_t trimPartial(const char *buf, size_t len)
+{
+  size_t start = len;
+  while (start > 0 && (buf[start - 1] & 0xC0) == 0x80)
+  {
+    start--;
+  }
+  if (start == 0 || (uint8_t)buf[start - 1] < 0xC0)
+  {
+    return len;
+  }
+  uint8_t lead = buf[start - 1];
+  size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+  return len - (start - 1) >= need ? len : start - 1;
+}
+
+static void endString(SttResult &r)
+{
+  flushSurrogate(r);
+  if (r.target == T_DISCARD)
+  {
+    return;
+  }
+  size_t size;
+  char *buf = targetBuffer(r, size);
+  size_t len = r.target == T_KEY ? r.targetLen : trimPartial(buf, r.targetLen);
+  buf[len] = '\0';
+
+  if (r.target == T_KEY)
+  {
+    uint8_t key = K_OTHER;
+    for (uint8_t k = 1; k < sizeof(keyNames) / sizeof(keyNames[0]) && !r.targetFull; k++)
+    {
+      if (strcmp(r.token, keyNames[k]) == 0)
+      {
+        key = k;
+        break;
+      }
+    }
+    r.levels[r.depth - 1].key = key;
+  }
+  else if (r.target == T_ALT0)
+  {
+    r.length = len;
+  }
+}
+
+static void endNumber(SttResult &r)
+{
+  if (r.tokenLen >= sizeof(r.token))
+  {
+    return; // Too long to be anything we keep
+  }
+  r.token[r.tokenLen] = '\0';
+  char *end;
+  float value = strtof(r.token, &end);
+  if (*end)
+  {
+    r.failed = true;
+    return;
+  }
+  if (r.depth == 0)
+  {
+    return;
+  }
+  uint8_t key = r.levels[r.depth - 1].key;
+
+  int alt = alternativeAt(r);
+  if (alt >= 0 && key == K_CONFIDENCE)
+  {
+    if (alt == 0)
+    {
+      r.confidence = value;
+    }
+    else if (alt < STT_RESULT_ALTS_MAX)
+    {
+      r.altConfidence[alt - 1] = value;
+    }
+    return;
+  }
+
+  int word = wordAt(r);
+  if (word >= 0 && word < STT_RESULT_WORDS_MAX)
+  {
+    SttWord &w = r.words[word];
+    uint32_t ms = value > 0 ? (uint32_t)(value * 1000 + 0.5f) : 0;
+    if (key == K_START)
+    {
+      w.startMs = ms;
+    }
+    else if (key == K_END)
+    {
+      w.endMs = ms;
+    }
+    else if (key == K_CONFIDENCE)
+    {
+      w.confidence = value;
+    }
+  }
+}
+
+static void endLiteral(SttResult &r)
+{
+  r.token[min((size_t)r.tokenLen, sizeof(r.token) - 1)] = '\0';
+  if (strcmp(r.token, "true") != 0 && strcmp(r.token, "false") != 0 && strcmp(r.token, "null") != 0)
+  {
+    r.failed = true;
+  }
+}
+
+// A value begins at the current level
+static void valueStarts(SttResult &r)
+{
+  if (r.depth == 0)
+  {
+    return;
+  }
+  if (r.depth == 5 && inAlternatives(r))
+  {
+    r.alternatives = max((int)r.alternatives, r.levels[4].index + 1);
+  }
+  else if (r.depth == 7 && inAlternatives(r) && r.levels[4].index == 0 && r.levels[5].key == K_WORDS &&
+           r.levels[6].array)
+  {
+    uint16_t i = r.levels[6].index;
+    r.wordsTotal = i + 1;
+    r.wordCount = min((int)r.wordsTotal, STT_RESULT_WORDS_MAX);
+    if (i < STT_RESULT_WORDS_MAX)
+    {
+      memset(&r.words[i], 0, sizeof(r.words[i]));
+    }
+  }
+}
+
+static void push(SttResult &r, bool array)
+{
+  if (r.depth >= STT_RESULT_DEPTH)
+  {
+    r.failed = true;
+    return;
+  }
+  r.levels[r.depth].array = array;
+  r.levels[r.depth].key = K_OTHER;
+  r.levels[r.depth].index = 0;
+  r.depth++;
+  r.state = array ? S_VALUE_OR_CLOSE : S_KEY_OR_CLOSE;
+}
+
+static void pop(SttResult &r, bool array)
+{
+  if (r.depth == 0 || r.levels[r.depth - 1].array != array)
+  {
+    r.failed = true;
+    return;
+  }
+  if (array && r.depth == 5 && inAlternatives(r))
+  {
+    r.complete = true;
+  }
+  r.depth--;
+  r.state = r.depth == 0 ? S_DONE : S_AFTER_VALUE;
+}
+
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static void beginValue(SttResult &r, char c)
+{
+  valueStarts(r);
+  if (c == '{' || c == '[')
+  {
+    push(r, c == '[');
+  }
+  else if (c == '"')
+  {
+    startString(r, false);
+  }
+  else if (c == '-' || (c >= '0' && c <= '9'))
+  {
+    r.state = S_NUMBER;
+    r.token[0] = c;
+    r.tokenLen = 1;
+  }
+  else if (c == 't' || c == 'f' || c == 'n')
+  {
+    r.state = S_LITERAL;
+    r.token[0] = c;
+    r.tokenLen = 1;
+  }
+  else
+  {
+    r.failed = true;
+  }
+}
+
+static void afterValue(SttResult &r, char c)
+{
+  if (isSpace(c))
+  {
+    return;
+  }
+  bool array = r.levels[r.depth - 1].array;
+  if (c == ',')
+  {
+    if (array)
+    {
+      r.levels[r.depth - 1].index++;
+      r.state = S_VALUE;
+    }
+    else
+    {
+      r.state = S_KEY;
+    }
+  }
+  else if (c == '}' || c == ']')
+  {
+    pop(r, c == ']');
+  }
+  else
+  {
+    r.failed = true;
+  }
+}
+
+static void step(SttResult &r, char c)
+{
+  switch (r.state)
+  {
+  case S_VALUE:
+    if (!isSpace(c))
+    {
+      beginValue(r, c);
+    }
+    break;
+
+  case S_VALUE_OR_CLOSE:
+    if (c == ']')
+    {
+      pop(r, true);
+    }
+    else if (!isSpace(c))
+    {
+      beginValue(r, c);
+    }
+    break;
+
+  case S_KEY_OR_CLOSE:
+  case S_KEY:
+    if (c == '}' && r.state == S_KEY_OR_CLOSE)
+    {
+      pop(r, false);
+    }
+    else if (c == '"')
+    {
+      startString(r, true);
+    }
+    else if (!isSpace(c))
+    {
+      r.failed = true;
+    }
+    break;
+
+  case S_COLON:
+    if (c == ':')
+    {
+      r.state = S_VALUE;
+    }
+    else if (!isSpace(c))
+    {
+      r.failed = true;
+    }
+    break;
+
+  case S_AFTER_VALUE:
+    afterValue(r, c);
+    break;
+
+  case S_STRING:
+    if (c == '"')
+    {
+      bool key = r.target == T_KEY;
+      endString(r);
+      r.state = key ? S_COLON : r.depth == 0 ? S_DONE : S_AFTER_VALUE;
+    }
+    else if (c == '\\')
+    {
+      r.state = S_ESCAPE;
+    }
+    else if ((uint8_t)c < 0x20)
+    {
+      r.failed = true; // Control characters must be escaped
+    }
+    else
+    {
+      flushSurrogate(r);
+      put(r, &c, 1);
+    }
+    break;
+
+  case S_ESCAPE:
+  {
+    static const char from[] = "\"\\/bfnrt";
+    static const char to[] = "\"\\/\b\f\n\r\t";
+    const char *p = c ? strchr(from, c) : NULL;
+    r.state = S_STRING;
+    if (c == 'u')
+    {
+      r.state = S_UNICODE;
+      r.hex = 0;
+      r.hexDigits = 0;
+    }
+    else if (p)
+    {
+      flushSurrogate(r);
+      put(r, &to[p - from], 1);
+    }
+    else
+    {
+      r.failed = true;
+    }
+    break;
+  }
+
+  case S_UNICODE:
+  {
+    int v = hexValue(c);
+    if (v < 0)
+    {
+      r.failed = true;
+      break;
+    }
+    r.hex = r.hex << 4 | v;
+    if (++r.hexDigits < 4)
+    {
+      break;
+    }
+    r.state = S_STRING;
+    if (r.hex >= 0xD800 && r.hex < 0xDC00)
+    {
+      flushSurrogate(r);
+      r.highSurrogate = r.hex;
+    }
+    else if (r.hex >= 0xDC00 && r.hex < 0xE000)
+    {
+      if (r.highSurrogate)
+      {
+        putCodepoint(r, 0x10000 + ((uint32_t)(r.highSurrogate - 0xD800) << 10) + (r.hex - 0xDC00));
+        r.highSurrogate = 0;
+      }
+      else
+      {
+        putCodepoint(r, 0xFFFD);
+      }
+    }
+    else
+    {
+      flushSurrogate(r);
+      putCodepoint(r, r.hex);
+    }
+    break;
+  }
+
+  case S_NUMBER:
+  case S_LITERAL:
+  {
+    bool number = r.state == S_NUMBER;
+    bool part = number ? (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-'
+                       : c >= 'a' && c <= 'z';
+    if (part)
+    {
+      if (r.tokenLen < sizeof(r.token))
+      {
+        r.token[r.tokenLen] = c;
+      }
+      if (r.tokenLen < 255)
+      {
+        r.tokenLen++;
+      }
+      break;
+    }
+    if (number)
+    {
+      endNumber(r);
+    }
+    else
+    {
+      endLiteral(r);
+    }
+    if (r.depth == 0)
+    {
+      r.state = S_DONE;
+      break;
+    }
+    r.state = S_AFTER_VALUE;
+    afterValue(r, c);
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+bool sttResultFeed(SttResult &r, const uint8_t *data, size_t len)
+{
+  if (r.bytes < sizeof(r.head) - 1)
+  {
+    size_t n = min(len, sizeof(r.head) - 1 - r.bytes);
+    memcpy(r.head + r.bytes, data, n);
+    r.head[r.bytes + n] = '\0';
+  }
+
+  for (size_t i = 0; i < len && !r.complete && !r.failed && r.state != S_DONE; i++)
+  {
+    step(r, (char)data[i]);
+    r.bytes++;
+  }
+  return !r.complete && !r.failed && r.state != S_DONE;
+}
+
+bool sttResultBody(void *ctx, const uint8_t *data, size_t len)
+{
+  return sttResultFeed(*(SttResult *)ctx, data, len);
+}
+
+void sttResultLog(const SttResult &r)
+{
+  LOG_D("Transcript confidence %d%%, %u words, %u alternatives", (int)(r.confidence * 100), r.wordsTotal,
+        r.alternatives);
+  for (uint16_t i = 0; i < r.wordCount; i++)
+  {
+    LOG_D("  word %u: %lu-%lu ms, confidence %d%%", i, r.words[i].startMs, r.words[i].endMs,
+          (int)(r.words[i].confidence * 100));
+  }
+}
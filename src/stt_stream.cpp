@@ -0,0 +1,270 @@
+#include "stt_stream.h"
+#include "websocket.h"
+#include "turn_scheduler.h"
+#include "cores.h"
+#include <ArduinoJson.h>
+
+enum StreamState
+{
+  STREAM_CLOSED = 0,
+  STREAM_OPENING, // Owned by the open task until it leaves this state
+  STREAM_OPEN,
+  STREAM_UTTERANCE
+};
+
+static volatile StreamState state = STREAM_CLOSED;
+static volatile bool closeWhenOpen = false;
+static WsClient ws;
+static WiFiClientSecure *streamTcp = NULL;
+static WiFiClient plainTcp; // STT_STREAM_TLS 0, the LAN mock
+static char authHeader[96];
+static uint32_t lastSend = 0;
+static uint32_t lastFail = 0;
+
+// Current utterance
+static char finalText[STT_TEXT_MAX];  // Segments Deepgram has finalized
+static char interim[STT_TEXT_MAX];    // Latest interim of the open segment
+static char hypothesis[STT_TEXT_MAX]; // Both together
+static uint32_t hypothesisAt = 0;     // millis() when it last changed
+static bool stableGiven = false;
+static bool speechFinal = false;
+static bool streamLost = false;
+static int results = 0;
+
+static void appendText(char *dst, const char *src)
+{
+  if (!*src)
+  {
+    return;
+  }
+  size_t len = strlen(dst);
+  if (len && len + 1 < STT_TEXT_MAX)
+  {
+    dst[len++] = ' ';
+  }
+  strlcpy(dst + len, src, STT_TEXT_MAX - len);
+}
+
+static void onMessage(void *ctx, const char *text, size_t len)
+{
+  // Only the fields used here, the word timings are skipped
+  StaticJsonDocument<128> filter;
+  filter["type"] = true;
+  filter["is_final"] = true;
+  filter["speech_final"] = true;
+  filter["channel"]["alternatives"][0]["transcript"] = true;
+
+  DynamicJsonDocument doc(1024);
+  if (deserializeJson(doc, text, len, DeserializationOption::Filter(filter)))
+  {
+    return;
+  }
+  if (strcmp(doc["type"] | "", "Results") != 0)
+  {
+    return; // Metadata, SpeechStarted, UtteranceEnd
+  }
+
+  const char *transcript = doc["channel"]["alternatives"][0]["transcript"] | "";
+  if (doc["is_final"] | false)
+  {
+    appendText(finalText, transcript);
+    interim[0] = '\0';
+  }
+  else
+  {
+    strlcpy(interim, transcript, sizeof(interim));
+  }
+  speechFinal = speechFinal || (doc["speech_final"] | false);
+  results++;
+
+  char next[STT_TEXT_MAX];
+  strlcpy(next, finalText, sizeof(next));
+  appendText(next, interim);
+  if (strcmp(next, hypothesis) != 0)
+  {
+    strlcpy(hypothesis, next, sizeof(hypothesis));
+    hypothesisAt = millis();
+    stableGiven = false;
+  }
+}
+
+static void openTask(void *param)
+{
+  uint32_t deadline = millis() + STT_OPEN_TIMEOUT_MS;
+  bool ok = STT_STREAM_TLS ? wsConnect(ws, *streamTcp, STT_STREAM_HOST, STT_STREAM_PORT, STT_STREAM_PATH, authHeader,
+                                       onMessage, NULL, deadline)
+                           : wsConnect(ws, plainTcp, STT_STREAM_HOST, STT_STREAM_PORT, STT_STREAM_PATH, authHeader,
+                                       onMessage, NULL, deadline);
+  if (ok && closeWhenOpen)
+  {
+    wsClose(ws);
+    ok = false;
+  }
+  lastSend = millis();
+  lastFail = ok ? 0 : millis();
+  state = ok ? STREAM_OPEN : STREAM_CLOSED;
+  vTaskDelete(NULL);
+}
+
+void sttStreamOpen(WiFiClientSecure &tcp, const char *apiKey)
+{
+  if (state != STREAM_CLOSED || (lastFail && millis() - lastFail < STT_RETRY_MS))
+  {
+    return;
+  }
+
+  streamTcp = &tcp;
+  tcp.setInsecure();
+  snprintf(authHeader, sizeof(authHeader), "Authorization: Token %s\r\n", apiKey);
+  closeWhenOpen = false;
+  state = STREAM_OPENING;
+
+  // TLS handshake needs a big stack
+  if (netTaskCreate(openTask, "sttopen", 12288, NULL, 1) != pdPASS)
+  {
+    state = STREAM_CLOSED;
+    lastFail = millis();
+  }
+}
+
+void sttStreamClose()
+{
+  if (state == STREAM_OPENING)
+  {
+    closeWhenOpen = true;
+    return;
+  }
+  if (state != STREAM_CLOSED)
+  {
+    wsClose(ws);
+    state = STREAM_CLOSED;
+  }
+}
+
+bool sttStreamReady()
+{
+  return state == STREAM_OPEN;
+}
+
+bool sttStreamStart()
+{
+  if (state != STREAM_OPEN || !ws.open)
+  {
+    return false;
+  }
+  finalText[0] = interim[0] = hypothesis[0] = '\0';
+  stableGiven = false;
+  speechFinal = false;
+  streamLost = false;
+  results = 0;
+  state = STREAM_UTTERANCE;
+  return true;
+}
+
+bool sttStreamActive()
+{
+  return state == STREAM_UTTERANCE;
+}
+
+void sttStreamSend(const int16_t *samples, size_t count)
+{
+  if (state != STREAM_UTTERANCE || streamLost)
+  {
+    return;
+  }
+  if (!wsSendBinary(ws, (const uint8_t *)samples, count * sizeof(int16_t)))
+  {
+    Serial.println("Live transcription: stream lost, the recording will be sent instead");
+    streamLost = true;
+  }
+  lastSend = millis();
+}
+
+void sttStreamPoll()
+{
+  if (state != STREAM_OPEN && state != STREAM_UTTERANCE)
+  {
+    return;
+  }
+
+  bool open = wsPoll(ws);
+  if (state == STREAM_UTTERANCE)
+  {
+    streamLost = streamLost || !open;
+    return;
+  }
+
+  if (!open)
+  {
+    state = STREAM_CLOSED; // Reopened on the next sttStreamOpen()
+  }
+  else if (millis() - lastSend > STT_KEEPALIVE_MS)
+  {
+    wsSendText(ws, "{\"type\":\"KeepAlive\"}");
+    lastSend = millis();
+  }
+}
+
+const char *sttStreamStable()
+{
+  if (state != STREAM_UTTERANCE || stableGiven || !hypothesis[0])
+  {
+    return NULL;
+  }
+  if (!speechFinal && millis() - hypothesisAt < STT_STABLE_MS)
+  {
+    return NULL;
+  }
+  stableGiven = true;
+  return hypothesis;
+}
+
+bool sttStreamFinish(String &transcript, uint32_t deadline)
+{
+  if (state != STREAM_UTTERANCE)
+  {
+    return false;
+  }
+
+  // Deepgram sends the last results and closes once the audio is flushed
+  uint32_t t0 = millis();
+  bool flushed = !streamLost && wsSendText(ws, "{\"type\":\"CloseStream\"}");
+  while (flushed && wsPoll(ws) && msUntil(deadline) > 0)
+  {
+    delay(2);
+  }
+  wsClose(ws);
+  state = STREAM_CLOSED;
+
+  appendText(finalText, interim);
+  transcript = finalText;
+  Serial.printf("Live transcription: %d results, final %lu ms after the end of audio%s\n", results,
+                millis() - t0, flushed ? "" : " (stream lost)");
+  return flushed;
+}
+
+bool sttSameWords(const char *a, const char *b)
+{
+  while (true)
+  {
+    while (*a && !isalnum((uint8_t)*a))
+      a++;
+    while (*b && !isalnum((uint8_t)*b))
+      b++;
+    if (!*a || !*b)
+    {
+      return !*a && !*b;
+    }
+    while (isalnum((uint8_t)*a) && isalnum((uint8_t)*b))
+    {
+      if (tolower((uint8_t)*a) != tolower((uint8_t)*b))
+        return false;
+      a++;
+      b++;
+    }
+    if (isalnum((uint8_t)*a) || isalnum((uint8_t)*b))
+    {
+      return false;
+    }
+  }
+}
@@ -0,0 +1,122 @@
+#include "tts_decode.h"
+#include <Arduino.h>
+
+static int16_t mulawTable[256];
+static bool tableReady = false;
+
+// G.711 mu-law expansion
+int16_t ttsMulawExpand(uint8_t u)
+{
+  u = ~u;
+  int t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+  return (u & 0x80) ? 0x84 - t : t - 0x84;
+}
+
+uint8_t ttsMulawCompress(int pcm)
+{
+  int sign = pcm < 0 ? 0x80 : 0;
+  pcm = min(abs(pcm), 32635) + 0x84;
+  int exponent = 7;
+  for (int mask = 0x4000; !(pcm & mask) && exponent > 0; mask >>= 1)
+  {
+    exponent--;
+  }
+  return ~(sign | exponent << 4 | ((pcm >> (exponent + 3)) & 0x0F));
+}
+
+const char *ttsEncodingName(TtsEncoding encoding)
+{
+  return encoding == TTS_MULAW ? "mulaw" : "linear16";
+}
+
+void ttsDecodeInit(TtsDecoder &d, TtsEncoding encoding, TtsPcmSink sink, void *ctx)
+{
+  if (!tableReady)
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      mulawTable[i] = ttsMulawExpand(i);
+    }
+    tableReady = true;
+  }
+  d.encoding = encoding;
+  d.sink = sink;
+  d.ctx = ctx;
+  d.fill = 0;
+  d.hasOdd = false;
+  d.failed = false;
+  d.samples = 0;
+}
+
+static bool emit(TtsDecoder &d)
+{
+  if (d.fill && !d.failed && !d.sink(d.ctx, d.block, d.fill))
+  {
+    d.failed = true;
+  }
+  d.samples += d.fill;
+  d.fill = 0;
+  return !d.failed;
+}
+
+bool ttsDecodeFeed(TtsDecoder &d, const uint8_t *data, size_t len)
+{
+  const uint8_t *end = data + len;
+  if (d.encoding == TTS_MULAW)
+  {
+    while (data < end)
+    {
+      size_t n = min((size_t)(end - data), (size_t)(TTS_DECODE_BLOCK - d.fill));
+      int16_t *out = d.block + d.fill;
+      for (size_t i = 0; i < n; i++)
+      {
+        out[i] = mulawTable[data[i]];
+      }
+      data += n;
+      d.fill += n;
+      if (d.fill == TTS_DECODE_BLOCK && !emit(d))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // linear16, little-endian
+  if (d.hasOdd && data < end)
+  {
+    d.block[d.fill++] = (int16_t)(d.odd | *data++ << 8);
+    d.hasOdd = false;
+    if (d.fill == TTS_DECODE_BLOCK && !emit(d))
+    {
+      return false;
+    }
+  }
+  while (end - data >= 2)
+  {
+    size_t n = min((size_t)(end - data) / 2, (size_t)(TTS_DECODE_BLOCK - d.fill));
+    memcpy(d.block + d.fill, data, n * 2);
+    data += n * 2;
+    d.fill += n;
+    if (d.fill == TTS_DECODE_BLOCK && !emit(d))
+    {
+      return false;
+    }
+  }
+  if (data < end)
+  {
+    d.odd = *data;
+    d.hasOdd = true;
+  }
+  return true;
+}
+
+bool ttsDecodeBody(void *ctx, const uint8_t *data, size_t len)
+{
+  return ttsDecodeFeed(*(TtsDecoder *)ctx, data, len);
+}
+
+bool ttsDecodeFlush(TtsDecoder &d)
+{
+  return emit(d);
+}
@@ -0,0 +1,197 @@
+// On-device decode benchmark ('^'). It lives apart from the decoder, which
+// also builds on the host for test/test_tts_decode without SD or prompts
+#include "tts_decode.h"
+#include "prompts.h"
+#include <Arduino.h>
+#include <SD.h>
+#include <math.h>
+
+#define BENCH_PIECE 1460         // One TCP segment, as the body arrives
+#define BENCH_MAX_BYTES 196608   // Per recorded linear16 response, about 6 s
+#define BENCH_RATE 16000
+
+// Benchmark sinks: one that only counts, one that fingerprints the samples
+static bool countSink(void *ctx, const int16_t *samples, size_t count)
+{
+  *(uint32_t *)ctx += samples[count - 1];
+  return true;
+}
+
+static bool hashSink(void *ctx, const int16_t *samples, size_t count)
+{
+  uint32_t &h = *(uint32_t *)ctx;
+  for (size_t i = 0; i < count; i++)
+  {
+    h = (h ^ (uint16_t)samples[i]) * 16777619u; // FNV-1a over samples
+  }
+  return true;
+}
+
+static uint32_t decodeAll(TtsEncoding encoding, const uint8_t *data, size_t len, size_t piece, TtsPcmSink sink,
+                          uint32_t seed)
+{
+  static TtsDecoder d;
+  uint32_t out = seed;
+  ttsDecodeInit(d, encoding, sink, &out);
+  for (size_t pos = 0; pos < len; pos += piece)
+  {
+    ttsDecodeFeed(d, data + pos, min(piece, len - pos));
+  }
+  ttsDecodeFlush(d);
+  return out;
+}
+
+struct BenchTotals
+{
+  uint32_t responses;
+  uint32_t linearBytes;
+  uint32_t mulawBytes;
+  uint32_t linearUs;
+  uint32_t mulawUs;
+  uint32_t splitErrors;
+};
+
+// Decode one response pair iterations times in segment-sized pieces
+static void benchPair(const char *name, const uint8_t *linear, size_t linearBytes, const uint8_t *mulaw,
+                      size_t mulawBytes, int iterations, BenchTotals &totals)
+{
+  uint32_t sink = 0;
+  uint32_t t0 = micros();
+  for (int it = 0; it < iterations; it++)
+  {
+    sink += decodeAll(TTS_LINEAR16, linear, linearBytes, BENCH_PIECE, countSink, 0);
+  }
+  uint32_t linearUs = micros() - t0;
+  t0 = micros();
+  for (int it = 0; it < iterations; it++)
+  {
+    sink += decodeAll(TTS_MULAW, mulaw, mulawBytes, BENCH_PIECE, countSink, 0);
+  }
+  uint32_t mulawUs = micros() - t0;
+
+  // Any split of the body must decode to the same samples
+  static const size_t pieces[] = {1, 3, 7, 511};
+  for (int e = 0; e < 2; e++)
+  {
+    TtsEncoding encoding = e ? TTS_MULAW : TTS_LINEAR16;
+    const uint8_t *data = e ? mulaw : linear;
+    size_t len = e ? mulawBytes : linearBytes;
+    uint32_t whole = decodeAll(encoding, data, len, len, hashSink, 2166136261u);
+    for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++)
+    {
+      totals.splitErrors += decodeAll(encoding, data, len, pieces[p], hashSink, 2166136261u) != whole;
+    }
+  }
+
+  float seconds = (float)linearBytes / 2 / BENCH_RATE;
+  Serial.printf("  %-16s %5.2f s  linear16 %7u B %5.0f us/s   mulaw %7u B %5.0f us/s  (%u)\n", name, seconds,
+                linearBytes, linearUs / iterations / seconds, mulawBytes, mulawUs / iterations / seconds, sink & 1);
+  totals.responses++;
+  totals.linearBytes += linearBytes;
+  totals.mulawBytes += mulawBytes;
+  totals.linearUs += linearUs / iterations;
+  totals.mulawUs += mulawUs / iterations;
+}
+
+static uint8_t *readAll(const String &path, size_t maxBytes, size_t &len)
+{
+  File f = SD.open(path, FILE_READ);
+  if (!f || f.size() == 0 || f.size() > maxBytes)
+  {
+    f.close();
+    return NULL;
+  }
+  len = f.size();
+  uint8_t *data = (uint8_t *)malloc(len);
+  if (data && f.read(data, len) != (int)len)
+  {
+    free(data);
+    data = NULL;
+  }
+  f.close();
+  return data;
+}
+
+// Pairs NAME.pcm and NAME.ulaw recorded by scripts/tts_bench.py
+static void benchRecorded(int iterations, BenchTotals &totals)
+{
+  File dir = SD.open(TTS_BENCH_DIR);
+  if (!dir || !dir.isDirectory())
+  {
+    return;
+  }
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+  {
+    String name = f.name();
+    f.close();
+    if (!name.endsWith(".pcm"))
+    {
+      continue;
+    }
+    name = name.substring(name.lastIndexOf('/') + 1, name.length() - 4);
+    size_t linearBytes = 0, mulawBytes = 0;
+    uint8_t *linear = readAll(String(TTS_BENCH_DIR "/") + name + ".pcm", BENCH_MAX_BYTES, linearBytes);
+    uint8_t *mulaw = readAll(String(TTS_BENCH_DIR "/") + name + ".ulaw", BENCH_MAX_BYTES / 2, mulawBytes);
+    if (linear && mulaw)
+    {
+      benchPair(name.c_str(), linear, linearBytes & ~1, mulaw, mulawBytes, iterations, totals);
+    }
+    else
+    {
+      Serial.printf("  %s: skipped, missing .ulaw, too large or out of memory\n", name.c_str());
+    }
+    free(linear);
+    free(mulaw);
+  }
+  dir.close();
+}
+
+// No recordings: the prompt bank, compressed here. Also gives the
+// quantization noise, since both encodings come from the same samples.
+static void benchPrompts(int iterations, BenchTotals &totals)
+{
+  for (int p = 0; p < PROMPT_COUNT; p++)
+  {
+    const PromptClip &clip = promptClips[p];
+    uint8_t *mulaw = (uint8_t *)malloc(clip.count);
+    if (!mulaw || !clip.count)
+    {
+      free(mulaw);
+      continue;
+    }
+    double signal = 0, noise = 0;
+    for (uint32_t i = 0; i < clip.count; i++)
+    {
+      mulaw[i] = ttsMulawCompress(clip.samples[i]);
+      double e = ttsMulawExpand(mulaw[i]) - clip.samples[i];
+      signal += (double)clip.samples[i] * clip.samples[i];
+      noise += e * e;
+    }
+    benchPair(clip.name, (const uint8_t *)clip.samples, clip.count * 2, mulaw, clip.count, iterations, totals);
+    Serial.printf("  %-16s SNR %.1f dB\n", "", noise > 0 ? 10 * log10(signal / noise) : 99.0);
+    free(mulaw);
+  }
+}
+
+void ttsDecodeBenchmark(int iterations)
+{
+  BenchTotals totals = {};
+  Serial.printf("\n=== TTS decode, %d runs each, %d-byte pieces ===\n", iterations, BENCH_PIECE);
+  benchRecorded(iterations, totals);
+  if (!totals.responses)
+  {
+    Serial.println("No recorded responses in " TTS_BENCH_DIR ", using the prompt bank");
+    benchPrompts(iterations, totals);
+  }
+  if (!totals.responses)
+  {
+    return;
+  }
+
+  float seconds = (float)totals.linearBytes / 2 / BENCH_RATE;
+  Serial.printf("Total %.1f s of speech: linear16 %u B, mulaw %u B (%.0f%% less to download)\n", seconds,
+                totals.linearBytes, totals.mulawBytes, 100.0f * (totals.linearBytes - totals.mulawBytes) / totals.linearBytes);
+  Serial.printf("Decode per second of speech: linear16 %.0f us, mulaw %.0f us (%.2f%% of one core)\n",
+                totals.linearUs / seconds, totals.mulawUs / seconds, totals.mulawUs / seconds / 1e4f);
+  Serial.printf("Split invariance: %u differences\n", totals.splitErrors);
+}
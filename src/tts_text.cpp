@@ -0,0 +1,416 @@
+#include <Arduino.h>
+#include "tts_text.h"
+
+struct TextWriter
+{
+  char *out;
+  size_t cap; // Usable bytes, one is kept for the terminator
+  size_t len;
+  bool pendingSpace;
+  const char *currency; // Read after the number that follows
+};
+
+static bool isSentenceEnd(char c)
+{
+  return c == '.' || c == '!' || c == '?';
+}
+
+static char lastChar(const TextWriter &w)
+{
+  return w.len ? w.out[w.len - 1] : '\0';
+}
+
+// Write n bytes as one unit, with the pending space in front unless
+// this is closing punctuation. The first unit that does not fit ends
+// the output, so text is cut on a whole word or character.
+static void emit(TextWriter &w, const char *s, size_t n)
+{
+  bool space = w.pendingSpace && w.len > 0 && !strchr(".,!?;:)", s[0]);
+  if (w.len + space + n > w.cap)
+  {
+    w.cap = w.len;
+    return;
+  }
+  if (space)
+  {
+    w.out[w.len++] = ' ';
+  }
+  memcpy(w.out + w.len, s, n);
+  w.len += n;
+  w.pendingSpace = false;
+}
+
+static void emitChar(TextWriter &w, char c)
+{
+  emit(w, &c, 1);
+}
+
+static void emitWord(TextWriter &w, const char *word)
+{
+  w.pendingSpace = true;
+  emit(w, word, strlen(word));
+  w.pendingSpace = true;
+}
+
+static const char *const ones[] = {"zero", "one", "two", "three", "four", "five", "six", "seven", "eight",
+                                   "nine", "ten", "eleven", "twelve", "thirteen", "fourteen", "fifteen",
+                                   "sixteen", "seventeen", "eighteen", "nineteen"};
+static const char *const tens[] = {"", "", "twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety"};
+
+static void sayBelowThousand(TextWriter &w, uint32_t n)
+{
+  if (n >= 100)
+  {
+    emitWord(w, ones[n / 100]);
+    emitWord(w, "hundred");
+    n %= 100;
+  }
+  if (n >= 20)
+  {
+    emitWord(w, tens[n / 10]);
+    if (n % 10)
+    {
+      w.pendingSpace = false;
+      emitChar(w, '-');
+      emit(w, ones[n % 10], strlen(ones[n % 10]));
+      w.pendingSpace = true;
+    }
+  }
+  else if (n > 0)
+  {
+    emitWord(w, ones[n]);
+  }
+}
+
+static void sayNumber(TextWriter &w, uint32_t n)
+{
+  if (n == 0)
+  {
+    emitWord(w, ones[0]);
+    return;
+  }
+  if (n >= 1000)
+  {
+    sayBelowThousand(w, n / 1000);
+    emitWord(w, "thousand");
+    n %= 1000;
+  }
+  sayBelowThousand(w, n);
+}
+
+// A number starting at p. Returns the bytes consumed.
+static size_t number(TextWriter &w, const char *p)
+{
+  const char *s = p;
+  uint32_t value = 0;
+  int digits = 0;
+  bool grouped = false;
+
+  while (true)
+  {
+    if (isdigit((uint8_t)*s))
+    {
+      if (digits < 9)
+        value = value * 10 + (*s - '0');
+      digits++;
+      s++;
+    }
+    else if (*s == ',' && digits > 0 && isdigit((uint8_t)s[1]) && isdigit((uint8_t)s[2]) &&
+             isdigit((uint8_t)s[3]) && !isdigit((uint8_t)s[4]))
+    {
+      grouped = true; // Thousands separator
+      s++;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  const char *fraction = NULL;
+  if (*s == '.' && isdigit((uint8_t)s[1]))
+  {
+    fraction = s + 1;
+    s++;
+    while (isdigit((uint8_t)*s))
+      s++;
+  }
+
+  bool year = !grouped && !fraction && digits == 4 && value >= 1100 && value < 2100;
+  bool glued = isalpha((uint8_t)*s) || *s == ':' || (digits > 1 && p[0] == '0');
+  if (digits > 6 || year || glued)
+  {
+    // Leave it to the TTS: copy as written, with any letters glued on
+    while (isalnum((uint8_t)*s))
+      s++;
+    char word[32];
+    size_t n = 0;
+    for (const char *c = p; c < s; c++)
+    {
+      if (*c == ',' && grouped)
+        continue;
+      if (n == sizeof(word))
+      {
+        emit(w, word, n);
+        n = 0;
+      }
+      word[n++] = *c;
+    }
+    emit(w, word, n);
+  }
+  else
+  {
+    sayNumber(w, value);
+    if (fraction)
+    {
+      emitWord(w, "point");
+      for (const char *c = fraction; isdigit((uint8_t)*c); c++)
+        emitWord(w, ones[*c - '0']);
+    }
+  }
+
+  if (w.currency)
+  {
+    emitWord(w, w.currency);
+    w.currency = NULL;
+  }
+  return s - p;
+}
+
+// Decode one UTF-8 character, returns its length or 0 if invalid
+static size_t decodeUtf8(const uint8_t *p, uint32_t &cp)
+{
+  size_t n;
+  if (p[0] < 0xC2)
+    return 0; // Continuation byte or overlong lead
+  else if (p[0] < 0xE0)
+    n = 2, cp = p[0] & 0x1F;
+  else if (p[0] < 0xF0)
+    n = 3, cp = p[0] & 0x0F;
+  else if (p[0] < 0xF5)
+    n = 4, cp = p[0] & 0x07;
+  else
+    return 0;
+
+  for (size_t i = 1; i < n; i++)
+  {
+    if ((p[i] & 0xC0) != 0x80)
+      return 0;
+    cp = (cp << 6) | (p[i] & 0x3F);
+  }
+  if ((n == 3 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) || (n == 4 && (cp < 0x10000 || cp > 0x10FFFF)))
+    return 0;
+  return n;
+}
+
+static void unicode(TextWriter &w, const char *p, size_t n, uint32_t cp)
+{
+  switch (cp)
+  {
+  case 0x2018: case 0x2019: case 0x201B: case 0x2032:
+    emitChar(w, '\'');
+    return;
+  case 0x201C: case 0x201D: case 0x2033:
+    emitChar(w, '"');
+    return;
+  case 0x2013: case 0x2014:
+    emitChar(w, ','); // Dash reads as a pause
+    w.pendingSpace = true;
+    return;
+  case 0x2026:
+    emit(w, "...", 3);
+    return;
+  case 0x00B0:
+    emitWord(w, "degrees");
+    return;
+  case 0x20AC:
+    w.currency = "euros";
+    return;
+  case 0x00A3:
+    w.currency = "pounds";
+    return;
+  case 0x00A0: case 0x2022: case 0x00B7:
+    w.pendingSpace = true;
+    return;
+  }
+
+  if ((cp >= 0x2000 && cp <= 0x200F) || cp == 0xFE0F || (cp >= 0x2600 && cp <= 0x27BF) ||
+      (cp >= 0x1F000 && cp <= 0x1FAFF))
+  {
+    return; // Spaces, joiners and emoji
+  }
+  emit(w, p, n);
+}
+
+size_t ttsNormalize(const char *in, char *out, size_t outSize)
+{
+  TextWriter w = {out, outSize ? outSize - 1 : 0, 0, false, NULL};
+  bool lineStart = true;
+  const char *p = in;
+
+  while (*p)
+  {
+    char c = *p;
+
+    if (lineStart)
+    {
+      // Markdown block markers: headings, quotes, bullets
+      if (c == ' ' || c == '\t' || c == '#' || c == '>')
+      {
+        p++;
+        continue;
+      }
+      if ((c == '-' || c == '*' || c == '+') && p[1] == ' ')
+      {
+        p += 2;
+        continue;
+      }
+      lineStart = false;
+    }
+
+    if ((uint8_t)c >= 0x80)
+    {
+      uint32_t cp;
+      size_t n = decodeUtf8((const uint8_t *)p, cp);
+      if (n == 0)
+      {
+        p++; // Invalid byte
+        continue;
+      }
+      unicode(w, p, n, cp);
+      p += n;
+      continue;
+    }
+
+    if (isdigit((uint8_t)c))
+    {
+      p += number(w, p);
+      continue;
+    }
+
+    if (isalpha((uint8_t)c))
+    {
+      // Whole words at a time so a full buffer never cuts one in half,
+      // digits after letters stay part of the word ("mp3")
+      size_t n = 1;
+      while (isalnum((uint8_t)p[n]))
+        n++;
+      emit(w, p, n);
+      p += n;
+      continue;
+    }
+
+    if (c == '\'' || c == '"' || c == ':' || c == ';' || c == '(' || c == ')' ||
+        c == ',' || c == '!' || c == '?')
+    {
+      emitChar(w, c);
+      p++;
+      continue;
+    }
+
+    p++;
+    switch (c)
+    {
+    case '.':
+      emitChar(w, c);
+      break;
+    case '\n':
+      if (w.len > 0 && !isSentenceEnd(lastChar(w)) && !strchr(",;:", lastChar(w)))
+        emitChar(w, '.');
+      w.pendingSpace = true;
+      lineStart = true;
+      break;
+    case '-':
+      if (w.pendingSpace && *p == ' ')
+      {
+        emitChar(w, ','); // " - " reads as a pause
+        w.pendingSpace = true;
+      }
+      else if (isdigit((uint8_t)*p) && (w.pendingSpace || w.len == 0))
+        emitWord(w, "minus");
+      else
+        emitChar(w, '-');
+      break;
+    case '[':
+    case '*':
+    case '`':
+      break;
+    case ']':
+      if (*p == '(')
+      {
+        // Link target is not read out
+        while (*p && *p != ')')
+          p++;
+        if (*p)
+          p++;
+      }
+      break;
+    case '&':
+      emitWord(w, "and");
+      break;
+    case '%':
+      emitWord(w, "percent");
+      break;
+    case '+':
+      emitWord(w, "plus");
+      break;
+    case '=':
+      emitWord(w, "equals");
+      break;
+    case '@':
+      emitWord(w, "at");
+      break;
+    case '#':
+      if (isdigit((uint8_t)*p))
+        emitWord(w, "number");
+      break;
+    case '$':
+      if (isdigit((uint8_t)*p))
+        w.currency = "dollars";
+      break;
+    default:
+      // Whitespace, control characters and the remaining symbols
+      w.pendingSpace = true;
+      break;
+    }
+  }
+
+  if (outSize)
+  {
+    out[w.len] = '\0';
+  }
+  return w.len;
+}
+
+size_t ttsChunk(const char *text, size_t maxLen)
+{
+  size_t len = strlen(text);
+  if (len <= maxLen)
+  {
+    return len;
+  }
+
+  size_t sentence = 0, clause = 0, word = 0;
+  for (size_t i = 1; i < maxLen; i++)
+  {
+    if (text[i] != ' ')
+      continue;
+    word = i;
+    if (isSentenceEnd(text[i - 1]))
+      sentence = i;
+    else if (strchr(",;:", text[i - 1]))
+      clause = i;
+  }
+
+  if (sentence)
+    return sentence;
+  if (clause)
+    return clause;
+  if (word)
+    return word;
+
+  size_t cut = maxLen;
+  while (cut > 0 && ((uint8_t)text[cut] & 0xC0) == 0x80)
+    cut--; // Never split a UTF-8 character
+  return cut;
+}
@@ -0,0 +1,206 @@
+#include "turn_scheduler.h"
+#include "mem_telemetry.h"
+#include "cores.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Hedged and background requests run as tasks, so they live apart from the
+// budget and connect code, which also builds on the host for
+// test/test_turn_scheduler
+
+// Shared by the caller and both request tasks, freed by whoever leaves last
+struct HedgeRace
+{
+  HedgedRequest fn;
+  HedgeRelease release;
+  void *ctx[2];
+  uint32_t deadline;
+  SemaphoreHandle_t finished;
+  portMUX_TYPE lock;
+  int refs;
+  int winner;  // -1 until a request succeeds
+  int running; // Requests still in flight
+};
+
+static void hedgeUnref(HedgeRace *race)
+{
+  portENTER_CRITICAL(&race->lock);
+  int refs = --race->refs;
+  portEXIT_CRITICAL(&race->lock);
+  if (refs > 0)
+  {
+    return;
+  }
+  race->release(race->ctx[0]);
+  if (race->ctx[1])
+    race->release(race->ctx[1]);
+  vSemaphoreDelete(race->finished);
+  delete race;
+}
+
+struct HedgeTaskArgs
+{
+  HedgeRace *race;
+  int index;
+};
+
+static void hedgeTask(void *param)
+{
+  HedgeTaskArgs *args = (HedgeTaskArgs *)param;
+  HedgeRace *race = args->race;
+  int index = args->index;
+  delete args;
+
+  bool ok = race->fn(race->ctx[index], race->deadline);
+
+  portENTER_CRITICAL(&race->lock);
+  if (ok && race->winner < 0)
+    race->winner = index;
+  race->running--;
+  bool wake = ok || race->running == 0;
+  portEXIT_CRITICAL(&race->lock);
+
+  if (wake)
+    xSemaphoreGive(race->finished);
+  hedgeUnref(race);
+  memSample("hedge task");
+  vTaskDelete(NULL);
+}
+
+static bool hedgeStart(HedgeRace *race, int index)
+{
+  HedgeTaskArgs *args = new HedgeTaskArgs{race, index};
+  portENTER_CRITICAL(&race->lock);
+  race->refs++;
+  race->running++;
+  portEXIT_CRITICAL(&race->lock);
+
+  // TLS plus HTTPClient needs a big stack
+  if (netTaskCreate(hedgeTask, index ? "hedge" : "primary", 12288, args, 1) != pdPASS)
+  {
+    delete args;
+    portENTER_CRITICAL(&race->lock);
+    race->refs--;
+    race->running--;
+    portEXIT_CRITICAL(&race->lock);
+    return false;
+  }
+  return true;
+}
+
+static HedgeRace *raceNew(HedgedRequest fn, void *primary, void *hedge, HedgeRelease release, uint32_t deadline)
+{
+  HedgeRace *race = new HedgeRace;
+  race->fn = fn;
+  race->release = release;
+  race->ctx[0] = primary;
+  race->ctx[1] = hedge;
+  race->deadline = deadline;
+  race->finished = xSemaphoreCreateBinary();
+  portMUX_INITIALIZE(&race->lock);
+  race->refs = 1; // The caller
+  race->winner = -1;
+  race->running = 0;
+  return race;
+}
+
+void *hedgedCall(HedgedRequest fn, void *primary, void *hedge, HedgeRelease release,
+                 uint32_t hedgeAfterMs, uint32_t deadline, HedgeRace **racePtr)
+{
+  HedgeRace *race = raceNew(fn, primary, hedge, release, deadline);
+  *racePtr = race;
+
+  if (!hedgeStart(race, 0))
+  {
+    return NULL;
+  }
+
+  bool hedged = false;
+  while (true)
+  {
+    uint32_t wait = msUntil(deadline);
+    if (!hedged && hedgeAfterMs > 0)
+    {
+      wait = min(wait, hedgeAfterMs);
+    }
+
+    bool signalled = xSemaphoreTake(race->finished, pdMS_TO_TICKS(wait)) == pdTRUE;
+
+    portENTER_CRITICAL(&race->lock);
+    int winner = race->winner;
+    int running = race->running;
+    portEXIT_CRITICAL(&race->lock);
+
+    if (winner >= 0)
+    {
+      if (hedged)
+        Serial.printf("Hedged request: %s request won\n", winner ? "duplicate" : "primary");
+      return race->ctx[winner];
+    }
+    if (msUntil(deadline) == 0 || (signalled && running == 0 && hedged))
+    {
+      return NULL;
+    }
+    if (!hedged && (!signalled || running == 0) && hedgeAfterMs > 0)
+    {
+      // Primary is slower than p95 (or already failed), race a duplicate
+      Serial.println("Request slower than p95, sending hedged duplicate");
+      hedged = hedgeStart(race, 1);
+      if (!hedged && running == 0)
+        return NULL;
+      continue;
+    }
+    if (running == 0)
+    {
+      return NULL;
+    }
+  }
+}
+
+void hedgeDone(HedgeRace *race)
+{
+  if (race)
+  {
+    hedgeUnref(race);
+  }
+}
+
+HedgeRace *backgroundStart(HedgedRequest fn, void *ctx, HedgeRelease release, uint32_t deadline)
+{
+  HedgeRace *race = raceNew(fn, ctx, NULL, release, deadline);
+  if (!hedgeStart(race, 0))
+  {
+    hedgeUnref(race);
+    return NULL;
+  }
+  return race;
+}
+
+void *backgroundWait(HedgeRace *race, uint32_t deadline)
+{
+  while (true)
+  {
+    portENTER_CRITICAL(&race->lock);
+    int winner = race->winner;
+    int running = race->running;
+    portEXIT_CRITICAL(&race->lock);
+
+    if (winner >= 0)
+    {
+      return race->ctx[winner];
+    }
+    if (running == 0 || msUntil(deadline) == 0)
+    {
+      return NULL;
+    }
+    xSemaphoreTake(race->finished, pdMS_TO_TICKS(msUntil(deadline)));
+  }
+}
+
+bool backgroundDone(HedgeRace *race)
+{
+  portENTER_CRITICAL(&race->lock);
+  int running = race->running;
+  portEXIT_CRITICAL(&race->lock);
+  return running == 0;
+}
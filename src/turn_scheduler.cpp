@@ -0,0 +1,163 @@
+#include "turn_scheduler.h"
+#include "mem_telemetry.h"
+#include <algorithm>
+
+// Relative share of the turn budget per stage
+static const uint8_t stageWeight[STAGE_COUNT] = {40, 35, 25};
+static const char *const stageNames[STAGE_COUNT] = {"STT", "LLM", "TTS"};
+static const char *const stageBeginPoints[STAGE_COUNT] = {"stt begin", "llm begin", "tts begin"};
+static const char *const stageEndPoints[STAGE_COUNT] = {"stt end", "llm end", "tts end"};
+
+struct StageStats
+{
+  uint32_t samples[STAGE_HISTORY];
+  uint8_t count;
+  uint8_t next;
+  uint32_t started;
+  uint32_t deadline;
+  uint32_t elapsed; // This turn, 0 if the stage did not run
+  bool ok;
+};
+
+static StageStats stages[STAGE_COUNT];
+static uint32_t turnStart = 0;
+static uint32_t turnBudget = TURN_BUDGET_MS;
+
+void turnBegin(uint32_t budgetMs)
+{
+  turnStart = millis();
+  turnBudget = budgetMs;
+  for (int i = 0; i < STAGE_COUNT; i++)
+  {
+    stages[i].elapsed = 0;
+    stages[i].deadline = 0;
+  }
+}
+
+uint32_t msUntil(uint32_t deadline)
+{
+  int32_t left = (int32_t)(deadline - millis());
+  return left > 0 ? left : 0;
+}
+
+uint32_t stageBegin(TurnStage stage)
+{
+  uint32_t now = millis();
+  uint32_t used = now - turnStart;
+  uint32_t remaining = used < turnBudget ? turnBudget - used : 0;
+
+  uint32_t weightLeft = 0;
+  for (int i = stage; i < STAGE_COUNT; i++)
+  {
+    weightLeft += stageWeight[i];
+  }
+
+  memSample(stageBeginPoints[stage]);
+
+  StageStats &s = stages[stage];
+  s.started = now;
+  s.deadline = now + remaining * stageWeight[stage] / weightLeft;
+  return s.deadline;
+}
+
+uint32_t stageDeadline(TurnStage stage)
+{
+  return stages[stage].deadline;
+}
+
+void stageEnd(TurnStage stage, bool ok)
+{
+  memSample(stageEndPoints[stage]);
+
+  StageStats &s = stages[stage];
+  s.elapsed = millis() - s.started;
+  s.ok = ok;
+  if (!ok)
+  {
+    return; // Failures would skew the p95 towards the timeout
+  }
+  s.samples[s.next] = s.elapsed;
+  s.next = (s.next + 1) % STAGE_HISTORY;
+  if (s.count < STAGE_HISTORY)
+    s.count++;
+}
+
+uint32_t stageP95(TurnStage stage)
+{
+  const StageStats &s = stages[stage];
+  if (s.count < STAGE_MIN_SAMPLES)
+  {
+    return 0;
+  }
+
+  uint32_t sorted[STAGE_HISTORY];
+  memcpy(sorted, s.samples, s.count * sizeof(uint32_t));
+  std::sort(sorted, sorted + s.count);
+  return sorted[(s.count * 95 + 99) / 100 - 1];
+}
+
+uint32_t stageElapsed(TurnStage stage)
+{
+  return stages[stage].deadline ? stages[stage].elapsed : 0;
+}
+
+bool stageOk(TurnStage stage)
+{
+  return stages[stage].deadline && stages[stage].ok;
+}
+
+void turnReport()
+{
+  Serial.printf("=> Turn: %lu ms of %lu ms budget\n", millis() - turnStart, turnBudget);
+  for (int i = 0; i < STAGE_COUNT; i++)
+  {
+    const StageStats &s = stages[i];
+    if (s.deadline == 0)
+      continue;
+    Serial.printf("   %s: %5lu ms, budget %5lu ms, p95 %5lu ms %s\n", stageNames[i], s.elapsed,
+                  s.deadline - s.started, stageP95((TurnStage)i), s.ok ? "" : "(failed)");
+  }
+}
+
+// WiFiClientSecure::connect hides WiFiClient::connect instead of overriding
+// it, so both client types get their own instance
+template <typename Client>
+static bool connectLoop(Client &client, const char *host, uint16_t port, uint32_t deadline)
+{
+  for (int attempt = 0; attempt < CONNECT_RETRIES; attempt++)
+  {
+    uint32_t left = msUntil(deadline);
+    if (left == 0)
+    {
+      break;
+    }
+
+    if (client.connect(host, port, min(left, (uint32_t)CONNECT_TIMEOUT_MS)))
+    {
+      return true;
+    }
+    client.stop();
+
+    // Full jitter: sleep a random part of the doubled backoff window
+    uint32_t window = CONNECT_BACKOFF_MS << attempt;
+    uint32_t backoff = random(window / 4, window);
+    if (attempt + 1 >= CONNECT_RETRIES || backoff >= msUntil(deadline))
+    {
+      break;
+    }
+    Serial.printf("Connect to %s failed (attempt %d), retrying in %lu ms\n", host, attempt + 1, backoff);
+    delay(backoff);
+  }
+  Serial.printf("Connect to %s failed\n", host);
+  return false;
+}
+
+bool connectWithRetry(WiFiClientSecure &client, const char *host, uint16_t port, uint32_t deadline)
+{
+  return connectLoop(client, host, port, deadline);
+}
+
+bool connectWithRetry(WiFiClient &client, const char *host, uint16_t port, uint32_t deadline)
+{
+  return connectLoop(client, host, port, deadline);
+}
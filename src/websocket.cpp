@@ -0,0 +1,326 @@
+#include "websocket.h"
+#include "turn_scheduler.h"
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+static void base64Encode(const uint8_t *in, size_t len, char *out)
+{
+  static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t v = in[i] << 16;
+    if (i + 1 < len)
+      v |= in[i + 1] << 8;
+    if (i + 2 < len)
+      v |= in[i + 2];
+    out[o++] = table[(v >> 18) & 0x3F];
+    out[o++] = table[(v >> 12) & 0x3F];
+    out[o++] = i + 1 < len ? table[(v >> 6) & 0x3F] : '=';
+    out[o++] = i + 2 < len ? table[v & 0x3F] : '=';
+  }
+  out[o] = '\0';
+}
+
+static void frameReset(WsClient &ws)
+{
+  ws.headerLen = 0;
+  ws.headerNeed = 2;
+}
+
+static bool sendFrame(WsClient &ws, uint8_t opcode, const uint8_t *data, size_t len)
+{
+  if (!ws.open)
+  {
+    return false;
+  }
+
+  uint8_t out[14 + WS_SEND_CHUNK];
+  size_t n = 0;
+  out[n++] = 0x80 | opcode; // FIN, never fragmented
+  if (len < 126)
+  {
+    out[n++] = 0x80 | len;
+  }
+  else if (len < 65536)
+  {
+    out[n++] = 0x80 | 126;
+    out[n++] = len >> 8;
+    out[n++] = len;
+  }
+  else
+  {
+    out[n++] = 0x80 | 127;
+    for (int i = 7; i >= 0; i--)
+      out[n++] = i < 4 ? (uint8_t)(len >> (i * 8)) : 0;
+  }
+
+  // Client frames must be masked
+  uint32_t key = esp_random();
+  uint8_t mask[4] = {(uint8_t)(key >> 24), (uint8_t)(key >> 16), (uint8_t)(key >> 8), (uint8_t)key};
+  memcpy(out + n, mask, 4);
+  n += 4;
+
+  // Header goes out with the first chunk of payload
+  size_t sent = 0;
+  do
+  {
+    size_t chunk = min(len - sent, (size_t)WS_SEND_CHUNK);
+    for (size_t i = 0; i < chunk; i++)
+    {
+      out[n + i] = data[sent + i] ^ mask[(sent + i) & 3];
+    }
+    if (ws.tcp->write(out, n + chunk) != n + chunk)
+    {
+      ws.open = false;
+      return false;
+    }
+    sent += chunk;
+    n = 0;
+  } while (sent < len);
+  return true;
+}
+
+static void frameStart(WsClient &ws)
+{
+  ws.fin = ws.header[0] & 0x80;
+  ws.opcode = ws.header[0] & 0x0F;
+  uint8_t len7 = ws.header[1] & 0x7F;
+
+  if (ws.header[1] & 0x80)
+  {
+    ws.open = false; // Servers must not mask
+    return;
+  }
+  if (len7 == 126)
+  {
+    ws.remaining = (ws.header[2] << 8) | ws.header[3];
+  }
+  else if (len7 == 127)
+  {
+    ws.remaining = ((uint32_t)ws.header[6] << 24) | ((uint32_t)ws.header[7] << 16) | (ws.header[8] << 8) | ws.header[9];
+    if (ws.header[2] | ws.header[3] | ws.header[4] | ws.header[5])
+      ws.open = false; // Over 4 GB
+  }
+  else
+  {
+    ws.remaining = len7;
+  }
+
+  if (ws.opcode >= WS_OP_CLOSE)
+  {
+    ws.controlLen = 0;
+    if (ws.remaining > sizeof(ws.control))
+      ws.open = false;
+  }
+  else if (ws.opcode != WS_OP_CONTINUATION)
+  {
+    ws.messageOpcode = ws.opcode;
+    ws.messageLen = 0;
+    ws.oversize = false;
+  }
+}
+
+static void framePayload(WsClient &ws, const uint8_t *data, size_t len)
+{
+  if (ws.opcode >= WS_OP_CLOSE)
+  {
+    memcpy(ws.control + ws.controlLen, data, len);
+    ws.controlLen += len;
+  }
+  else if (ws.messageLen + len > WS_MAX_MESSAGE)
+  {
+    ws.oversize = true;
+  }
+  else
+  {
+    memcpy(ws.message + ws.messageLen, data, len);
+    ws.messageLen += len;
+  }
+}
+
+static void frameEnd(WsClient &ws)
+{
+  switch (ws.opcode)
+  {
+  case WS_OP_PING:
+    sendFrame(ws, WS_OP_PONG, ws.control, ws.controlLen);
+    break;
+  case WS_OP_CLOSE:
+    sendFrame(ws, WS_OP_CLOSE, ws.control, min((int)ws.controlLen, 2)); // Echo the status code
+    ws.open = false;
+    break;
+  case WS_OP_PONG:
+    break;
+  default:
+    if (ws.fin && ws.messageOpcode == WS_OP_TEXT)
+    {
+      if (ws.oversize)
+      {
+        Serial.printf("WebSocket: message over %d bytes skipped\n", WS_MAX_MESSAGE);
+      }
+      else if (ws.onText)
+      {
+        ws.message[ws.messageLen] = '\0';
+        ws.onText(ws.ctx, ws.message, ws.messageLen);
+      }
+    }
+    break;
+  }
+  frameReset(ws);
+}
+
+static void wsFeed(WsClient &ws, const uint8_t *data, size_t len)
+{
+  while (len > 0 && ws.open)
+  {
+    if (ws.headerLen < ws.headerNeed)
+    {
+      ws.header[ws.headerLen++] = *data++;
+      len--;
+      if (ws.headerLen == 2)
+      {
+        uint8_t len7 = ws.header[1] & 0x7F;
+        ws.headerNeed = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + ((ws.header[1] & 0x80) ? 4 : 0);
+      }
+      if (ws.headerLen == ws.headerNeed)
+      {
+        frameStart(ws);
+        if (ws.remaining == 0 && ws.open)
+          frameEnd(ws);
+      }
+      continue;
+    }
+
+    size_t n = min(len, (size_t)ws.remaining);
+    framePayload(ws, data, n);
+    data += n;
+    len -= n;
+    ws.remaining -= n;
+    if (ws.remaining == 0)
+      frameEnd(ws);
+  }
+}
+
+static void wsReset(WsClient &ws, WiFiClient &tcp, WsTextCallback onText, void *ctx)
+{
+  ws.tcp = &tcp;
+  ws.open = false;
+  ws.onText = onText;
+  ws.ctx = ctx;
+  httpCarryReset(ws.carry);
+  frameReset(ws);
+}
+
+// Send the upgrade request on a connected client and read the 101
+static bool wsUpgrade(WsClient &ws, WiFiClient &tcp, const char *host, const char *path, const char *headers,
+                      uint32_t deadline)
+{
+  uint8_t nonce[16];
+  for (int i = 0; i < 16; i += 4)
+  {
+    uint32_t r = esp_random();
+    memcpy(nonce + i, &r, 4);
+  }
+  char key[25];
+  base64Encode(nonce, sizeof(nonce), key);
+
+  // One write for the whole upgrade request
+  char request[512];
+  int n = snprintf(request, sizeof(request),
+                   "GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                   "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n%s\r\n",
+                   path, host, key, headers ? headers : "");
+  if (n >= (int)sizeof(request) || tcp.write((const uint8_t *)request, n) != (size_t)n)
+  {
+    tcp.stop();
+    return false;
+  }
+
+  // A 101 is taken as the upgrade, the Sec-WebSocket-Accept hash is not checked
+  HttpResponse http;
+  httpResponseInit(http);
+  if (!httpReadResponse(tcp, http, msUntil(deadline), &ws.carry) || http.status != 101)
+  {
+    Serial.printf("WebSocket upgrade to %s failed: HTTP %d\n", host, http.status);
+    tcp.stop();
+    return false;
+  }
+  ws.open = true;
+  return true;
+}
+
+bool wsConnect(WsClient &ws, WiFiClientSecure &tcp, const char *host, uint16_t port, const char *path,
+               const char *headers, WsTextCallback onText, void *ctx, uint32_t deadline)
+{
+  wsReset(ws, tcp, onText, ctx);
+  return connectWithRetry(tcp, host, port, deadline) && wsUpgrade(ws, tcp, host, path, headers, deadline);
+}
+
+bool wsConnect(WsClient &ws, WiFiClient &tcp, const char *host, uint16_t port, const char *path,
+               const char *headers, WsTextCallback onText, void *ctx, uint32_t deadline)
+{
+  wsReset(ws, tcp, onText, ctx);
+  return connectWithRetry(tcp, host, port, deadline) && wsUpgrade(ws, tcp, host, path, headers, deadline);
+}
+
+bool wsSendBinary(WsClient &ws, const uint8_t *data, size_t len)
+{
+  return sendFrame(ws, WS_OP_BINARY, data, len);
+}
+
+bool wsSendText(WsClient &ws, const char *text)
+{
+  return sendFrame(ws, WS_OP_TEXT, (const uint8_t *)text, strlen(text));
+}
+
+bool wsPoll(WsClient &ws)
+{
+  if (ws.carry.pos < ws.carry.len)
+  {
+    size_t pos = ws.carry.pos;
+    ws.carry.pos = ws.carry.len;
+    wsFeed(ws, ws.carry.data + pos, ws.carry.len - pos);
+  }
+
+  uint8_t buffer[HTTP_READ_CHUNK];
+  while (ws.open)
+  {
+    int available = ws.tcp->available();
+    if (available <= 0)
+    {
+      if (!ws.tcp->connected())
+        ws.open = false;
+      break;
+    }
+    int n = ws.tcp->read(buffer, min((size_t)available, sizeof(buffer)));
+    if (n <= 0)
+      break;
+    wsFeed(ws, buffer, n);
+  }
+
+  if (!ws.open)
+  {
+    ws.tcp->stop();
+  }
+  return ws.open;
+}
+
+void wsClose(WsClient &ws)
+{
+  if (ws.open)
+  {
+    static const uint8_t normal[] = {0x03, 0xE8}; // 1000, normal closure
+    sendFrame(ws, WS_OP_CLOSE, normal, sizeof(normal));
+    ws.open = false;
+  }
+  if (ws.tcp)
+  {
+    ws.tcp->stop();
+  }
+}
@@ -0,0 +1,201 @@
+#include "wifi_manager.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+static const char *wifiSsid = NULL;
+static const char *wifiPassword = NULL;
+static WifiState state = WIFI_STATE_IDLE;
+
+// Set from the Wi-Fi event task, handled in wifiPoll()
+static volatile bool gotIp = false;
+static volatile bool lost = false;
+static volatile uint8_t lostReason = 0;
+
+static uint32_t attemptStart = 0;
+static uint32_t retryAt = 0;
+static uint32_t backoff = WIFI_BACKOFF_MIN_MS;
+static uint32_t connects = 0;
+static uint32_t drops = 0;
+
+static bool useCache = false;
+static uint8_t cachedChannel = 0;
+static uint8_t cachedBssid[6];
+
+static void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info)
+{
+  switch (event)
+  {
+  case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+    gotIp = true;
+    break;
+  case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    lostReason = info.wifi_sta_disconnected.reason;
+    lost = true;
+    break;
+  default:
+    break;
+  }
+}
+
+static void loadCache()
+{
+  Preferences prefs;
+  prefs.begin("wifi", true);
+  cachedChannel = prefs.getUChar("channel", 0);
+  useCache = cachedChannel != 0 && prefs.getBytes("bssid", cachedBssid, sizeof(cachedBssid)) == sizeof(cachedBssid);
+  prefs.end();
+}
+
+// Only written when the AP changed, to spare the flash
+static void saveCache()
+{
+  uint8_t channel = WiFi.channel();
+  uint8_t *bssid = WiFi.BSSID();
+  if (!bssid || (channel == cachedChannel && memcmp(bssid, cachedBssid, sizeof(cachedBssid)) == 0))
+  {
+    return;
+  }
+
+  Preferences prefs;
+  prefs.begin("wifi", false);
+  prefs.putUChar("channel", channel);
+  prefs.putBytes("bssid", bssid, sizeof(cachedBssid));
+  prefs.end();
+  cachedChannel = channel;
+  memcpy(cachedBssid, bssid, sizeof(cachedBssid));
+}
+
+static void dropCache()
+{
+  Preferences prefs;
+  prefs.begin("wifi", false);
+  prefs.clear();
+  prefs.end();
+  cachedChannel = 0;
+  useCache = false;
+}
+
+static void startAttempt()
+{
+  state = WIFI_STATE_CONNECTING;
+  attemptStart = millis();
+  if (useCache)
+  {
+    WiFi.begin(wifiSsid, wifiPassword, cachedChannel, cachedBssid);
+  }
+  else
+  {
+    WiFi.begin(wifiSsid, wifiPassword);
+  }
+}
+
+static void scheduleRetry()
+{
+  // Random wait in the upper half of the window, so devices spread out
+  uint32_t wait = random(backoff / 2, backoff + 1);
+  state = WIFI_STATE_BACKOFF;
+  retryAt = millis() + wait;
+  backoff = min(backoff * 2, (uint32_t)WIFI_BACKOFF_MAX_MS);
+  Serial.printf("WiFi: retrying in %lu ms\n", wait);
+}
+
+void wifiBegin(const char *ssid, const char *password)
+{
+  wifiSsid = ssid;
+  wifiPassword = password;
+
+  WiFi.mode(WIFI_STA);
+  WiFi.persistent(false);       // Our own cache, no driver writes to flash
+  WiFi.setAutoReconnect(false); // Reconnects go through our backoff
+  WiFi.onEvent(onWifiEvent);
+
+  loadCache();
+  Serial.printf("WiFi: connecting to %s %s\n", ssid, useCache ? "(cached channel/BSSID)" : "(full scan)");
+  startAttempt();
+}
+
+void wifiPoll()
+{
+  if (gotIp)
+  {
+    gotIp = false;
+    if (state != WIFI_STATE_CONNECTED)
+    {
+      state = WIFI_STATE_CONNECTED;
+      backoff = WIFI_BACKOFF_MIN_MS;
+      connects++;
+      Serial.printf("WiFi connected in %lu ms, channel %ld, RSSI %ld dBm, IP %s\n", millis() - attemptStart,
+                    (long)WiFi.channel(), (long)WiFi.RSSI(), WiFi.localIP().toString().c_str());
+      saveCache();
+      useCache = true;
+    }
+  }
+
+  if (lost)
+  {
+    lost = false;
+    // Disconnects we caused ourselves while backing off are ignored
+    if (state == WIFI_STATE_CONNECTED)
+    {
+      drops++;
+      Serial.printf("WiFi lost (reason %u)\n", lostReason);
+      scheduleRetry();
+    }
+    else if (state == WIFI_STATE_CONNECTING)
+    {
+      Serial.printf("WiFi connect failed (reason %u)\n", lostReason);
+      if (useCache)
+      {
+        dropCache(); // AP moved or is gone, scan next time
+      }
+      scheduleRetry();
+    }
+  }
+
+  if (state == WIFI_STATE_CONNECTING && millis() - attemptStart > WIFI_ATTEMPT_TIMEOUT_MS)
+  {
+    Serial.println("WiFi connect timed out");
+    if (useCache)
+    {
+      dropCache(); // A stale channel/BSSID can hang instead of failing
+    }
+    scheduleRetry();
+    WiFi.disconnect();
+  }
+  else if (state == WIFI_STATE_BACKOFF && (int32_t)(millis() - retryAt) >= 0)
+  {
+    startAttempt();
+  }
+}
+
+WifiState wifiState()
+{
+  return state;
+}
+
+bool wifiConnected()
+{
+  return state == WIFI_STATE_CONNECTED && WiFi.status() == WL_CONNECTED;
+}
+
+bool wifiWaitConnected(uint32_t timeoutMs)
+{
+  uint32_t start = millis();
+  while (!wifiConnected() && state != WIFI_STATE_IDLE && millis() - start < timeoutMs)
+  {
+    delay(10);
+    wifiPoll();
+  }
+  return wifiConnected();
+}
+
+void wifiReport()
+{
+  static const char *const names[] = {"idle", "connecting", "connected", "backoff"};
+  Serial.printf("WiFi: %s, %lu connects, %lu drops", names[state], connects, drops);
+  if (wifiConnected())
+  {
+    Serial.printf(", channel %ld, RSSI %ld dBm", (long)WiFi.channel(), (long)WiFi.RSSI());
+  }
+  Serial.println();
+}
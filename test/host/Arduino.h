@@ -0,0 +1,93 @@
+#pragma once
+
+// The few Arduino core calls the hardware-free modules use, so that they
+// build on the host for `pio test -e native`. Not a simulator: there is no
+// GPIO, I2S or Wi-Fi here, and SD.h keeps its files in memory.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+
+using std::max;
+using std::min;
+
+// Tests that simulate minutes of outages and backoff switch the clock to
+// manual: then it only moves with delay() and hostClockAdvance()
+struct HostClock
+{
+  bool manual;
+  uint64_t us;
+};
+
+inline HostClock hostClock;
+
+inline void hostClockManual(bool manual)
+{
+  hostClock.manual = manual;
+}
+
+inline void hostClockAdvance(uint32_t ms)
+{
+  hostClock.us += ms * 1000ULL;
+}
+
+inline uint32_t micros()
+{
+  if (hostClock.manual)
+  {
+    return (uint32_t)hostClock.us;
+  }
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+inline uint32_t millis()
+{
+  return hostClock.manual ? (uint32_t)(hostClock.us / 1000) : micros() / 1000;
+}
+
+inline void delay(uint32_t ms)
+{
+  if (hostClock.manual)
+  {
+    hostClockAdvance(ms);
+    return;
+  }
+  timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+inline long random(long howBig)
+{
+  return howBig > 0 ? rand() % howBig : 0;
+}
+
+inline long random(long howSmall, long howBig)
+{
+  return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+struct HostSerial
+{
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n;
+  }
+  void print(const char *s) { fputs(s, stdout); }
+  void println(const char *s = "") { puts(s); }
+};
+
+inline HostSerial Serial;
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// An in-memory SD card with the FS calls the modules make. Directories
+// list in reverse name order, since FAT order is not name order either.
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+struct HostSd
+{
+  std::map<std::string, std::string> files; // Full path -> contents
+  std::set<std::string> dirs = {"/"};
+};
+
+inline HostSd hostSd;
+
+inline void hostSdClear()
+{
+  hostSd = HostSd();
+}
+
+class File
+{
+public:
+  File() {}
+  File(const std::string &path, bool dir) : path(path), dir(dir), valid(true)
+  {
+    if (!dir)
+      return;
+    std::string prefix = path == "/" ? "/" : path + "/";
+    for (const auto &f : hostSd.files)
+    {
+      if (f.first.compare(0, prefix.size(), prefix) == 0 && f.first.find('/', prefix.size()) == std::string::npos)
+        children.insert(children.begin(), f.first);
+    }
+  }
+
+  explicit operator bool() const { return valid; }
+  const char *name() const
+  {
+    size_t slash = path.rfind('/');
+    return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  }
+  bool isDirectory() const { return dir; }
+  size_t size() const { return dir ? 0 : hostSd.files[path].size(); }
+
+  File openNextFile()
+  {
+    while (next < children.size())
+    {
+      const std::string &child = children[next++];
+      if (hostSd.files.count(child))
+        return File(child, false);
+    }
+    return File();
+  }
+
+  size_t write(const uint8_t *buf, size_t size)
+  {
+    if (!valid || dir)
+      return 0;
+    hostSd.files[path].append((const char *)buf, size);
+    return size;
+  }
+  int read(uint8_t *buf, size_t size)
+  {
+    if (!valid || dir)
+      return -1;
+    const std::string &data = hostSd.files[path];
+    size_t n = min(size, data.size() - min(pos, data.size()));
+    memcpy(buf, data.data() + pos, n);
+    pos += n;
+    return (int)n;
+  }
+  int available() { return valid && !dir ? (int)(hostSd.files[path].size() - pos) : 0; }
+  void close() { valid = false; }
+
+private:
+  std::string path;
+  bool dir = false;
+  bool valid = false;
+  std::vector<std::string> children;
+  size_t next = 0;
+  size_t pos = 0;
+};
+
+class HostSdFs
+{
+public:
+  bool exists(const String &path) { return hostSd.files.count(path.c_str()) || hostSd.dirs.count(path.c_str()); }
+  bool mkdir(const String &path) { return hostSd.dirs.insert(path.c_str()).second; }
+  bool remove(const String &path) { return hostSd.files.erase(path.c_str()) > 0; }
+
+  bool rename(const String &from, const String &to)
+  {
+    auto f = hostSd.files.find(from.c_str());
+    if (f == hostSd.files.end() || exists(to))
+      return false;
+    hostSd.files[to.c_str()] = f->second;
+    hostSd.files.erase(f);
+    return true;
+  }
+
+  File open(const String &path, const char *mode = FILE_READ)
+  {
+    if (hostSd.dirs.count(path.c_str()))
+      return File(path.c_str(), true);
+    if (mode[0] == 'w')
+      hostSd.files[path.c_str()].clear();
+    else if (mode[0] == 'a')
+      hostSd.files[path.c_str()];
+    else if (!hostSd.files.count(path.c_str()))
+      return File();
+    return File(path.c_str(), false);
+  }
+};
+
+inline HostSdFs SD;
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+
+// The Arduino String calls the modules make, on top of std::string
+class String
+{
+public:
+  String() {}
+  String(const char *s) : s(s ? s : "") {}
+  String(char c) : s(1, c) {}
+  String(const std::string &s) : s(s) {}
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  bool reserve(unsigned int size)
+  {
+    s.reserve(size);
+    return true;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const
+  {
+    size_t i = s.find(c, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned int from) const { return from < s.size() ? s.substr(from) : std::string(); }
+  String substring(unsigned int from, unsigned int to) const
+  {
+    return from < to && from < s.size() ? s.substr(from, to - from) : std::string();
+  }
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const
+  {
+    return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+
+  String &operator+=(const String &rhs)
+  {
+    s += rhs.s;
+    return *this;
+  }
+  String &operator+=(const char *rhs)
+  {
+    s += rhs;
+    return *this;
+  }
+  String &operator+=(char c)
+  {
+    s += c;
+    return *this;
+  }
+
+  friend String operator+(const String &a, const String &b) { return a.s + b.s; }
+  friend String operator+(const String &a, const char *b) { return a.s + b; }
+  friend String operator+(const char *a, const String &b) { return a + b.s; }
+  friend bool operator==(const String &a, const String &b) { return a.s == b.s; }
+  friend bool operator!=(const String &a, const String &b) { return a.s != b.s; }
+  friend bool operator<(const String &a, const String &b) { return a.s < b.s; }
+
+private:
+  std::string s;
+};
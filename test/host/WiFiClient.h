@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The ESP32 WiFiClient calls the modules make, for a scripted server in a
+// test. fd() < 0 makes httpReadResponse() poll instead of select() on a
+// socket.
+class WiFiClient
+{
+public:
+  virtual ~WiFiClient() {}
+  virtual int connect(const char *host, uint16_t port, int32_t timeout) { return 0; }
+  virtual void stop() {}
+  virtual size_t write(const uint8_t *buf, size_t size) { return 0; }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  virtual int available() { return 0; }
+  virtual int read(uint8_t *buf, size_t size) { return 0; }
+  virtual uint8_t connected() { return 0; }
+  virtual int fd() const { return -1; }
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <WiFiClient.h>
+
+// No TLS on the host, the scripted server sees the plain requests
+class WiFiClientSecure : public WiFiClient
+{
+public:
+  void setInsecure() {}
+};
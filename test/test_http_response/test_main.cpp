@@ -0,0 +1,237 @@
+// Host tests for the incremental HTTP response parser: every body framing,
+// any split of the input, pipelined responses and httpReadResponse() over
+// a scripted client. pio test -e native -f test_http_response
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include "http_response.h"
+
+static HttpResponse r;
+static std::string body;
+
+static bool collect(void *ctx, const uint8_t *data, size_t len)
+{
+  ((std::string *)ctx)->append((const char *)data, len);
+  return true;
+}
+
+static bool refuse(void *ctx, const uint8_t *data, size_t len)
+{
+  return false;
+}
+
+// Feed the whole message in pieces of the given size, returns bytes used
+static size_t feed(const char *message, size_t piece)
+{
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  size_t len = strlen(message), used = 0;
+  for (size_t pos = 0; pos < len && !httpResponseDone(r) && !httpResponseFailed(r); pos += piece)
+  {
+    size_t n = min(piece, len - pos);
+    used += httpResponseFeed(r, (const uint8_t *)message + pos, n);
+  }
+  return used;
+}
+
+// Serves a script of reads; connected() turns false once it is used up
+class ScriptedClient : public WiFiClient
+{
+public:
+  ScriptedClient(const char *data, size_t readSize, bool closeAtEnd = true)
+      : data(data), len(strlen(data)), readSize(readSize), closeAtEnd(closeAtEnd)
+  {
+  }
+  int available() override { return (int)min(readSize, len - pos); }
+  int read(uint8_t *buf, size_t size) override
+  {
+    size_t n = min(size, (size_t)available());
+    memcpy(buf, data + pos, n);
+    pos += n;
+    return (int)n;
+  }
+  uint8_t connected() override { return pos < len || !closeAtEnd; }
+
+  const char *data;
+  size_t len;
+  size_t readSize;
+  bool closeAtEnd;
+  size_t pos = 0;
+};
+
+static const char *const contentLength = "HTTP/1.1 200 OK\r\n"
+                                         "Content-Type: application/json; charset=utf-8\r\n"
+                                         "Content-Length: 13\r\n"
+                                         "\r\n"
+                                         "{\"text\":\"hi\"}";
+
+static const char *const chunked = "HTTP/1.1 200 OK\r\n"
+                                   "transfer-encoding: chunked\r\n"
+                                   "\r\n"
+                                   "5;ext=1\r\nHello\r\n"
+                                   "7\r\n, world\r\n"
+                                   "0\r\n"
+                                   "X-Trailer: 1\r\n"
+                                   "\r\n";
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_content_length_body(void)
+{
+  size_t len = strlen(contentLength);
+  for (size_t piece = 1; piece <= len; piece++)
+  {
+    TEST_ASSERT_EQUAL(len, feed(contentLength, piece));
+    TEST_ASSERT_TRUE(httpResponseDone(r));
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_EQUAL(13, r.contentLength);
+    TEST_ASSERT_TRUE(r.keepAlive);
+    TEST_ASSERT_EQUAL_STRING("application/json; charset=utf-8", r.contentType);
+    TEST_ASSERT_EQUAL_STRING("{\"text\":\"hi\"}", body.c_str());
+    TEST_ASSERT_EQUAL(13, r.bodyBytes);
+  }
+}
+
+void test_chunked_body_with_extension_and_trailer(void)
+{
+  size_t len = strlen(chunked);
+  for (size_t piece = 1; piece <= len; piece++)
+  {
+    TEST_ASSERT_EQUAL(len, feed(chunked, piece));
+    TEST_ASSERT_TRUE(httpResponseDone(r));
+    TEST_ASSERT_TRUE(r.chunked);
+    TEST_ASSERT_EQUAL_STRING("Hello, world", body.c_str());
+  }
+}
+
+void test_bad_chunk_is_an_error(void)
+{
+  feed("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 1);
+  TEST_ASSERT_TRUE(httpResponseFailed(r));
+  feed("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n", 1);
+  TEST_ASSERT_TRUE(httpResponseFailed(r));
+}
+
+void test_body_until_close(void)
+{
+  feed("HTTP/1.0 200 OK\r\n\r\nraw audio", 4);
+  TEST_ASSERT_FALSE(httpResponseDone(r));
+  TEST_ASSERT_FALSE(r.keepAlive);
+  httpResponseEof(r);
+  TEST_ASSERT_TRUE(httpResponseDone(r));
+  TEST_ASSERT_EQUAL_STRING("raw audio", body.c_str());
+
+  // A close before the announced length is not a complete response
+  feed("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", 64);
+  httpResponseEof(r);
+  TEST_ASSERT_TRUE(httpResponseFailed(r));
+}
+
+void test_status_and_connection_headers(void)
+{
+  feed("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", 7);
+  TEST_ASSERT_TRUE(httpResponseDone(r));
+  TEST_ASSERT_EQUAL(503, r.status);
+  TEST_ASSERT_FALSE(r.keepAlive);
+
+  feed("HTTP/1.0 204 No Content\r\nConnection: keep-alive\r\n\r\n", 64);
+  TEST_ASSERT_TRUE(httpResponseDone(r));
+  TEST_ASSERT_TRUE(r.keepAlive);
+
+  feed("SSH-2.0-OpenSSH\r\n", 64);
+  TEST_ASSERT_TRUE(httpResponseFailed(r));
+}
+
+void test_interim_and_upgrade_responses(void)
+{
+  feed("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok", 3);
+  TEST_ASSERT_TRUE(httpResponseDone(r));
+  TEST_ASSERT_EQUAL(200, r.status);
+  TEST_ASSERT_EQUAL_STRING("ok", body.c_str());
+
+  // Frames after a 101 belong to the WebSocket and are left unread
+  const char *upgrade = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n\x81\x02hi";
+  size_t used = feed(upgrade, 64);
+  TEST_ASSERT_TRUE(httpResponseDone(r));
+  TEST_ASSERT_EQUAL(strlen(upgrade) - 4, used);
+}
+
+void test_pipelined_responses(void)
+{
+  std::string two = std::string(contentLength) + chunked;
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  size_t used = httpResponseFeed(r, (const uint8_t *)two.data(), two.size());
+  TEST_ASSERT_EQUAL(strlen(contentLength), used);
+
+  httpResponseInit(r, collect, &body);
+  body.clear();
+  TEST_ASSERT_EQUAL(two.size() - used, httpResponseFeed(r, (const uint8_t *)two.data() + used, two.size() - used));
+  TEST_ASSERT_EQUAL_STRING("Hello, world", body.c_str());
+}
+
+void test_sink_failure_aborts(void)
+{
+  httpResponseInit(r, refuse, NULL);
+  httpResponseFeed(r, (const uint8_t *)contentLength, strlen(contentLength));
+  TEST_ASSERT_TRUE(httpResponseFailed(r));
+}
+
+void test_read_response_keeps_the_next_one_in_the_carry(void)
+{
+  std::string two = std::string(contentLength) + chunked;
+  static HttpCarry carry;
+  httpCarryReset(carry);
+
+  // Both responses arrive in one read
+  ScriptedClient client(two.c_str(), HTTP_READ_CHUNK, false);
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  TEST_ASSERT_TRUE(httpReadResponse(client, r, 1000, &carry));
+  TEST_ASSERT_EQUAL_STRING("{\"text\":\"hi\"}", body.c_str());
+  TEST_ASSERT_EQUAL(strlen(chunked), carry.len - carry.pos);
+
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  TEST_ASSERT_TRUE(httpReadResponse(client, r, 1000, &carry));
+  TEST_ASSERT_EQUAL_STRING("Hello, world", body.c_str());
+}
+
+void test_read_response_until_close_and_timeout(void)
+{
+  ScriptedClient closing("HTTP/1.1 200 OK\r\n\r\nstreamed", 3);
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  TEST_ASSERT_TRUE(httpReadResponse(closing, r, 1000));
+  TEST_ASSERT_EQUAL_STRING("streamed", body.c_str());
+
+  ScriptedClient stalled("HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\npartial", 64, false);
+  body.clear();
+  httpResponseInit(r, collect, &body);
+  uint32_t t0 = millis();
+  TEST_ASSERT_FALSE(httpReadResponse(stalled, r, 50));
+  TEST_ASSERT_GREATER_OR_EQUAL(50, millis() - t0);
+  TEST_ASSERT_EQUAL_STRING("partial", body.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_content_length_body);
+  RUN_TEST(test_chunked_body_with_extension_and_trailer);
+  RUN_TEST(test_bad_chunk_is_an_error);
+  RUN_TEST(test_body_until_close);
+  RUN_TEST(test_status_and_connection_headers);
+  RUN_TEST(test_interim_and_upgrade_responses);
+  RUN_TEST(test_pipelined_responses);
+  RUN_TEST(test_sink_failure_aborts);
+  RUN_TEST(test_read_response_keeps_the_next_one_in_the_carry);
+  RUN_TEST(test_read_response_until_close_and_timeout);
+  return UNITY_END();
+}
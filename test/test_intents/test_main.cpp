@@ -0,0 +1,219 @@
+// Host tests for the local intent matcher. pio test -e native -f test_intents
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "intents.h"
+
+// A cut of the device grammar in main.cpp, one rule per feature
+static const IntentRule grammar[] = {
+    {INTENT_LIGHT_ON, "turn [the] light on"},
+    {INTENT_LIGHT_ON, "turn on [the] light"},
+    {INTENT_LIGHT_ON, "lights on"},
+    {INTENT_LIGHT_OFF, "turn [the] light off"},
+    {INTENT_LIGHT_DIM, "dim [the] light to {n} [percent]"},
+    {INTENT_VOLUME_UP, "volume up"},
+    {INTENT_VOLUME_UP, "louder"},
+    {INTENT_VOLUME_SET, "set [the] volume to {n} [percent]"},
+    {INTENT_REPEAT, "say that again"},
+    {INTENT_STOP_LISTENING, "goodbye"}};
+
+static IntentMatch match(const char *transcript)
+{
+  IntentMatch m;
+  intentMatch(transcript, m);
+  return m;
+}
+
+void setUp(void)
+{
+  TEST_ASSERT_TRUE(intentCompile(grammar, sizeof(grammar) / sizeof(grammar[0])));
+}
+
+void tearDown(void)
+{
+}
+
+void test_literal_and_optional_words(void)
+{
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, match("Turn the light on.").intent);
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, match("turn light on").intent);
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, match("TURN ON THE LIGHT!").intent);
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_OFF, match("Turn the light off.").intent);
+  TEST_ASSERT_EQUAL(INTENT_STOP_LISTENING, match("Goodbye.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Turn the the light on.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("").intent);
+}
+
+void test_number_slots(void)
+{
+  IntentMatch m = match("Dim the light to 30%.");
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_DIM, m.intent);
+  TEST_ASSERT_EQUAL(30, m.slot);
+
+  m = match("Dim the light to fifty percent.");
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_DIM, m.intent);
+  TEST_ASSERT_EQUAL(50, m.slot);
+
+  m = match("set volume to seven");
+  TEST_ASSERT_EQUAL(INTENT_VOLUME_SET, m.intent);
+  TEST_ASSERT_EQUAL(7, m.slot);
+
+  TEST_ASSERT_EQUAL(-1, match("Volume up.").slot);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Dim the light to many percent.").intent);
+}
+
+void test_compound_number_slots(void)
+{
+  // Spelled-out numbers, as a backend without numerals=true returns them
+  TEST_ASSERT_EQUAL(25, match("set the volume to twenty five percent").slot);
+  TEST_ASSERT_EQUAL(75, match("Dim the light to seventy-five percent.").slot);
+  TEST_ASSERT_EQUAL(100, match("set the volume to one hundred").slot);
+  TEST_ASSERT_EQUAL(105, match("set the volume to one hundred and five").slot);
+  TEST_ASSERT_EQUAL(120, match("set the volume to one hundred twenty").slot);
+  TEST_ASSERT_EQUAL(500, match("set the volume to 5 hundred").slot);
+
+  // The whole run is one word, not one slot plus extra words
+  IntentMatch m = match("set the volume to one hundred and twenty three percent please");
+  TEST_ASSERT_EQUAL(INTENT_VOLUME_SET, m.intent);
+  TEST_ASSERT_EQUAL(123, m.slot);
+  TEST_ASSERT_EQUAL(6, m.end);
+
+  // "and" after a number only joins when a number follows it
+  m = match("set the volume to one hundred and go");
+  TEST_ASSERT_EQUAL(INTENT_VOLUME_SET, m.intent);
+  TEST_ASSERT_EQUAL(100, m.slot);
+
+  // Runs that are not one number fill no slot
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("set the volume to five twenty").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("set the volume to twenty thirty").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Dim the light to twenty-twelve percent.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("set the volume to 50 5").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("set the volume to one hundred two hundred").intent);
+}
+
+void test_whole_words_only(void)
+{
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Lightson.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Much louderer").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Flights on time?").intent);
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, match("Lights, on!").intent);
+  // Apostrophes are dropped inside a word, not treated as a boundary
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("say that'again").intent);
+}
+
+void test_extra_words_around_a_command(void)
+{
+  IntentMatch m = match("Please turn the light on now.");
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, m.intent);
+  TEST_ASSERT_EQUAL(1, m.start);
+  TEST_ASSERT_EQUAL(5, m.end);
+
+  TEST_ASSERT_EQUAL(INTENT_VOLUME_UP, match("Could you go louder?").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE,
+                    match("Tell me a joke about someone who tried to turn the light on.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("What is the capital of France?").intent);
+}
+
+void test_negations_block_a_match(void)
+{
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Don't turn on the light.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Do not turn the light off.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Never say that again.").intent);
+  TEST_ASSERT_EQUAL(INTENT_NONE, match("Volume up, not down.").intent);
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_ON, match("Now turn on the light.").intent);
+}
+
+void test_longest_match_wins(void)
+{
+  IntentMatch m = match("dim the light to 40 percent");
+  TEST_ASSERT_EQUAL(INTENT_LIGHT_DIM, m.intent);
+  TEST_ASSERT_EQUAL(0, m.start);
+  TEST_ASSERT_EQUAL(6, m.end);
+}
+
+void test_long_transcripts_are_left_to_the_llm(void)
+{
+  char text[INTENT_MAX_WORDS * 3 + 16] = "louder";
+  for (int i = 0; i < INTENT_MAX_WORDS; i++)
+  {
+    strcat(text, " a");
+  }
+  TEST_ASSERT_EQUAL(INTENT_NONE, match(text).intent);
+}
+
+void test_grammar_that_does_not_fit(void)
+{
+  static IntentRule big[INTENT_MAX_EDGES + 1];
+  static char patterns[INTENT_MAX_EDGES + 1][16];
+  for (int i = 0; i <= INTENT_MAX_EDGES; i++)
+  {
+    snprintf(patterns[i], sizeof(patterns[i]), "word%d", i);
+    big[i].intent = INTENT_REPEAT;
+    big[i].pattern = patterns[i];
+  }
+  TEST_ASSERT_FALSE(intentCompile(big, INTENT_MAX_EDGES + 1));
+}
+
+void test_names(void)
+{
+  TEST_ASSERT_EQUAL_STRING("LIGHT_DIM", intentName(INTENT_LIGHT_DIM));
+  TEST_ASSERT_EQUAL_STRING("NONE", intentName(INTENT_NONE));
+}
+
+void test_throughput(void)
+{
+  // Mix of commands, near misses and ordinary questions, as Deepgram formats them
+  static const char *const corpus[] = {
+      "Turn the light on.",
+      "Please turn the light off.",
+      "Dim the light to 30%.",
+      "Set the volume to seventy-five percent.",
+      "Volume up.",
+      "Can you say that again?",
+      "What is the capital of France?",
+      "How long does it take to boil one egg?",
+      "Tell me a joke about someone turning the light on in a dark room.",
+      "Who won the football match last night?"};
+  const int corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+  const int iterations = 20000;
+
+  size_t bytes = 0;
+  for (int i = 0; i < corpusSize; i++)
+    bytes += strlen(corpus[i]);
+
+  int matched = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++)
+  {
+    for (int i = 0; i < corpusSize; i++)
+    {
+      IntentMatch m;
+      matched += intentMatch(corpus[i], m) ? 1 : 0;
+    }
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+  char message[160];
+  uint32_t total = (uint32_t)iterations * corpusSize;
+  snprintf(message, sizeof(message), "%u transcripts in %.0f us: %.2f us/transcript, %.2f MB/s", (unsigned)total, us,
+           us / total, us > 0 ? bytes * iterations / us : 0.0);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(6 * iterations, matched);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_literal_and_optional_words);
+  RUN_TEST(test_number_slots);
+  RUN_TEST(test_compound_number_slots);
+  RUN_TEST(test_whole_words_only);
+  RUN_TEST(test_extra_words_around_a_command);
+  RUN_TEST(test_negations_block_a_match);
+  RUN_TEST(test_longest_match_wins);
+  RUN_TEST(test_long_transcripts_are_left_to_the_llm);
+  RUN_TEST(test_grammar_that_does_not_fit);
+  RUN_TEST(test_names);
+  RUN_TEST(test_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,303 @@
+// Host tests for the offline queue: queueDrain() against a scripted server
+// on a manual clock, through pipelined responses, dropped connections and
+// an outage long enough to reach the longest retry backoff.
+// pio test -e native -f test_offline_queue
+#include <Arduino.h>
+#include <SD.h>
+#include <unity.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "offline_queue.h"
+#include "turn_scheduler.h"
+
+// Answers every request latencyMs after it arrives, echoing its job path.
+// While down, a connect hangs for its whole timeout and fails. With
+// closeAfter set, the connection closes after that many responses and the
+// requests still unanswered on it are lost.
+class QueueServer : public WiFiClientSecure
+{
+public:
+  int connect(const char *host, uint16_t port, int32_t timeout) override
+  {
+    attempts++;
+    if ((int32_t)(millis() - downUntil) < 0)
+    {
+      delay(timeout);
+      return 0;
+    }
+    stop();
+    open = true;
+    answered = 0;
+    connects++;
+    return 1;
+  }
+
+  void stop() override
+  {
+    open = closing = false;
+    in.clear();
+    rx.clear();
+    out.clear();
+  }
+
+  size_t write(const uint8_t *buf, size_t size) override
+  {
+    if (!open || closing)
+      return 0;
+    in.append((const char *)buf, size);
+    size_t end;
+    while ((end = in.find("\r\n\r\n")) != std::string::npos)
+    {
+      size_t job = in.find("X-Job: ") + 7;
+      std::string path = in.substr(job, in.find("\r\n", job) - job);
+      in.erase(0, end + 4);
+      uploads.push_back(path);
+      out.push_back({millis() + latencyMs, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(path.size()) +
+                                               "\r\n\r\n" + path});
+    }
+    return size;
+  }
+
+  int available() override
+  {
+    pump();
+    return (int)rx.size();
+  }
+
+  int read(uint8_t *buf, size_t size) override
+  {
+    size_t n = min(size, rx.size());
+    memcpy(buf, rx.data(), n);
+    int responses = 0;
+    for (size_t i = rx.find("HTTP/1.1"); i < n; i = rx.find("HTTP/1.1", i + 1))
+      responses++;
+    maxResponsesPerRead = max(maxResponsesPerRead, responses);
+    rx.erase(0, n);
+    return (int)n;
+  }
+
+  uint8_t connected() override
+  {
+    pump();
+    return !rx.empty() || (open && !closing);
+  }
+
+  uint32_t latencyMs = 500;
+  uint32_t downUntil = 0;
+  int closeAfter = 0;
+
+  int attempts = 0;
+  int connects = 0;
+  int maxResponsesPerRead = 0;
+  std::vector<std::string> uploads;
+
+private:
+  struct Reply
+  {
+    uint32_t readyAt;
+    std::string bytes;
+  };
+
+  // Move the responses that are due into the receive buffer
+  void pump()
+  {
+    while (open && !closing && !out.empty() && (int32_t)(millis() - out.front().readyAt) >= 0)
+    {
+      rx += out.front().bytes;
+      out.pop_front();
+      if (closeAfter && ++answered >= closeAfter)
+      {
+        closing = true;
+        out.clear();
+      }
+    }
+  }
+
+  bool open = false;
+  bool closing = false;
+  int answered = 0;
+  std::string in;
+  std::string rx;
+  std::deque<Reply> out;
+};
+
+static std::vector<std::string> completed;
+
+static bool sendJob(WiFiClient &client, const char *path)
+{
+  char request[160];
+  int len = snprintf(request, sizeof(request), "POST /v1/listen HTTP/1.1\r\nX-Job: %s\r\n\r\n", path);
+  return client.print(request) == (size_t)len;
+}
+
+static bool jobDone(void *ctx, const char *path, const HttpResponse &r, const String &body)
+{
+  if (r.status != 200 || body != path)
+    return false;
+  completed.push_back(path);
+  return true;
+}
+
+static const QueueTarget target = {"mock", 443, sendJob, jobDone, NULL};
+
+// Record count utterances and queue them, returns their queued paths
+static std::vector<std::string> addRecordings(int count)
+{
+  static int next = 0;
+  std::vector<std::string> queued;
+  for (int i = 0; i < count; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "/rec_%03d.wav", next++);
+    SD.open(path, FILE_WRITE).write((const uint8_t *)"RIFF", 4);
+    TEST_ASSERT_TRUE(queueAdd(path));
+    TEST_ASSERT_FALSE(SD.exists(path));
+
+    File dir = SD.open(QUEUE_DIR);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    {
+      if (strstr(f.name(), path + 1))
+        queued.push_back(std::string(QUEUE_DIR "/") + f.name());
+    }
+  }
+  return queued;
+}
+
+void setUp(void)
+{
+  hostClockManual(true);
+  hostClock.us = 1000000; // 1 s after boot
+  srand(1);
+  hostSdClear();
+  TEST_ASSERT_TRUE(queueBegin());
+  completed.clear();
+}
+
+void tearDown(void)
+{
+  hostClockManual(false);
+}
+
+void test_queue_survives_a_reboot(void)
+{
+  std::vector<std::string> jobs = addRecordings(3);
+  TEST_ASSERT_EQUAL(3, queuePending());
+  TEST_ASSERT_EQUAL(3, jobs.size());
+
+  TEST_ASSERT_TRUE(queueBegin());
+  TEST_ASSERT_EQUAL(3, queuePending());
+
+  QueueServer server;
+  TEST_ASSERT_EQUAL(3, queueDrain(server, target));
+  TEST_ASSERT_EQUAL(0, queuePending());
+  TEST_ASSERT_TRUE(SD.exists("/rec_000.wav")); // Back next to the other recordings
+}
+
+void test_pipelined_drain_rate(void)
+{
+  std::vector<std::string> jobs = addRecordings(QUEUE_BATCH);
+  QueueServer server;
+  uint32_t t0 = millis();
+  TEST_ASSERT_EQUAL(QUEUE_BATCH, queueDrain(server, target));
+  uint32_t elapsed = millis() - t0;
+
+  TEST_ASSERT_TRUE(completed == jobs); // Oldest first
+  TEST_ASSERT_EQUAL(1, server.connects);
+  TEST_ASSERT_EQUAL(QUEUE_BATCH, server.uploads.size());
+  // Two responses came in one read: the second was parsed from the carry
+  TEST_ASSERT_TRUE(server.maxResponsesPerRead >= 2);
+
+  // QUEUE_PIPELINE_DEPTH requests share each round trip: 8 jobs in 4 x
+  // 500 ms, 240 utterances/min where one at a time would drain 120
+  uint32_t perMinute = QUEUE_BATCH * 60000 / elapsed;
+  TEST_ASSERT_TRUE(perMinute >= QUEUE_PIPELINE_DEPTH * 60000 / server.latencyMs * 9 / 10);
+}
+
+void test_reconnects_resend_unanswered_jobs(void)
+{
+  std::vector<std::string> jobs = addRecordings(QUEUE_BATCH);
+  QueueServer server;
+  server.closeAfter = 3;
+  TEST_ASSERT_EQUAL(QUEUE_BATCH, queueDrain(server, target));
+  TEST_ASSERT_TRUE(completed == jobs);
+
+  // 3 + 3 + 2 answered; the job in flight at each close went out again
+  TEST_ASSERT_EQUAL(3, server.connects);
+  TEST_ASSERT_EQUAL(QUEUE_BATCH + 2, server.uploads.size());
+  TEST_ASSERT_TRUE(server.uploads[3] == jobs[3] && server.uploads[4] == jobs[3]);
+  TEST_ASSERT_EQUAL(0, queuePending());
+}
+
+void test_too_many_reconnects_keep_the_rest_queued(void)
+{
+  std::vector<std::string> jobs = addRecordings(QUEUE_BATCH);
+  QueueServer server;
+  server.closeAfter = 1;
+  int drained = queueDrain(server, target);
+  TEST_ASSERT_EQUAL(QUEUE_MAX_RECONNECTS + 1, server.connects);
+  TEST_ASSERT_EQUAL(server.connects, drained);
+  TEST_ASSERT_EQUAL(QUEUE_BATCH - drained, queuePending());
+
+  // Backing off: nothing is sent until QUEUE_RETRY_MIN_MS has passed
+  server.closeAfter = 0;
+  TEST_ASSERT_EQUAL(0, queueDrain(server, target));
+  TEST_ASSERT_EQUAL(QUEUE_MAX_RECONNECTS + 1, server.connects);
+  delay(QUEUE_RETRY_MIN_MS);
+  TEST_ASSERT_EQUAL(QUEUE_BATCH - drained, queueDrain(server, target));
+  TEST_ASSERT_TRUE(completed == jobs);
+}
+
+void test_outage_backs_off_up_to_ten_minutes(void)
+{
+  std::vector<std::string> jobs = addRecordings(4);
+  QueueServer server;
+  server.downUntil = millis() + 30 * 60000;
+
+  // The main loop calls queueDrain() about once a second
+  std::vector<uint32_t> starts, ends;
+  for (int s = 0; s < 2 * 3600 && queuePending() > 0; s++)
+  {
+    int attempts = server.attempts;
+    uint32_t t = millis();
+    queueDrain(server, target);
+    if (server.attempts != attempts)
+    {
+      starts.push_back(t);
+      ends.push_back(millis());
+      if (queuePending() > 0)
+        TEST_ASSERT_EQUAL(CONNECT_RETRIES, server.attempts - attempts);
+    }
+    delay(1000);
+  }
+  TEST_ASSERT_EQUAL(0, queuePending());
+  TEST_ASSERT_TRUE(completed == jobs);
+
+  // 10 s doubling to the 10 min cap, each wait counted from the end of the
+  // failed drain and overshot by at most one loop pass
+  uint32_t expected = QUEUE_RETRY_MIN_MS;
+  int capped = 0;
+  for (size_t i = 0; i + 1 < starts.size(); i++)
+  {
+    uint32_t wait = starts[i + 1] - ends[i];
+    TEST_ASSERT_TRUE(wait >= expected && wait <= expected + 1000);
+    capped += expected == QUEUE_RETRY_MAX_MS;
+    expected = min(expected * 2, (uint32_t)QUEUE_RETRY_MAX_MS);
+  }
+  TEST_ASSERT_TRUE(capped >= 2);
+
+  // A full drain resets the backoff: the next recording goes right away
+  jobs = addRecordings(1);
+  TEST_ASSERT_EQUAL(1, queueDrain(server, target));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_survives_a_reboot);
+  RUN_TEST(test_pipelined_drain_rate);
+  RUN_TEST(test_reconnects_resend_unanswered_jobs);
+  RUN_TEST(test_too_many_reconnects_keep_the_rest_queued);
+  RUN_TEST(test_outage_backs_off_up_to_ten_minutes);
+  return UNITY_END();
+}
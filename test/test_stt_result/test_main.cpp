@@ -0,0 +1,356 @@
+// Host tests for the streaming Deepgram result extractor: sample
+// responses, the old indexOf-based json_object() it replaced, any split
+// of the body, and mutated inputs. pio test -e native -f test_stt_result
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include "stt_result.h"
+
+static SttResult r, reference;
+
+// Shaped like real /v1/listen responses with smart_format, trimmed
+static const char *const corpus[] = {
+    "{\"metadata\":{\"transaction_key\":\"deprecated\",\"request_id\":\"5d1c3b6e-8f1a\",\"sha256\":\"9f86d081884c"
+    "7d659a2feaa0c55ad015\",\"created\":\"2025-01-14T09:12:44.512Z\",\"duration\":3.2,\"channels\":1,\"models\":["
+    "\"1abfe86b-e047-4eed-858a-35e5625b41ee\"],\"model_info\":{\"1abfe86b-e047-4eed-858a-35e5625b41ee\":{\"name\":"
+    "\"2-general-nova\",\"version\":\"2024-01-09.29447\",\"arch\":\"nova-2\"}}},\"results\":{\"channels\":[{"
+    "\"alternatives\":[{\"transcript\":\"Turn on the light.\",\"confidence\":0.99853516,\"words\":[{\"word\":"
+    "\"turn\",\"start\":0.24,\"end\":0.48,\"confidence\":0.9980469,\"punctuated_word\":\"Turn\"},{\"word\":\"on\","
+    "\"start\":0.48,\"end\":0.64,\"confidence\":0.99902344,\"punctuated_word\":\"on\"},{\"word\":\"the\",\"start\":"
+    "0.64,\"end\":0.8,\"confidence\":0.99853516,\"punctuated_word\":\"the\"},{\"word\":\"light\",\"start\":0.8,"
+    "\"end\":1.3,\"confidence\":0.9975586,\"punctuated_word\":\"light.\"}],\"paragraphs\":{\"transcript\":\"\\n"
+    "Turn on the light.\",\"paragraphs\":[{\"sentences\":[{\"text\":\"Turn on the light.\",\"start\":0.24,\"end\":"
+    "1.3}],\"num_words\":4,\"start\":0.24,\"end\":1.3}]}}]}]}}",
+
+    "{\"metadata\":{\"request_id\":\"a2\",\"duration\":4.1,\"channels\":1},\"results\":{\"channels\":[{"
+    "\"alternatives\":[{\"transcript\":\"She said \\\"caf\\u00e9 at 5\\\" \\u2014 not 6 \\ud83d\\ude42\","
+    "\"confidence\":0.87,\"words\":[{\"word\":\"she\",\"start\":0.1,\"end\":0.3,\"confidence\":0.95},{\"word\":"
+    "\"said\",\"start\":0.3,\"end\":0.6,\"confidence\":0.91},{\"word\":\"cafe\",\"start\":0.7,\"end\":1.1,"
+    "\"confidence\":0.62},{\"word\":\"at\",\"start\":1.1,\"end\":1.2,\"confidence\":0.9},{\"word\":\"5\",\"start\":"
+    "1.2,\"end\":1.5,\"confidence\":0.88}]},{\"transcript\":\"She said cafe at five, not six.\",\"confidence\":0.8,"
+    "\"words\":[]}]}]}}",
+
+    "{\"metadata\":{\"request_id\":\"a3\",\"duration\":2.0,\"channels\":1},\"results\":{\"channels\":[{"
+    "\"alternatives\":[{\"transcript\":\"\",\"confidence\":0.0,\"words\":[]}]}]}}",
+
+    "{\n  \"metadata\": {\n    \"request_id\": \"a4\",\n    \"duration\": 1.5e0\n  },\n  \"results\": {\n"
+    "    \"channels\": [\n      {\n        \"alternatives\": [\n          {\n            \"transcript\": "
+    "\"What's the weather like in Paris?\",\n            \"confidence\": 0.42,\n            \"words\": [\n"
+    "              {\"word\": \"what's\", \"start\": 0.08, \"end\": 0.32, \"confidence\": 0.4}\n            ]\n"
+    "          }\n        ]\n      }\n    ]\n  }\n}",
+
+    "{\"err_code\":\"INVALID_AUTH\",\"err_msg\":\"Invalid credentials.\",\"request_id\":\"a5\"}",
+};
+static const int corpusCount = sizeof(corpus) / sizeof(corpus[0]);
+
+// The function the extractor replaced, on std::string instead of String
+static std::string legacyJsonObject(const std::string &input, const std::string &element)
+{
+  std::string content;
+  size_t pos_start = input.find(element);
+  if (pos_start == std::string::npos)
+  {
+    return content;
+  }
+  pos_start += element.length();
+  while (pos_start < input.length() && (input[pos_start] == ' ' || input[pos_start] == '"'))
+  {
+    pos_start++;
+  }
+  size_t pos_end = pos_start;
+  bool inQuotes = false;
+  while (pos_end < input.length())
+  {
+    char c = input[pos_end];
+    if (c == '"' && (pos_end == pos_start || input[pos_end - 1] != '\\'))
+    {
+      if (inQuotes)
+      {
+        break;
+      }
+      inQuotes = true;
+    }
+    else if (!inQuotes && (c == ',' || c == '}' || c == ']'))
+    {
+      break;
+    }
+    pos_end++;
+  }
+  if (pos_end > pos_start)
+  {
+    content = input.substr(pos_start, pos_end - pos_start);
+    if (content.size() >= 2 && content.front() == '"' && content.back() == '"')
+    {
+      content = content.substr(1, content.size() - 2);
+    }
+  }
+  return content;
+}
+
+static void parse(SttResult &out, const char *json)
+{
+  sttResultInit(out);
+  sttResultFeed(out, (const uint8_t *)json, strlen(json));
+}
+
+// Feed in pieces of random size, like TCP segments
+static void feedSplit(SttResult &out, const char *json, size_t len, size_t maxPiece)
+{
+  sttResultInit(out);
+  for (size_t pos = 0; pos < len;)
+  {
+    size_t n = min((size_t)random(1, maxPiece + 1), len - pos);
+    if (!sttResultFeed(out, (const uint8_t *)json + pos, n))
+    {
+      break;
+    }
+    pos += n;
+  }
+}
+
+static bool sameResult(const SttResult &a, const SttResult &b)
+{
+  return a.length == b.length && memcmp(a.transcript, b.transcript, a.length) == 0 &&
+         a.confidence == b.confidence && a.wordCount == b.wordCount && a.complete == b.complete &&
+         a.failed == b.failed && memcmp(a.words, b.words, a.wordCount * sizeof(SttWord)) == 0;
+}
+
+// Invariants that must hold for any input
+static bool resultValid(const SttResult &out)
+{
+  if (out.length >= STT_RESULT_TEXT_MAX || out.transcript[out.length] != '\0' ||
+      out.wordCount > STT_RESULT_WORDS_MAX || out.depth > STT_RESULT_DEPTH)
+  {
+    return false;
+  }
+  for (int i = 0; i < STT_RESULT_ALTS_MAX - 1; i++)
+  {
+    if (!memchr(out.altTranscript[i], '\0', STT_RESULT_ALT_TEXT_MAX))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setUp(void)
+{
+  srand(1);
+}
+
+void tearDown(void)
+{
+}
+
+void test_plain_response(void)
+{
+  parse(r, corpus[0]);
+  TEST_ASSERT_TRUE(r.complete);
+  TEST_ASSERT_FALSE(r.failed);
+  TEST_ASSERT_EQUAL_STRING("Turn on the light.", r.transcript);
+  TEST_ASSERT_EQUAL(strlen(r.transcript), r.length);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.99853516, r.confidence);
+  TEST_ASSERT_EQUAL(4, r.wordsTotal);
+  TEST_ASSERT_EQUAL(4, r.wordCount);
+  TEST_ASSERT_EQUAL(240, r.words[0].startMs);
+  TEST_ASSERT_EQUAL(800, r.words[3].startMs);
+  TEST_ASSERT_EQUAL(1300, r.words[3].endMs);
+  TEST_ASSERT_EQUAL(1, r.alternatives);
+  // Paragraphs come after the alternatives and are never read
+  TEST_ASSERT_LESS_THAN(strlen(corpus[0]), r.bytes);
+}
+
+void test_escapes_and_alternatives(void)
+{
+  parse(r, corpus[1]);
+  TEST_ASSERT_TRUE(r.complete);
+  TEST_ASSERT_EQUAL_STRING("She said \"caf\xC3\xA9 at 5\" \xE2\x80\x94 not 6 \xF0\x9F\x99\x82", r.transcript);
+  TEST_ASSERT_FALSE(r.truncated);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.87, r.confidence);
+  TEST_ASSERT_EQUAL(5, r.wordsTotal);
+  TEST_ASSERT_EQUAL(2, r.alternatives);
+  TEST_ASSERT_EQUAL_STRING("She said cafe at five, not six.", r.altTranscript[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.8, r.altConfidence[0]);
+}
+
+void test_empty_and_pretty_printed(void)
+{
+  parse(r, corpus[2]);
+  TEST_ASSERT_TRUE(r.complete);
+  TEST_ASSERT_EQUAL_STRING("", r.transcript);
+  TEST_ASSERT_EQUAL(0, r.wordsTotal);
+
+  parse(r, corpus[3]);
+  TEST_ASSERT_TRUE(r.complete);
+  TEST_ASSERT_EQUAL_STRING("What's the weather like in Paris?", r.transcript);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.42, r.confidence);
+  TEST_ASSERT_EQUAL(1, r.wordsTotal);
+  TEST_ASSERT_EQUAL(80, r.words[0].startMs);
+}
+
+void test_error_body_has_no_result(void)
+{
+  parse(r, corpus[4]);
+  TEST_ASSERT_FALSE(r.complete);
+  TEST_ASSERT_FALSE(r.failed);
+  TEST_ASSERT_EQUAL_STRING("", r.transcript);
+  // Start of the body, kept for the error message
+  TEST_ASSERT_EQUAL(0, strncmp(r.head, corpus[4], sizeof(r.head) - 1));
+  TEST_ASSERT_EQUAL(sizeof(r.head) - 1, strlen(r.head));
+}
+
+void test_truncated_body_is_incomplete(void)
+{
+  std::string body(corpus[0]);
+  size_t cut = body.find("\"light.\"}]") + 3;
+  sttResultInit(r);
+  sttResultFeed(r, (const uint8_t *)body.data(), cut);
+  TEST_ASSERT_FALSE(r.complete);
+
+  parse(r, "{\"results\":{\"channels\":[{\"alternatives\":[{\"transcript\":\"x\"]}");
+  TEST_ASSERT_TRUE(r.failed);
+  TEST_ASSERT_FALSE(r.complete);
+}
+
+// json_object() ran on past the closing quote, so the transcript it meant
+// is a prefix of what it returned; escapes went on to Gemini as they were
+void test_against_legacy_extractor(void)
+{
+  for (int i = 0; i < corpusCount; i++)
+  {
+    parse(r, corpus[i]);
+    std::string old = legacyJsonObject(corpus[i], "\"transcript\":");
+    if (i == 1)
+    {
+      TEST_ASSERT_EQUAL(0, old.find("She said \\\"caf\\u00e9 at 5\\\" \\u2014 not 6 \\ud83d\\ude42"));
+    }
+    else
+    {
+      TEST_ASSERT_EQUAL(0, old.compare(0, r.length, r.transcript));
+    }
+  }
+}
+
+void test_split_invariance(void)
+{
+  for (int i = 0; i < corpusCount; i++)
+  {
+    size_t len = strlen(corpus[i]);
+    parse(reference, corpus[i]);
+    for (size_t piece = 1; piece <= 64; piece++)
+    {
+      sttResultInit(r);
+      for (size_t pos = 0; pos < len && sttResultFeed(r, (const uint8_t *)corpus[i] + pos, min(piece, len - pos));
+           pos += piece)
+      {
+      }
+      TEST_ASSERT_TRUE_MESSAGE(sameResult(r, reference), "fixed-size pieces");
+    }
+    for (int it = 0; it < 200; it++)
+    {
+      feedSplit(r, corpus[i], len, random(1, 64));
+      TEST_ASSERT_TRUE_MESSAGE(sameResult(r, reference), "random pieces");
+    }
+  }
+}
+
+// Mutated samples: truncated, bytes replaced or inserted, biased towards
+// the characters the tokenizer cares about
+void test_mutated_inputs_keep_invariants(void)
+{
+  static const char interesting[] = "{}[]\":,\\u0123456789abcdefDE.-+ \n\xC3\xA9\xF0\x9F\x99\x82\xFF";
+  static char input[1024];
+  int invalid = 0;
+  for (int it = 0; it < 20000; it++)
+  {
+    const char *base = corpus[random(corpusCount)];
+    size_t len = min(strlen(base), sizeof(input));
+    memcpy(input, base, len);
+    int edits = random(1, 8);
+    for (int e = 0; e < edits && len > 0; e++)
+    {
+      size_t at = random(len);
+      char c = random(4) ? interesting[random(sizeof(interesting) - 1)] : (char)random(256);
+      switch (random(3))
+      {
+      case 0:
+        len = at;
+        break;
+      case 1:
+        input[at] = c;
+        break;
+      default:
+        if (len < sizeof(input))
+        {
+          memmove(input + at + 1, input + at, len - at);
+          input[at] = c;
+          len++;
+        }
+        break;
+      }
+    }
+    feedSplit(r, input, len, 128);
+    TEST_ASSERT_TRUE(resultValid(r));
+    TEST_ASSERT_FALSE(r.complete && r.failed);
+    invalid += r.failed;
+  }
+  TEST_ASSERT_GREATER_THAN(0, invalid);
+}
+
+// Host numbers only say which is faster, the device ratio is what counts
+void test_throughput_against_legacy(void)
+{
+  const int iterations = 2000;
+  std::string inputs[corpusCount];
+  size_t totalBytes = 0;
+  for (int i = 0; i < corpusCount; i++)
+  {
+    inputs[i] = corpus[i];
+    totalBytes += inputs[i].size();
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  size_t sink = 0;
+  for (int it = 0; it < iterations; it++)
+  {
+    for (int i = 0; i < corpusCount; i++)
+    {
+      sink += legacyJsonObject(inputs[i], "\"transcript\":").size();
+    }
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++)
+  {
+    for (int i = 0; i < corpusCount; i++)
+    {
+      sttResultInit(r);
+      sttResultFeed(r, (const uint8_t *)inputs[i].data(), inputs[i].size());
+      sink += r.length;
+    }
+  }
+  auto t2 = std::chrono::steady_clock::now();
+
+  double legacyUs = std::chrono::duration<double, std::micro>(t1 - t0).count();
+  double streamUs = std::chrono::duration<double, std::micro>(t2 - t1).count();
+  char message[160];
+  snprintf(message, sizeof(message), "%d x %u bytes: json_object %.0f us, streaming %.0f us (%.1fx), %u", iterations,
+           (unsigned)totalBytes, legacyUs, streamUs, streamUs > 0 ? legacyUs / streamUs : 0.0, (unsigned)(sink & 1));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN(0, sink);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_response);
+  RUN_TEST(test_escapes_and_alternatives);
+  RUN_TEST(test_empty_and_pretty_printed);
+  RUN_TEST(test_error_body_has_no_result);
+  RUN_TEST(test_truncated_body_is_incomplete);
+  RUN_TEST(test_against_legacy_extractor);
+  RUN_TEST(test_split_invariance);
+  RUN_TEST(test_mutated_inputs_keep_invariants);
+  RUN_TEST(test_throughput_against_legacy);
+  return UNITY_END();
+}
@@ -0,0 +1,173 @@
+// Host tests for the streaming TTS decoder. pio test -e native -f test_tts_decode
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "tts_decode.h"
+
+static TtsDecoder d;
+static std::vector<int16_t> pcm;
+static std::vector<size_t> calls;
+static size_t refuseAfter;
+
+static bool collect(void *ctx, const int16_t *samples, size_t count)
+{
+  if (calls.size() >= refuseAfter)
+    return false;
+  pcm.insert(pcm.end(), samples, samples + count);
+  calls.push_back(count);
+  return true;
+}
+
+static void start(TtsEncoding encoding)
+{
+  pcm.clear();
+  calls.clear();
+  refuseAfter = (size_t)-1;
+  ttsDecodeInit(d, encoding, collect, NULL);
+}
+
+// Feed in pieces of the given size, false if the decoder failed
+static bool feed(const std::vector<uint8_t> &body, size_t piece)
+{
+  for (size_t pos = 0; pos < body.size(); pos += piece)
+  {
+    if (!ttsDecodeFeed(d, body.data() + pos, min(piece, body.size() - pos)))
+      return false;
+  }
+  return ttsDecodeFlush(d);
+}
+
+void setUp(void)
+{
+  srand(1);
+}
+
+void tearDown(void)
+{
+}
+
+void test_mulaw_matches_g711(void)
+{
+  // Reference points of the G.711 mu-law table
+  TEST_ASSERT_EQUAL(-32124, ttsMulawExpand(0x00));
+  TEST_ASSERT_EQUAL(32124, ttsMulawExpand(0x80));
+  TEST_ASSERT_EQUAL(0, ttsMulawExpand(0xFF));
+  TEST_ASSERT_EQUAL(0, ttsMulawExpand(0x7F));
+  TEST_ASSERT_EQUAL(-8, ttsMulawExpand(0x7E));
+  TEST_ASSERT_EQUAL(8, ttsMulawExpand(0xFE));
+
+  for (int u = 0; u < 256; u++)
+  {
+    // Each half of the code space is monotonic and mirrors the other
+    if ((u & 0x7F) != 0x7F)
+      TEST_ASSERT_TRUE(abs(ttsMulawExpand(u)) > abs(ttsMulawExpand(u + 1)));
+    TEST_ASSERT_EQUAL(-ttsMulawExpand(u | 0x80), ttsMulawExpand(u & 0x7F));
+    // Negative zero compresses to positive zero, every other code round-trips
+    TEST_ASSERT_EQUAL(u == 0x7F ? 0xFF : u, ttsMulawCompress(ttsMulawExpand(u)));
+  }
+}
+
+void test_mulaw_compress_error_is_bounded(void)
+{
+  for (int s = -32768; s < 32768; s += 7)
+  {
+    int back = ttsMulawExpand(ttsMulawCompress(s));
+    int step = max(8, abs(s) / 16); // Quantization step grows with the segment
+    TEST_ASSERT_TRUE(abs(back - max(-32635, min(s, 32635))) <= step);
+  }
+}
+
+void test_mulaw_decode_any_split(void)
+{
+  std::vector<uint8_t> body(TTS_DECODE_BLOCK * 2 + 77);
+  for (size_t i = 0; i < body.size(); i++)
+    body[i] = random(256);
+
+  static const size_t pieces[] = {1, 3, 511, 512, 513, 4096};
+  for (size_t piece : pieces)
+  {
+    start(TTS_MULAW);
+    TEST_ASSERT_TRUE(feed(body, piece));
+    TEST_ASSERT_EQUAL(body.size(), pcm.size());
+    TEST_ASSERT_EQUAL(body.size(), d.samples);
+    for (size_t i = 0; i < body.size(); i++)
+      TEST_ASSERT_EQUAL(ttsMulawExpand(body[i]), pcm[i]);
+    // Full blocks first, the remainder only on flush
+    TEST_ASSERT_EQUAL(3, calls.size());
+    TEST_ASSERT_EQUAL(TTS_DECODE_BLOCK, calls[0]);
+    TEST_ASSERT_EQUAL(77, calls[2]);
+  }
+}
+
+void test_linear16_odd_splits(void)
+{
+  std::vector<int16_t> samples(TTS_DECODE_BLOCK + 300);
+  for (size_t i = 0; i < samples.size(); i++)
+    samples[i] = (int16_t)(random(65536) - 32768);
+  std::vector<uint8_t> body;
+  for (int16_t s : samples)
+  {
+    body.push_back(s & 0xFF);
+    body.push_back((uint16_t)s >> 8);
+  }
+
+  static const size_t pieces[] = {1, 3, 7, 1023, 1025};
+  for (size_t piece : pieces)
+  {
+    start(TTS_LINEAR16);
+    TEST_ASSERT_TRUE(feed(body, piece));
+    TEST_ASSERT_FALSE(d.hasOdd);
+    TEST_ASSERT_EQUAL(samples.size(), pcm.size());
+    TEST_ASSERT_EQUAL_MEMORY(samples.data(), pcm.data(), samples.size() * 2);
+  }
+
+  // A trailing odd byte is not a sample
+  start(TTS_LINEAR16);
+  body.push_back(0x12);
+  TEST_ASSERT_TRUE(feed(body, 5));
+  TEST_ASSERT_TRUE(d.hasOdd);
+  TEST_ASSERT_EQUAL(samples.size(), pcm.size());
+}
+
+void test_sink_failure_stops_the_decoder(void)
+{
+  std::vector<uint8_t> body(TTS_DECODE_BLOCK * 3, 0x55);
+  start(TTS_MULAW);
+  refuseAfter = 1;
+  TEST_ASSERT_FALSE(ttsDecodeFeed(d, body.data(), body.size()));
+  TEST_ASSERT_TRUE(d.failed);
+  TEST_ASSERT_EQUAL(1, calls.size());
+  TEST_ASSERT_FALSE(ttsDecodeFeed(d, body.data(), TTS_DECODE_BLOCK));
+  TEST_ASSERT_FALSE(ttsDecodeFlush(d));
+  TEST_ASSERT_EQUAL(1, calls.size());
+}
+
+void test_flush_and_body_adapter(void)
+{
+  start(TTS_MULAW);
+  TEST_ASSERT_TRUE(ttsDecodeFlush(d));
+  TEST_ASSERT_EQUAL(0, calls.size()); // Nothing to hand over
+
+  const uint8_t body[] = {0xFF, 0x80, 0x00};
+  TEST_ASSERT_TRUE(ttsDecodeBody(&d, body, sizeof(body)));
+  TEST_ASSERT_EQUAL(0, calls.size());
+  TEST_ASSERT_TRUE(ttsDecodeFlush(d));
+  TEST_ASSERT_EQUAL(1, calls.size());
+  TEST_ASSERT_EQUAL(3, d.samples);
+  TEST_ASSERT_EQUAL(32124, pcm[1]);
+
+  TEST_ASSERT_EQUAL_STRING("mulaw", ttsEncodingName(TTS_MULAW));
+  TEST_ASSERT_EQUAL_STRING("linear16", ttsEncodingName(TTS_LINEAR16));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mulaw_matches_g711);
+  RUN_TEST(test_mulaw_compress_error_is_bounded);
+  RUN_TEST(test_mulaw_decode_any_split);
+  RUN_TEST(test_linear16_odd_splits);
+  RUN_TEST(test_sink_failure_stops_the_decoder);
+  RUN_TEST(test_flush_and_body_adapter);
+  return UNITY_END();
+}
@@ -0,0 +1,196 @@
+// Host tests for TTS text normalization and chunking.
+// pio test -e native -f test_tts_text
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "tts_text.h"
+
+static char out[TTS_TEXT_MAX];
+
+static const char *normalize(const char *in)
+{
+  ttsNormalize(in, out, sizeof(out));
+  return out;
+}
+
+// Structural checks that hold for any input: fits the buffer, no stray
+// spaces or control bytes, only whole UTF-8 characters
+static bool outputValid(const char *text, size_t len, size_t cap)
+{
+  if (len >= cap || text[len] != '\0' || strlen(text) != len)
+    return false;
+  if (len && (text[0] == ' ' || text[len - 1] == ' '))
+    return false;
+  for (size_t i = 0; i < len;)
+  {
+    uint8_t c = text[i];
+    if (c < 0x20 || (c == ' ' && text[i + 1] == ' '))
+      return false;
+    size_t n = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+    if (n == 0 || i + n > len)
+      return false;
+    for (size_t k = 1; k < n; k++)
+    {
+      if (((uint8_t)text[i + k] & 0xC0) != 0x80)
+        return false;
+    }
+    i += n;
+  }
+  return true;
+}
+
+void setUp(void)
+{
+  srand(1);
+}
+
+void tearDown(void)
+{
+}
+
+void test_markdown_is_stripped(void)
+{
+  TEST_ASSERT_EQUAL_STRING("Paris is big.", normalize("**Paris** is *big*."));
+  TEST_ASSERT_EQUAL_STRING("Check the docs and go", normalize("Check [the docs](https://x.com) & go"));
+  TEST_ASSERT_EQUAL_STRING("Title. item code", normalize("# Title\n- item `code`"));
+}
+
+void test_numbers_and_symbols(void)
+{
+  TEST_ASSERT_EQUAL_STRING("five dollars", normalize("$5"));
+  TEST_ASSERT_EQUAL_STRING("two point five zero euros", normalize("€2.50"));
+  TEST_ASSERT_EQUAL_STRING("It's twenty-five degrees C, forty percent rain", normalize("It's 25°C, 40% rain"));
+  TEST_ASSERT_EQUAL_STRING("one thousand two hundred thirty-four", normalize("1,234"));
+  TEST_ASSERT_EQUAL_STRING("x plus y equals z", normalize("x + y = z"));
+  // Years and numbers glued to letters are left to the TTS
+  TEST_ASSERT_EQUAL_STRING("In 1969 it cost three point five euros", normalize("In 1969 it cost 3.5 euros"));
+  TEST_ASSERT_EQUAL_STRING("mp3 and 3rd", normalize("mp3 and 3rd"));
+}
+
+void test_punctuation_spacing_and_unicode(void)
+{
+  TEST_ASSERT_EQUAL_STRING("\"quoted\", dash", normalize("\xE2\x80\x9Cquoted\xE2\x80\x9D \xE2\x80\x94 dash"));
+  TEST_ASSERT_EQUAL_STRING("spaced out", normalize("  spaced   out  "));
+  TEST_ASSERT_EQUAL_STRING("Line one. Line two", normalize("Line one\nLine two"));
+  TEST_ASSERT_EQUAL_STRING("Hi there", normalize("Hi \xF0\x9F\x99\x82 there"));
+  TEST_ASSERT_EQUAL_STRING("ok", normalize("o\xFFk"));
+  // Other scripts pass through untouched
+  const char *bangla = "\xE0\xA6\xB0\xE0\xA6\xAC\xE0\xA7\x80";
+  TEST_ASSERT_EQUAL_STRING(bangla, normalize(bangla));
+}
+
+void test_small_buffers_stay_valid(void)
+{
+  const char *text = "Fa\xC3\xA7" "ade costs $12 \xE2\x80\x94 **really**.";
+  for (size_t cap = 1; cap < 48; cap++)
+  {
+    size_t n = ttsNormalize(text, out, cap);
+    TEST_ASSERT_TRUE_MESSAGE(outputValid(out, n, cap), text);
+  }
+  TEST_ASSERT_EQUAL(0, ttsNormalize(text, out, 1));
+  TEST_ASSERT_EQUAL_STRING("", out);
+}
+
+void test_random_inputs_stay_valid(void)
+{
+  // Biased towards the characters with special handling
+  static const char interesting[] = " \n\t-*#[]()$%&.,0123456789abcXYZ`_'\"\xC2\xB0\xE2\x80\x94\xF0\x9F\x99\x82\xFF";
+  char input[256];
+  for (int it = 0; it < 20000; it++)
+  {
+    size_t len = random(sizeof(input));
+    for (size_t i = 0; i < len; i++)
+    {
+      input[i] = random(4) ? interesting[random(sizeof(interesting) - 1)] : (char)random(1, 256);
+    }
+    input[len] = '\0';
+
+    size_t cap = random(1, sizeof(out));
+    size_t n = ttsNormalize(input, out, cap);
+    TEST_ASSERT_TRUE(outputValid(out, n, cap));
+  }
+}
+
+void test_chunks_split_at_the_best_boundary(void)
+{
+  TEST_ASSERT_EQUAL(5, ttsChunk("short", 10));
+
+  const char *sentences = "One two. Three four, five six";
+  TEST_ASSERT_EQUAL(8, ttsChunk(sentences, 24));
+
+  const char *clauses = "One two, three four five";
+  TEST_ASSERT_EQUAL(8, ttsChunk(clauses, 20));
+
+  const char *words = "One two three four";
+  TEST_ASSERT_EQUAL(7, ttsChunk(words, 12));
+
+  TEST_ASSERT_EQUAL(6, ttsChunk("abcdefghij", 6));
+  // Never inside a UTF-8 character: "ab" then a two-byte letter
+  TEST_ASSERT_EQUAL(2, ttsChunk("ab\xC3\xA7" "def", 3));
+}
+
+void test_chunks_cover_the_text(void)
+{
+  static const char *const text = "Paris is the capital of France. It has about two million people, "
+                                  "and it sits on the Seine; the river runs through the middle of it.";
+  for (size_t maxLen = 8; maxLen < 64; maxLen++)
+  {
+    size_t total = strlen(text), pos = 0;
+    while (pos < total)
+    {
+      while (text[pos] == ' ')
+        pos++;
+      size_t n = ttsChunk(text + pos, maxLen);
+      TEST_ASSERT_TRUE(n > 0 && n <= maxLen);
+      pos += n;
+    }
+    TEST_ASSERT_EQUAL(total, pos);
+  }
+}
+
+void test_throughput(void)
+{
+  // Shaped like Gemini answers, one per feature of the normalizer
+  static const char *const samples[] = {
+      "**Paris** is the capital of France, with about 2,100,000 people.",
+      "Here's what I found:\n- It's 25°C today\n- Rain chance: 40%\n- Wind at 12.5 km/h",
+      "The answer is 42 — or, as the book says, “the answer to everything”.",
+      "Check [the docs](https://example.com/docs) & try again in 5 minutes 🙂",
+      "In 1969, Apollo 11 landed; tickets cost $3 and €2.50 back then… apparently.",
+      "# Summary\n> Use `i2s_write()` for the 3rd buffer, not the 1st.",
+      "রবীন্দ্রনাথ ঠাকুর 1913 সালে নোবেল পুরস্কার পান।"};
+  const int sampleCount = sizeof(samples) / sizeof(samples[0]);
+  const int iterations = 5000;
+
+  size_t bytes = 0, written = 0;
+  for (int i = 0; i < sampleCount; i++)
+    bytes += strlen(samples[i]);
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; it++)
+  {
+    for (int i = 0; i < sampleCount; i++)
+      written += ttsNormalize(samples[i], out, sizeof(out));
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+  char message[128];
+  snprintf(message, sizeof(message), "%d x %u bytes in %.0f us: %.2f MB/s", iterations, (unsigned)bytes, us,
+           us > 0 ? bytes * iterations / us : 0.0);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN(0, written);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_markdown_is_stripped);
+  RUN_TEST(test_numbers_and_symbols);
+  RUN_TEST(test_punctuation_spacing_and_unicode);
+  RUN_TEST(test_small_buffers_stay_valid);
+  RUN_TEST(test_random_inputs_stay_valid);
+  RUN_TEST(test_chunks_split_at_the_best_boundary);
+  RUN_TEST(test_chunks_cover_the_text);
+  RUN_TEST(test_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,208 @@
+// Host tests for the per-turn budget, the stage p95 that hedging waits
+// for, and connect retries with jittered backoff, on a manual clock.
+// pio test -e native -f test_turn_scheduler
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "turn_scheduler.h"
+
+// Fails the first `failures` connects, each one taking `connectMs` of the
+// attempt's timeout, and records when every attempt started
+class FlakyServer : public WiFiClient
+{
+public:
+  int connect(const char *host, uint16_t port, int32_t timeout) override
+  {
+    starts.push_back(millis());
+    timeouts.push_back(timeout);
+    if ((int)starts.size() <= failures)
+    {
+      delay(min((uint32_t)timeout, connectMs));
+      return 0;
+    }
+    return 1;
+  }
+
+  int failures = 0;
+  uint32_t connectMs = 0;
+  std::vector<uint32_t> starts;
+  std::vector<int32_t> timeouts;
+};
+
+void setUp(void)
+{
+  hostClockManual(true);
+  hostClock.us = 1000000; // 1 s after boot
+  srand(1);
+}
+
+void tearDown(void)
+{
+  hostClockManual(false);
+}
+
+void test_stage_deadlines_share_the_budget(void)
+{
+  uint32_t t0 = millis();
+  turnBegin(30000);
+
+  // Weights 40/35/25: STT gets 40% of the whole turn
+  TEST_ASSERT_EQUAL(t0 + 12000, stageBegin(STAGE_STT));
+  TEST_ASSERT_EQUAL(12000, msUntil(stageDeadline(STAGE_STT)));
+
+  // A fast STT leaves its time to the stages after it
+  delay(2000);
+  stageEnd(STAGE_STT, true);
+  TEST_ASSERT_EQUAL(t0 + 2000 + 28000 * 35 / 60, stageBegin(STAGE_LLM));
+
+  // The last stage gets everything that is left
+  delay(8000);
+  stageEnd(STAGE_LLM, true);
+  TEST_ASSERT_EQUAL(t0 + 30000, stageBegin(STAGE_TTS));
+  TEST_ASSERT_EQUAL(2000, stageElapsed(STAGE_STT));
+  TEST_ASSERT_EQUAL(8000, stageElapsed(STAGE_LLM));
+  TEST_ASSERT_TRUE(stageOk(STAGE_LLM));
+}
+
+void test_overrun_turn_leaves_no_time(void)
+{
+  turnBegin(5000);
+  stageBegin(STAGE_STT);
+  delay(6000);
+  stageEnd(STAGE_STT, false);
+  TEST_ASSERT_FALSE(stageOk(STAGE_STT));
+
+  uint32_t deadline = stageBegin(STAGE_LLM);
+  TEST_ASSERT_EQUAL(millis(), deadline);
+  TEST_ASSERT_EQUAL(0, msUntil(deadline));
+  TEST_ASSERT_EQUAL(0, stageElapsed(STAGE_TTS)); // Did not run this turn
+}
+
+void test_deadlines_across_millis_wraparound(void)
+{
+  hostClock.us = (0xFFFFFFFFULL - 100) * 1000;
+  turnBegin(1000);
+  uint32_t deadline = stageBegin(STAGE_TTS);
+  TEST_ASSERT_TRUE(deadline < millis()); // Wrapped
+  TEST_ASSERT_EQUAL(1000, msUntil(deadline));
+  delay(999);
+  TEST_ASSERT_EQUAL(1, msUntil(deadline));
+  delay(5);
+  TEST_ASSERT_EQUAL(0, msUntil(deadline));
+}
+
+void test_p95_needs_samples_and_skips_failures(void)
+{
+  // History left by the other tests is pushed out first
+  for (int i = 0; i < STAGE_HISTORY; i++)
+  {
+    turnBegin();
+    stageBegin(STAGE_LLM);
+    delay(100);
+    stageEnd(STAGE_LLM, true);
+  }
+  TEST_ASSERT_EQUAL(100, stageP95(STAGE_LLM));
+
+  // No p95, and so no hedging, until the stage has STAGE_MIN_SAMPLES
+  for (int i = 1; i <= STAGE_MIN_SAMPLES; i++)
+  {
+    TEST_ASSERT_EQUAL(0, stageP95(STAGE_TTS));
+    turnBegin();
+    stageBegin(STAGE_TTS);
+    delay(300);
+    stageEnd(STAGE_TTS, true);
+  }
+  TEST_ASSERT_EQUAL(300, stageP95(STAGE_TTS));
+
+  // 20 successes of 1..20 s among the history: the p95 is a real sample,
+  // not an average, and failed requests (timeouts) are not counted
+  for (int i = 1; i <= 20; i++)
+  {
+    turnBegin(60000);
+    stageBegin(STAGE_LLM);
+    delay(i * 1000);
+    stageEnd(STAGE_LLM, true);
+
+    stageBegin(STAGE_LLM);
+    delay(59000);
+    stageEnd(STAGE_LLM, false);
+  }
+  // 12 x 100 ms + 1..20 s: rank ceil(32 * 0.95) = 31 of 32 is 19 s
+  TEST_ASSERT_EQUAL(19000, stageP95(STAGE_LLM));
+}
+
+void test_connect_retries_with_jittered_backoff(void)
+{
+  uint32_t minGap[CONNECT_RETRIES - 1], maxGap[CONNECT_RETRIES - 1];
+  for (int a = 0; a + 1 < CONNECT_RETRIES; a++)
+  {
+    minGap[a] = UINT32_MAX;
+    maxGap[a] = 0;
+  }
+  for (int run = 0; run < 200; run++)
+  {
+    FlakyServer server;
+    server.failures = CONNECT_RETRIES - 1;
+    TEST_ASSERT_TRUE(connectWithRetry(server, "mock", 8000, millis() + 30000));
+    TEST_ASSERT_EQUAL(CONNECT_RETRIES, server.starts.size());
+
+    for (int a = 0; a + 1 < CONNECT_RETRIES; a++)
+    {
+      // Full jitter inside the doubled window: [window / 4, window)
+      uint32_t window = CONNECT_BACKOFF_MS << a;
+      uint32_t gap = server.starts[a + 1] - server.starts[a];
+      TEST_ASSERT_TRUE(gap >= window / 4 && gap < window);
+      minGap[a] = min(minGap[a], gap);
+      maxGap[a] = max(maxGap[a], gap);
+    }
+  }
+  // Spread over the window, so devices that lost Wi-Fi together do not
+  // reconnect in lockstep
+  for (int a = 0; a + 1 < CONNECT_RETRIES; a++)
+  {
+    uint32_t window = CONNECT_BACKOFF_MS << a;
+    TEST_ASSERT_TRUE(maxGap[a] - minGap[a] > window / 2);
+  }
+}
+
+void test_connect_gives_up_after_the_retries(void)
+{
+  FlakyServer server;
+  server.failures = 100;
+  TEST_ASSERT_FALSE(connectWithRetry(server, "mock", 8000, millis() + 60000));
+  TEST_ASSERT_EQUAL(CONNECT_RETRIES, server.starts.size());
+  TEST_ASSERT_EQUAL(CONNECT_TIMEOUT_MS, server.timeouts[0]);
+}
+
+void test_connect_stays_inside_the_deadline(void)
+{
+  // Each attempt hangs for its whole timeout: the second one only gets
+  // what is left, and no backoff is slept past the deadline
+  FlakyServer server;
+  server.failures = 100;
+  server.connectMs = UINT32_MAX;
+  uint32_t deadline = millis() + 7000;
+  TEST_ASSERT_FALSE(connectWithRetry(server, "mock", 8000, deadline));
+  TEST_ASSERT_EQUAL(2, server.starts.size());
+  TEST_ASSERT_EQUAL(CONNECT_TIMEOUT_MS, server.timeouts[0]);
+  TEST_ASSERT_TRUE(server.timeouts[1] <= 7000 - CONNECT_TIMEOUT_MS - CONNECT_BACKOFF_MS / 4);
+  TEST_ASSERT_EQUAL(0, msUntil(deadline));
+
+  // No time at all: not even one attempt
+  FlakyServer late;
+  TEST_ASSERT_FALSE(connectWithRetry(late, "mock", 8000, millis()));
+  TEST_ASSERT_EQUAL(0, late.starts.size());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_stage_deadlines_share_the_budget);
+  RUN_TEST(test_overrun_turn_leaves_no_time);
+  RUN_TEST(test_deadlines_across_millis_wraparound);
+  RUN_TEST(test_p95_needs_samples_and_skips_failures);
+  RUN_TEST(test_connect_retries_with_jittered_backoff);
+  RUN_TEST(test_connect_gives_up_after_the_retries);
+  RUN_TEST(test_connect_stays_inside_the_deadline);
+  return UNITY_END();
+}